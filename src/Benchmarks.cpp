@@ -0,0 +1,424 @@
+#include"Benchmarks.h"
+#include"CellPortalGraph.h"
+#include"DynamicResolution.h"
+#include"Frustum.h"
+#include"ImageDecoder.h"
+#include"Mesh.h"
+#include"OcclusionCuller.h"
+#include"shaderClass.h"
+#include<algorithm>
+#include<cctype>
+#include<chrono>
+#include<cmath>
+#include<cstdio>
+#include<filesystem>
+#include<iostream>
+#include<string>
+#include<vector>
+#include<glm/gtc/matrix_inverse.hpp>
+#include<glm/gtc/matrix_transform.hpp>
+
+// Decodes every image under root with each available decoder and prints MB/s per backend
+int RunDecodeBenchmark(const char* root)
+{
+	struct Image
+	{
+		std::string path;
+		size_t fileBytes;
+		bool jpeg;
+	};
+	std::vector<Image> images;
+	for (const auto& file : std::filesystem::recursive_directory_iterator(root))
+	{
+		if (!file.is_regular_file()) continue;
+		std::string extension = file.path().extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (extension != ".jpg" && extension != ".jpeg" && extension != ".png") continue;
+		images.push_back({ file.path().string(), (size_t)file.file_size(), extension != ".png" });
+	}
+	if (images.empty())
+	{
+		std::cout << "No images found under " << root << std::endl;
+		return 1;
+	}
+	std::cout << "Decoding " << images.size() << " images under " << root << std::endl;
+
+	const int passes = 3;
+	for (ImageDecoder* decoder : AvailableImageDecoders())
+	{
+		// Totals for JPEG [0] and PNG [1]
+		double seconds[2] = { 0.0, 0.0 };
+		double fileMB[2] = { 0.0, 0.0 };
+		double pixelMB[2] = { 0.0, 0.0 };
+		int failures = 0;
+		// One buffer reused for every image, as the texture loaders do
+		std::vector<unsigned char> pixels;
+
+		for (int pass = 0; pass < passes; pass++)
+		{
+			for (const auto& image : images)
+			{
+				ImageInfo info;
+				if (!decoder->Info(image.path.c_str(), info))
+				{
+					failures++;
+					continue;
+				}
+				int channels = image.jpeg ? 3 : 4;
+				size_t size = (size_t)info.width * info.height * channels;
+				if (pixels.size() < size) pixels.resize(size);
+
+				auto start = std::chrono::steady_clock::now();
+				bool ok = decoder->Decode(image.path.c_str(), channels, true, pixels.data(), pixels.size());
+				auto end = std::chrono::steady_clock::now();
+				if (!ok)
+				{
+					failures++;
+					continue;
+				}
+				int kind = image.jpeg ? 0 : 1;
+				seconds[kind] += std::chrono::duration<double>(end - start).count();
+				fileMB[kind] += image.fileBytes / (1024.0 * 1024.0);
+				pixelMB[kind] += size / (1024.0 * 1024.0);
+			}
+		}
+
+		std::cout << decoder->Name() << ":" << std::endl;
+		const char* kinds[2] = { "JPEG", "PNG" };
+		for (int kind = 0; kind < 2; kind++)
+		{
+			if (seconds[kind] <= 0.0) continue;
+			std::cout << "  " << kinds[kind] << ": " << fileMB[kind] / seconds[kind] << " MB/s compressed, "
+				<< pixelMB[kind] / seconds[kind] << " MB/s decoded, " << seconds[kind] / passes << " s per pass" << std::endl;
+		}
+		double totalSeconds = seconds[0] + seconds[1];
+		if (totalSeconds > 0.0)
+		{
+			std::cout << "  All: " << (fileMB[0] + fileMB[1]) / totalSeconds << " MB/s compressed, "
+				<< (pixelMB[0] + pixelMB[1]) / totalSeconds << " MB/s decoded" << std::endl;
+		}
+		if (failures > 0) std::cout << "  " << failures / passes << " images failed to decode" << std::endl;
+	}
+	return 0;
+}
+
+// Rasterizes walls in front of a camera on the CPU and checks which boxes the OcclusionCuller hides
+int RunOcclusionCheck()
+{
+	// Wall quad across x and y at depth z, from left to right
+	auto wall = [](float left, float right, float z)
+	{
+		return std::vector<glm::vec3>{
+			{ left, -5.0f, z }, { right, -5.0f, z }, { right, 5.0f, z },
+			{ left, -5.0f, z }, { right, 5.0f, z }, { left, 5.0f, z } };
+	};
+	struct Case
+	{
+		const char* name;
+		AABB box;
+		bool visible;
+	};
+
+	// The camera sits at the origin looking down -z, as the default culler size sees it
+	OcclusionCuller culler;
+	glm::mat4 viewProjection = glm::perspective(glm::radians(70.0f), (float)culler.Width() / culler.Height(), 0.1f, 100.0f)
+		* glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	int failures = 0;
+	auto run = [&](const char* setup, const std::vector<Case>& cases)
+	{
+		culler.Begin(viewProjection);
+		for (const Case& c : cases)
+		{
+			bool visible = culler.Visible(c.box);
+			bool ok = visible == c.visible;
+			if (!ok) failures++;
+			std::cout << (ok ? "pass " : "FAIL ") << setup << ": " << c.name << " is " << (visible ? "visible" : "hidden") << std::endl;
+		}
+	};
+
+	// One solid wall 10 units away
+	culler.AddTriangles(wall(-5.0f, 5.0f, -10.0f));
+	run("wall", {
+		{ "box behind the wall", { glm::vec3(-1.0f, -1.0f, -20.0f), glm::vec3(1.0f, 1.0f, -15.0f) }, false },
+		{ "thin box behind the wall", { glm::vec3(0.2f, -0.01f, -12.0f), glm::vec3(0.21f, 0.01f, -11.0f) }, false },
+		{ "box in front of the wall", { glm::vec3(-1.0f, -1.0f, -8.0f), glm::vec3(1.0f, 1.0f, -6.0f) }, true },
+		{ "box through the wall", { glm::vec3(-1.0f, -1.0f, -12.0f), glm::vec3(1.0f, 1.0f, -9.0f) }, true },
+		{ "box past the wall's edge", { glm::vec3(4.5f, -1.0f, -20.0f), glm::vec3(8.0f, 1.0f, -15.0f) }, true },
+	});
+
+	// Two walls with a slit narrower than a pixel between them
+	culler.ClearOccluders();
+	culler.AddTriangles(wall(-5.0f, -0.01f, -10.0f));
+	culler.AddTriangles(wall(0.01f, 5.0f, -10.0f));
+	run("slit", {
+		{ "thin box seen through the slit", { glm::vec3(-0.005f, -0.5f, -20.0f), glm::vec3(0.005f, 0.5f, -15.0f) }, true },
+		{ "box behind the left wall", { glm::vec3(-3.0f, -1.0f, -20.0f), glm::vec3(-2.0f, 1.0f, -15.0f) }, false },
+	});
+
+	std::cout << (failures == 0 ? "Occlusion check passed" : "Occlusion check failed") << std::endl;
+	return failures == 0 ? 0 : 1;
+}
+
+// Builds rooms with doorways in their walls and checks which boxes the CellPortalGraph finds
+int RunPortalCheck()
+{
+	// Wall rectangle across y and z at x, as two triangles
+	auto wall = [](std::vector<glm::vec3>& walls, float x, float back, float front, float bottom, float top)
+	{
+		walls.insert(walls.end(), {
+			{ x, bottom, back }, { x, bottom, front }, { x, top, front },
+			{ x, bottom, back }, { x, top, front }, { x, top, back } });
+	};
+	struct Case
+	{
+		const char* name;
+		AABB box;
+		bool visible;
+	};
+
+	int failures = 0;
+	auto run = [&](const char* setup, const CellPortalGraph& cells, const std::vector<Case>& cases)
+	{
+		for (const Case& c : cases)
+		{
+			bool visible = cells.Visible(cells.Mask(c.box), c.box);
+			bool ok = visible == c.visible;
+			if (!ok) failures++;
+			std::cout << (ok ? "pass " : "FAIL ") << setup << ": " << c.name << " is " << (visible ? "visible" : "hidden") << std::endl;
+		}
+	};
+	auto look = [](const glm::vec3& eye, const glm::vec3& direction)
+	{
+		return Frustum(glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f) * glm::lookAt(eye, eye + direction, glm::vec3(0.0f, 1.0f, 0.0f)));
+	};
+
+	// Three rooms in a row along x, 10 wide and 4 high. The first wall has a door in its middle, the
+	// second one in its corner, and a floor runs under all of them
+	CellPortalGraph rooms;
+	rooms.AddCell("a", { glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(10.0f, 4.0f, 10.0f) });
+	rooms.AddCell("b", { glm::vec3(10.0f, 0.0f, 0.0f), glm::vec3(20.0f, 4.0f, 10.0f) });
+	rooms.AddCell("c", { glm::vec3(20.0f, 0.0f, 0.0f), glm::vec3(30.0f, 4.0f, 10.0f) });
+	std::vector<glm::vec3> walls = {
+		{ 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 10.0f }, { 30.0f, 0.0f, 10.0f },
+		{ 0.0f, 0.0f, 0.0f }, { 30.0f, 0.0f, 10.0f }, { 30.0f, 0.0f, 0.0f } };
+	wall(walls, 10.0f, 0.0f, 4.0f, 0.0f, 4.0f);
+	wall(walls, 10.0f, 6.0f, 10.0f, 0.0f, 4.0f);
+	wall(walls, 10.0f, 4.0f, 6.0f, 3.0f, 4.0f);
+	wall(walls, 20.0f, 1.0f, 10.0f, 0.0f, 4.0f);
+	wall(walls, 20.0f, 0.0f, 1.0f, 3.0f, 4.0f);
+	rooms.AddSharedFacePortals(walls);
+
+	glm::vec3 eye(2.0f, 1.5f, 5.0f);
+	rooms.Traverse(eye, look(eye, glm::vec3(1.0f, 0.0f, 0.0f)));
+	run("door ahead", rooms, {
+		{ "box just past the door", { glm::vec3(11.0f, 0.5f, 4.5f), glm::vec3(12.0f, 1.5f, 5.5f) }, true },
+		{ "box in the next room's corner", { glm::vec3(17.0f, 0.5f, 0.2f), glm::vec3(19.0f, 1.5f, 0.8f) }, false },
+		{ "box in the room past the corner door", { glm::vec3(22.0f, 0.5f, 4.0f), glm::vec3(24.0f, 1.5f, 6.0f) }, false },
+	});
+
+	eye = glm::vec3(15.0f, 1.5f, 5.0f);
+	rooms.Traverse(eye, look(eye, glm::vec3(-1.0f, 0.0f, 0.0f)));
+	run("door behind", rooms, {
+		{ "box just past the door", { glm::vec3(7.0f, 0.5f, 4.5f), glm::vec3(9.0f, 1.5f, 5.5f) }, true },
+		{ "box in the far corner", { glm::vec3(1.0f, 0.5f, 0.1f), glm::vec3(3.0f, 1.5f, 0.5f) }, false },
+	});
+
+	// A row of open cells longer than the traversal follows, the cells past its end stay visible
+	CellPortalGraph row;
+	for (int i = 0; i < 24; i++)
+	{
+		row.AddCell("cell" + std::to_string(i), { glm::vec3(i * 2.0f, 0.0f, 0.0f), glm::vec3(i * 2.0f + 2.0f, 4.0f, 10.0f) });
+	}
+	row.AddSharedFacePortals();
+	eye = glm::vec3(1.0f, 1.5f, 5.0f);
+	row.Traverse(eye, look(eye, glm::vec3(1.0f, 0.0f, 0.0f)));
+	run("long row", row, {
+		{ "box in the last cell", { glm::vec3(46.5f, 0.5f, 4.5f), glm::vec3(47.5f, 1.5f, 5.5f) }, true },
+	});
+
+	std::cout << (failures == 0 ? "Portal check passed" : "Portal check failed") << std::endl;
+	return failures == 0 ? 0 : 1;
+}
+
+// Draws the meshes with the normal matrix inverted per vertex and computed once on the CPU
+int RunVertexBenchmark(std::vector<Mesh>& meshes, const glm::mat4& model, Shader& inShader, Shader& onCPU, int frames)
+{
+	size_t vertices = 0;
+	for (const auto& mesh : meshes) vertices += mesh.indices.size();
+	std::cout << "Drawing " << meshes.size() << " meshes, " << vertices << " vertices per frame, "
+		<< frames << " frames per variant" << std::endl;
+
+	GLuint query;
+	glGenQueries(1, &query);
+	const int warmupFrames = 10;
+	struct Variant
+	{
+		const char* name;
+		Shader* shader;
+		bool cpu;
+	};
+	Variant variants[] = { { "inverse per vertex", &inShader, false }, { "normal matrix on CPU", &onCPU, true } };
+
+	for (int rasterize = 0; rasterize < 2; rasterize++)
+	{
+		// Without rasterization only the vertex stage runs
+		if (!rasterize) glEnable(GL_RASTERIZER_DISCARD);
+		std::cout << (rasterize ? "Full pipeline:" : "Vertex stage only:") << std::endl;
+		for (const auto& variant : variants)
+		{
+			double gpuSeconds = 0.0;
+			double cpuSeconds = 0.0;
+			for (int frame = 0; frame < warmupFrames + frames; frame++)
+			{
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				auto start = std::chrono::steady_clock::now();
+				glBeginQuery(GL_TIME_ELAPSED, query);
+				variant.shader->Activate();
+				variant.shader->SetMat4("model", model);
+				if (variant.cpu) variant.shader->SetMat3("normalMatrix", glm::inverseTranspose(glm::mat3(model)));
+				for (auto& mesh : meshes)
+				{
+					glBindVertexArray(mesh.VAO.ID);
+					glDrawElements(GL_TRIANGLES, (GLsizei)mesh.indices.size(), GL_UNSIGNED_INT, 0);
+				}
+				glEndQuery(GL_TIME_ELAPSED);
+				auto end = std::chrono::steady_clock::now();
+
+				GLuint64 nanoseconds = 0;
+				glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+				if (frame < warmupFrames) continue;
+				gpuSeconds += nanoseconds * 1e-9;
+				cpuSeconds += std::chrono::duration<double>(end - start).count();
+			}
+			std::cout << "  " << variant.name << ": " << gpuSeconds * 1000.0 / frames << " ms GPU, "
+				<< gpuSeconds * 1e9 / ((double)frames * vertices) << " ns per vertex, "
+				<< cpuSeconds * 1e6 / frames << " us CPU per frame" << std::endl;
+		}
+		glDisable(GL_RASTERIZER_DISCARD);
+	}
+	glBindVertexArray(0);
+	glDeleteQueries(1, &query);
+	return 0;
+}
+
+// Constructor with the crowd sizes, and the frames skipped and measured at each
+CrowdBenchmark::CrowdBenchmark(std::vector<size_t> sizes, int warmupFrames, int measuredFrames)
+	: sizes(std::move(sizes)), warmupFrames(warmupFrames), measuredFrames(measuredFrames)
+{
+}
+
+// Records how long a frame took and the GPU time of the crowd's draws, returns true when the crowd size changes
+bool CrowdBenchmark::Frame(double seconds, double crowdGpuMilliseconds)
+{
+	if (Done()) return false;
+	// The first frames after a resize pay for growing the buffers
+	if (frame++ < warmupFrames) return false;
+	times.push_back(seconds);
+	if ((int)times.size() < measuredFrames) return false;
+
+	std::sort(times.begin(), times.end());
+	double total = 0.0;
+	for (double t : times) total += t;
+	// The profiler's average spans the last Window frames, all of them at this size by now
+	results.push_back({ sizes[step], total / times.size(), times[times.size() * 99 / 100], times.back(), crowdGpuMilliseconds });
+	std::cout << sizes[step] << " agents: " << results.back().mean * 1000.0 << " ms, crowd GPU " << crowdGpuMilliseconds << " ms" << std::endl;
+
+	times.clear();
+	frame = 0;
+	step++;
+	return true;
+}
+
+// Prints agents against mean, 99th percentile and worst frame time and the crowd's GPU time
+void CrowdBenchmark::Print() const
+{
+	std::cout << "agents\tmean ms\tp99 ms\tworst ms\tfps\tcrowd GPU ms" << std::endl;
+	for (const auto& result : results)
+	{
+		std::cout << result.agents << "\t" << result.mean * 1000.0 << "\t" << result.p99 * 1000.0 << "\t"
+			<< result.worst * 1000.0 << "\t" << 1.0 / result.mean << "\t" << result.crowdGpu << std::endl;
+	}
+}
+
+// Constructor with the frames skipped and measured, and the folder to save frames to
+HeadlessBenchmark::HeadlessBenchmark(int measuredFrames, int warmupFrames, std::string imageDir, int imageEvery)
+	: measuredFrames(std::max(measuredFrames, 1)), warmupFrames(std::max(warmupFrames, 0)), imageDir(std::move(imageDir)), imageEvery(std::max(imageEvery, 1))
+{
+	if (!this->imageDir.empty()) std::filesystem::create_directories(this->imageDir);
+}
+
+// Position along the camera path of the frame being drawn, 0 while warming up, 1 at the last
+float HeadlessBenchmark::Progress() const
+{
+	if (frame < warmupFrames || measuredFrames < 2) return 0.0f;
+	return std::min(1.0f, (float)(frame - warmupFrames) / (float)(measuredFrames - 1));
+}
+
+// Records how long a frame took and how many meshes were behind doors, and saves the render target when due
+void HeadlessBenchmark::Frame(double seconds, const DynamicResolution& target, unsigned int behindDoors)
+{
+	if (Done()) return;
+	int measured = frame++ - warmupFrames;
+	if (measured < 0) return;
+	times.push_back(seconds);
+	this->behindDoors.push_back(behindDoors);
+
+	if (imageDir.empty() || measured % imageEvery != 0) return;
+	std::vector<unsigned char> pixels;
+	if (!target.ReadPixels(pixels)) return;
+	int width = target.Width();
+	int height = target.Height();
+	char name[32];
+	std::snprintf(name, sizeof(name), "frame_%05d.ppm", measured);
+	std::string path = (std::filesystem::path(imageDir) / name).string();
+	FILE* file = std::fopen(path.c_str(), "wb");
+	if (file == nullptr)
+	{
+		std::cerr << "Failed to write image: " << path << std::endl;
+		return;
+	}
+	// PPM stores the top row first and no alpha
+	std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+	std::vector<unsigned char> row((size_t)width * 3);
+	for (int y = height - 1; y >= 0; y--)
+	{
+		const unsigned char* source = pixels.data() + (size_t)y * width * 4;
+		for (int x = 0; x < width; x++)
+		{
+			row[x * 3 + 0] = source[x * 4 + 0];
+			row[x * 3 + 1] = source[x * 4 + 1];
+			row[x * 3 + 2] = source[x * 4 + 2];
+		}
+		std::fwrite(row.data(), 1, row.size(), file);
+	}
+	std::fclose(file);
+	imagesSaved++;
+}
+
+// Prints mean, median, percentiles, best and worst frame time, and the meshes behind doors
+void HeadlessBenchmark::Print() const
+{
+	if (times.empty()) return;
+	std::vector<double> sorted = times;
+	std::sort(sorted.begin(), sorted.end());
+	double total = 0.0;
+	for (double t : sorted) total += t;
+	double mean = total / sorted.size();
+	double variance = 0.0;
+	for (double t : sorted) variance += (t - mean) * (t - mean);
+	double deviation = std::sqrt(variance / sorted.size());
+	auto percentile = [&sorted](int p) { return sorted[std::min(sorted.size() - 1, sorted.size() * p / 100)]; };
+
+	if (!context.empty()) std::cout << "Context: " << context << std::endl;
+	std::cout << "frames\tmean ms\tmedian ms\tp95 ms\tp99 ms\tbest ms\tworst ms\tstddev ms\tfps" << std::endl;
+	std::cout << sorted.size() << "\t" << mean * 1000.0 << "\t" << percentile(50) * 1000.0 << "\t"
+		<< percentile(95) * 1000.0 << "\t" << percentile(99) * 1000.0 << "\t" << sorted.front() * 1000.0 << "\t"
+		<< sorted.back() * 1000.0 << "\t" << deviation * 1000.0 << "\t" << 1.0 / mean << std::endl;
+
+	double doorTotal = 0.0;
+	for (unsigned int count : behindDoors) doorTotal += count;
+	std::cout << "Meshes behind doors per frame: mean " << doorTotal / behindDoors.size()
+		<< ", min " << *std::min_element(behindDoors.begin(), behindDoors.end())
+		<< ", max " << *std::max_element(behindDoors.begin(), behindDoors.end()) << std::endl;
+	if (imagesSaved > 0) std::cout << "Saved " << imagesSaved << " frames to " << imageDir << std::endl;
+}
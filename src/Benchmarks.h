@@ -0,0 +1,92 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include<cstddef>
+#include<string>
+#include<vector>
+#include<glm/glm.hpp>
+
+class DynamicResolution;
+class Mesh;
+class Shader;
+
+// Decodes every image under root with each available decoder and prints MB/s per backend
+int RunDecodeBenchmark(const char* root);
+
+// Rasterizes walls in front of a camera on the CPU and checks which boxes the OcclusionCuller
+// hides, prints each case and returns 0 when all of them pass
+int RunOcclusionCheck();
+
+// Builds rooms with doorways in their walls and checks which boxes the CellPortalGraph finds
+// from inside them, prints each case and returns 0 when all of them pass
+int RunPortalCheck();
+
+// Draws the meshes with the normal matrix inverted per vertex by inShader and computed once on the
+// CPU for onCPU, and prints the GPU time of each with rasterization off (vertex stage only) and on
+int RunVertexBenchmark(std::vector<Mesh>& meshes, const glm::mat4& model, Shader& inShader, Shader& onCPU, int frames = 200);
+
+// Steps a crowd through growing sizes inside the main loop and prints the frame time at each,
+// next to the GPU time of the crowd's own draws, which no vsync the driver forces can pad
+class CrowdBenchmark
+{
+public:
+	// Constructor with the crowd sizes, and the frames skipped and measured at each
+	CrowdBenchmark(std::vector<size_t> sizes, int warmupFrames = 60, int measuredFrames = 300);
+	// Whether every size was measured
+	bool Done() const { return step >= sizes.size(); }
+	// Crowd size to draw now
+	size_t Agents() const { return Done() ? 0 : sizes[step]; }
+	// Records how long a frame took and the profiler's averaged GPU time of the crowd's draws,
+	// returns true when the crowd size changes
+	bool Frame(double seconds, double crowdGpuMilliseconds);
+	// Prints agents against mean, 99th percentile and worst frame time and the crowd's GPU time
+	void Print() const;
+private:
+	struct Result
+	{
+		size_t agents;
+		double mean;
+		double p99;
+		double worst;
+		double crowdGpu;
+	};
+	std::vector<size_t> sizes;
+	int warmupFrames;
+	int measuredFrames;
+	size_t step = 0;
+	int frame = 0;
+	std::vector<double> times;
+	std::vector<Result> results;
+};
+
+// Counts the frames of a headless run, records their times and saves some as images
+class HeadlessBenchmark
+{
+public:
+	// How the frames were rendered, e.g. OSMesa or a hidden window and the renderer, printed with the results
+	std::string context;
+
+	// Constructor with the frames skipped and measured, and the folder to save every imageEvery-th
+	// measured frame to as a PPM, none when imageDir is empty
+	HeadlessBenchmark(int measuredFrames, int warmupFrames = 60, std::string imageDir = "", int imageEvery = 60);
+	// Whether every frame was measured
+	bool Done() const { return frame >= warmupFrames + measuredFrames; }
+	// Position along the camera path of the frame being drawn, 0 while warming up, 1 at the last
+	float Progress() const;
+	// Records how long a frame took and how many meshes the cells hid behind doors, and saves the
+	// render target when the frame is due
+	void Frame(double seconds, const DynamicResolution& target, unsigned int behindDoors = 0);
+	// Prints mean, median, percentiles, best and worst frame time, and the meshes behind doors
+	void Print() const;
+private:
+	int measuredFrames;
+	int warmupFrames;
+	std::string imageDir;
+	int imageEvery;
+	int frame = 0;
+	int imagesSaved = 0;
+	std::vector<double> times;
+	std::vector<unsigned int> behindDoors;
+};
+
+#endif
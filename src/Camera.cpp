@@ -1,4 +1,5 @@
 #include"Camera.h"
+#include"CpuProfiler.h"
 #include "AABB.h"
 #include "Mesh.h"
 #include <algorithm>
@@ -66,6 +67,7 @@ Camera::Camera(int width, int height, glm::vec3 position)
 	Camera::width = width;
 	Camera::height = height;
 	Position = position;
+	previousPosition = position;
 }
 
 void Camera::updateMatrix(float FOVdeg, float nearPlane, float farPlane)
@@ -86,7 +88,7 @@ void Camera::updateMatrix(float FOVdeg, float nearPlane, float farPlane)
 void Camera::Matrix(Shader& shader, const char* uniform)
 {
 	// Exports camera matrix
-	glUniformMatrix4fv(glGetUniformLocation(shader.ID, uniform), 1, GL_FALSE, glm::value_ptr(cameraMatrix));
+	shader.SetMat4(uniform, cameraMatrix);
 }
 
 bool isInsideAABB(const glm::vec3& pos, const AABB& box, float radius = 0.1f) {
@@ -97,46 +99,44 @@ bool isInsideAABB(const glm::vec3& pos, const AABB& box, float radius = 0.1f) {
 		pos.z > min.z && pos.z < max.z);
 }
 
-void Camera::Inputs(GLFWwindow* window, const std::vector<Mesh>& meshes, const glm::mat4& modelMatrix, bool enableCollision)
+// Handles camera inputs for one simulation step of deltaTime seconds
+void Camera::Inputs(const InputFrame& input, float deltaTime, const std::vector<Mesh>& meshes, const glm::mat4& modelMatrix, bool enableCollision)
 {
+	PROFILE_ZONE("Camera::Inputs");
+	// Speed the shift key picks, applied over the step
+	speed = input.Down(INPUT_FAST) ? 24.0f : 6.0f;
+	float step = speed * deltaTime;
 	// Handles key inputs
 	glm::vec3 nextPosition = Position;
-	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+	if (input.Down(INPUT_FORWARD))
 	{
-		nextPosition += speed * Orientation;
+		nextPosition += step * Orientation;
 	}
-	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+	if (input.Down(INPUT_LEFT))
 	{
-		nextPosition += speed * -glm::normalize(glm::cross(Orientation, Up));
+		nextPosition += step * -glm::normalize(glm::cross(Orientation, Up));
 	}
-	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+	if (input.Down(INPUT_BACK))
 	{
-		nextPosition += speed * -Orientation;
+		nextPosition += step * -Orientation;
 	}
-	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+	if (input.Down(INPUT_RIGHT))
 	{
-		nextPosition += speed * glm::normalize(glm::cross(Orientation, Up));
+		nextPosition += step * glm::normalize(glm::cross(Orientation, Up));
 	}
-	if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
+	if (input.Down(INPUT_UP))
 	{
-		nextPosition += speed * Up;
+		nextPosition += step * Up;
 	}
-	if (glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS)
+	if (input.Down(INPUT_DOWN))
 	{
-		nextPosition += speed * -Up;
-	}
-	if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
-	{
-		speed = 0.4f;
-	}
-	else if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_RELEASE)
-	{
-		speed = 0.1f;
+		nextPosition += step * -Up;
 	}
 	
 	float radius = 0.2f;
 	bool collision = false;
 	if (enableCollision) {
+		PROFILE_ZONE("Collision");
 		for (const auto& mesh : meshes) {
 			if (isPointNearPrecomputedMesh(nextPosition, mesh, radius)) {
 				collision = true;
@@ -146,33 +146,20 @@ void Camera::Inputs(GLFWwindow* window, const std::vector<Mesh>& meshes, const g
 	}
 	// Hard-code the camera's Y position
 	nextPosition.y = 2.5f;
+	if (collision) {
+		contact = true;
+		contactPoint = nextPosition;
+	}
 	if (!collision) {
 		Position = nextPosition;
 	}
 
-	// Handles mouse inputs
-	if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
+	// Handles mouse inputs, the cursor only moves while looking around
+	if (input.cursorX != 0.0f || input.cursorY != 0.0f)
 	{
-		// Hides mouse cursor
-		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_HIDDEN);
-
-		// Prevents camera from jumping on the first click
-		if (firstClick)
-		{
-			glfwSetCursorPos(window, (width / 2), (height / 2));
-			firstClick = false;
-		}
-
-		// Stores the coordinates of the cursor
-		double mouseX;
-		double mouseY;
-		// Fetches the coordinates of the cursor
-		glfwGetCursorPos(window, &mouseX, &mouseY);
-
-		// Normalizes and shifts the coordinates of the cursor such that they begin in the middle of the screen
-		// and then "transforms" them into degrees 
-		float rotX = sensitivity * (float)(mouseY - (height / 2)) / height;
-		float rotY = sensitivity * (float)(mouseX - (width / 2)) / width;
+		// Normalizes the cursor movement and "transforms" it into degrees
+		float rotX = sensitivity * input.cursorY / height;
+		float rotY = sensitivity * input.cursorX / width;
 
 		// Calculates upcoming vertical change in the Orientation
 		glm::vec3 newOrientation = glm::rotate(Orientation, glm::radians(-rotX), glm::normalize(glm::cross(Orientation, Up)));
@@ -185,15 +172,22 @@ void Camera::Inputs(GLFWwindow* window, const std::vector<Mesh>& meshes, const g
 
 		// Rotates the Orientation left and right
 		Orientation = glm::rotate(Orientation, glm::radians(-rotY), Up);
-
-		// Sets mouse cursor to the middle of the screen so that it doesn't end up roaming around
-		glfwSetCursorPos(window, (width / 2), (height / 2));
-	}
-	else if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_RELEASE)
-	{
-		// Unhides cursor since camera is not looking around anymore
-		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
-		// Makes sure the next time the camera looks around it doesn't jump
-		firstClick = true;
 	}
+}
+
+// Remembers the position and orientation the next simulation step starts from
+void Camera::BeginStep()
+{
+	previousPosition = Position;
+	previousOrientation = Orientation;
+}
+
+// Copy of the camera alpha of the way from its state before the last step to the current one
+Camera Camera::Interpolated(float alpha) const
+{
+	Camera view = *this;
+	view.Position = glm::mix(previousPosition, Position, alpha);
+	glm::vec3 orientation = glm::mix(previousOrientation, Orientation, alpha);
+	view.Orientation = glm::length(orientation) > 1e-4f ? glm::normalize(orientation) : Orientation;
+	return view;
 }
\ No newline at end of file
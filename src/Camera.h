@@ -12,6 +12,7 @@
 #include"shaderClass.h"
 #include"Mesh.h"
 #include"AABB.h"
+#include"InputSource.h"
 
 class Camera
 {
@@ -21,16 +22,20 @@ public:
 	glm::vec3 Orientation = glm::vec3(0.0f, 0.0f, -1.0f);
 	glm::vec3 Up = glm::vec3(0.0f, 1.0f, 0.0f);
 	glm::mat4 cameraMatrix = glm::mat4(1.0f);
+	// Position and orientation before the last simulation step, blended with the current ones when drawn
+	glm::vec3 previousPosition;
+	glm::vec3 previousOrientation = glm::vec3(0.0f, 0.0f, -1.0f);
 
-	// Prevents the camera from jumping around when first clicking left click
-	bool firstClick = true;
 	int colis = -1;
+	// Whether any move has been blocked by a wall yet, and where the last blocked one would have gone
+	bool contact = false;
+	glm::vec3 contactPoint = glm::vec3(0.0f);
 	// Stores the width and height of the window
 	int width;
 	int height;
 
-	// Adjust the speed of the camera and it's sensitivity when looking around
-	float speed = 0.1f;
+	// Adjust the speed of the camera, in units per second, and it's sensitivity when looking around
+	float speed = 6.0f;
 	float sensitivity = 100.0f;
 
 	// Camera constructor to set up initial values
@@ -40,7 +45,11 @@ public:
 	void updateMatrix(float FOVdeg, float nearPlane, float farPlane);
 	// Exports the camera matrix to a shader
 	void Matrix(Shader& shader, const char* uniform);
-	// Handles camera inputs
-	void Inputs(GLFWwindow* window, const std::vector<Mesh>& meshes, const glm::mat4& modelMatrix, bool enableCollision);
+	// Handles camera inputs for one simulation step of deltaTime seconds
+	void Inputs(const InputFrame& input, float deltaTime, const std::vector<Mesh>& meshes, const glm::mat4& modelMatrix, bool enableCollision);
+	// Remembers the position and orientation the next simulation step starts from
+	void BeginStep();
+	// Copy of the camera alpha of the way from its state before the last step to the current one
+	Camera Interpolated(float alpha) const;
 };
 #endif
\ No newline at end of file
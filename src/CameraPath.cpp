@@ -0,0 +1,81 @@
+#include"CameraPath.h"
+#include"Camera.h"
+#include<algorithm>
+#include<fstream>
+#include<sstream>
+
+namespace
+{
+	// Uniform Catmull-Rom curve from b to c at t, shaped by the points before and after
+	glm::vec3 catmullRom(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& d, float t)
+	{
+		float t2 = t * t;
+		float t3 = t2 * t;
+		return 0.5f * (2.0f * b + (c - a) * t + (2.0f * a - 5.0f * b + 4.0f * c - d) * t2 + (3.0f * b - a - 3.0f * c + d) * t3);
+	}
+}
+
+// Reads one key per line as "x y z dx dy dz", lines starting with # are skipped
+bool CameraPath::Load(const std::string& path)
+{
+	std::ifstream in(path);
+	if (!in) return false;
+	std::vector<Key> loaded;
+	std::string line;
+	while (std::getline(in, line))
+	{
+		if (line.empty() || line[0] == '#') continue;
+		std::istringstream fields(line);
+		Key key;
+		if (!(fields >> key.position.x >> key.position.y >> key.position.z >> key.orientation.x >> key.orientation.y >> key.orientation.z)) continue;
+		if (glm::length(key.orientation) < 1e-6f) continue;
+		key.orientation = glm::normalize(key.orientation);
+		loaded.push_back(key);
+	}
+	if (loaded.empty()) return false;
+	keys = std::move(loaded);
+	return true;
+}
+
+// Places the camera at t, from 0 at the first key to 1 at the last
+void CameraPath::Apply(float t, Camera& camera) const
+{
+	if (keys.empty()) return;
+	float along = std::clamp(t, 0.0f, 1.0f) * (float)(keys.size() - 1);
+	size_t first = std::min((size_t)along, keys.size() - 1);
+	size_t second = std::min(first + 1, keys.size() - 1);
+	float blend = along - (float)first;
+	const Key& from = keys[first];
+	const Key& to = keys[second];
+	glm::vec3 orientation;
+	if (smooth)
+	{
+		// The ends repeat so the curve starts and stops on the first and last keys
+		const Key& before = keys[first > 0 ? first - 1 : first];
+		const Key& after = keys[std::min(second + 1, keys.size() - 1)];
+		camera.Position = catmullRom(before.position, from.position, to.position, after.position, blend);
+		orientation = catmullRom(before.orientation, from.orientation, to.orientation, after.orientation, blend);
+	}
+	else
+	{
+		camera.Position = glm::mix(from.position, to.position, blend);
+		orientation = glm::mix(from.orientation, to.orientation, blend);
+	}
+	// Opposite directions blend through zero, keep the earlier one then
+	camera.Orientation = glm::length(orientation) > 1e-4f ? glm::normalize(orientation) : from.orientation;
+}
+
+// Route through the start room to Nathan's corridor
+CameraPath CameraPath::Default()
+{
+	CameraPath path;
+	path.keys = {
+		{ glm::vec3(6.62f, 2.5f, 4.19f), glm::vec3(0.0f, 0.0f, -1.0f) },
+		{ glm::vec3(6.62f, 2.5f, -10.0f), glm::vec3(0.0f, 0.0f, -1.0f) },
+		{ glm::vec3(6.62f, 2.5f, -30.0f), glm::vec3(-0.5f, 0.0f, -0.866f) },
+		{ glm::vec3(1.0f, 2.5f, -45.8f), glm::vec3(1.0f, 0.0f, 0.0f) },
+		{ glm::vec3(15.0f, 2.5f, -45.8f), glm::vec3(1.0f, 0.0f, 0.0f) },
+		{ glm::vec3(29.6f, 2.5f, -45.8f), glm::vec3(0.0f, 0.0f, 1.0f) },
+	};
+	return path;
+}
@@ -0,0 +1,34 @@
+#ifndef CAMERA_PATH_CLASS_H
+#define CAMERA_PATH_CLASS_H
+
+#include<string>
+#include<vector>
+#include<glm/glm.hpp>
+
+class Camera;
+
+// A fixed route for the camera, given as positions and view directions it passes through,
+// so benchmarks and image comparisons see the same frames on every run
+class CameraPath
+{
+public:
+	struct Key
+	{
+		glm::vec3 position;
+		glm::vec3 orientation;
+	};
+
+	std::vector<Key> keys;
+	// Catmull-Rom curves through the keys when set, so the camera doesn't turn sharply at them;
+	// straight lines between them otherwise
+	bool smooth = true;
+
+	// Reads one key per line as "x y z dx dy dz", lines starting with # are skipped; false if the file can't be read
+	bool Load(const std::string& path);
+	// Places the camera at t, from 0 at the first key to 1 at the last, each stretch between keys taking as long
+	void Apply(float t, Camera& camera) const;
+	// Route through the start room to Nathan's corridor
+	static CameraPath Default();
+};
+
+#endif
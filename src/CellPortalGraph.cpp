@@ -0,0 +1,452 @@
+#include"CellPortalGraph.h"
+#include"Logger.h"
+#include<algorithm>
+#include<cmath>
+#include<fstream>
+#include<sstream>
+#include<utility>
+
+// Portals followed from the eye's cell before the traversal stops
+static const int MaxPortalDepth = 16;
+// Views gathered per frame, bounds the work on maps with many loops
+static const int MaxViews = 256;
+// Gap still counted as touching, and distance to a portal's plane treated as standing in it
+static const float Epsilon = 0.05f;
+// Wall triangles this far from a shared face still close it, and openings narrower than twice
+// this are taken as cracks between wall pieces
+static const float WallDistance = 0.5f;
+// Spacing of the samples a shared face is checked for openings at
+static const float DoorwaySpacing = 0.25f;
+// Openings in one face past this are merged into a single portal around all of them
+static const int MaxDoorwaysPerFace = 8;
+
+// Rectangles of a face that no wall covers, as min and max along the face's two other axes
+static std::vector<std::pair<glm::vec2, glm::vec2>> findOpenings(const std::vector<glm::vec3>& walls, int axis, float plane, glm::vec2 lo, glm::vec2 hi)
+{
+	int u = (axis + 1) % 3;
+	int v = (axis + 2) % 3;
+	glm::vec2 size = hi - lo;
+	float spacing = DoorwaySpacing;
+	// Faces along the edge of the map are huge, a coarser grid keeps them cheap
+	while ((size.x / spacing) * (size.y / spacing) > 1e6f) spacing *= 2.0f;
+	int columns = std::max(1, (int)std::ceil(size.x / spacing));
+	int rows = std::max(1, (int)std::ceil(size.y / spacing));
+	std::vector<uint8_t> covered((size_t)columns * rows, 0);
+
+	auto cross = [](glm::vec2 a, glm::vec2 b) { return a.x * b.y - a.y * b.x; };
+	for (size_t t = 0; t + 2 < walls.size(); t += 3)
+	{
+		const glm::vec3& a = walls[t];
+		const glm::vec3& b = walls[t + 1];
+		const glm::vec3& c = walls[t + 2];
+		if (std::fabs(a[axis] - plane) > WallDistance || std::fabs(b[axis] - plane) > WallDistance || std::fabs(c[axis] - plane) > WallDistance) continue;
+		// Only surfaces facing across the face close it, not floors and ceilings running through it
+		glm::vec3 normal = glm::cross(b - a, c - a);
+		float length = glm::length(normal);
+		if (length < 1e-8f || std::fabs(normal[axis]) < 0.9f * length) continue;
+
+		glm::vec2 pa(a[u], a[v]), pb(b[u], b[v]), pc(c[u], c[v]);
+		float area = cross(pb - pa, pc - pa);
+		// Inclusive edges so two triangles sharing one leave no crack between them
+		float slack = 1e-4f * std::fabs(area);
+		glm::vec2 tmin = glm::min(pa, glm::min(pb, pc));
+		glm::vec2 tmax = glm::max(pa, glm::max(pb, pc));
+		int i0 = std::max(0, (int)std::floor((tmin.x - lo.x) / spacing - 0.5f));
+		int i1 = std::min(columns - 1, (int)std::ceil((tmax.x - lo.x) / spacing - 0.5f));
+		int j0 = std::max(0, (int)std::floor((tmin.y - lo.y) / spacing - 0.5f));
+		int j1 = std::min(rows - 1, (int)std::ceil((tmax.y - lo.y) / spacing - 0.5f));
+		for (int j = j0; j <= j1; j++)
+		{
+			for (int i = i0; i <= i1; i++)
+			{
+				glm::vec2 p = lo + (glm::vec2((float)i, (float)j) + 0.5f) * spacing;
+				float w0 = cross(pb - pa, p - pa);
+				float w1 = cross(pc - pb, p - pb);
+				float w2 = cross(pa - pc, p - pc);
+				bool inside = area > 0.0f
+					? w0 >= -slack && w1 >= -slack && w2 >= -slack
+					: w0 <= slack && w1 <= slack && w2 <= slack;
+				if (inside) covered[(size_t)j * columns + i] = 1;
+			}
+		}
+	}
+
+	// Grows the openings so a doorway's frame and wall pieces a little off the face never narrow it
+	int reach = (int)std::ceil(WallDistance / spacing);
+	std::vector<uint8_t> open((size_t)columns * rows, 0);
+	std::vector<uint8_t> grown((size_t)columns * rows, 0);
+	for (size_t i = 0; i < open.size(); i++) open[i] = !covered[i];
+	for (int j = 0; j < rows; j++)
+	{
+		for (int i = 0; i < columns; i++)
+		{
+			for (int k = std::max(0, i - reach); k <= std::min(columns - 1, i + reach) && !grown[(size_t)j * columns + i]; k++)
+			{
+				grown[(size_t)j * columns + i] = open[(size_t)j * columns + k];
+			}
+		}
+	}
+	for (int j = 0; j < rows; j++)
+	{
+		for (int i = 0; i < columns; i++)
+		{
+			uint8_t any = 0;
+			for (int k = std::max(0, j - reach); k <= std::min(rows - 1, j + reach) && !any; k++) any = grown[(size_t)k * columns + i];
+			open[(size_t)j * columns + i] = any;
+		}
+	}
+
+	// One rectangle around every connected opening
+	std::vector<std::pair<glm::ivec2, glm::ivec2>> found;
+	std::vector<int> stack;
+	for (int start = 0; start < columns * rows; start++)
+	{
+		if (!open[start]) continue;
+		glm::ivec2 first(start % columns, start / columns);
+		glm::ivec2 last = first;
+		open[start] = 0;
+		stack.push_back(start);
+		while (!stack.empty())
+		{
+			int at = stack.back();
+			stack.pop_back();
+			int i = at % columns;
+			int j = at / columns;
+			first = glm::min(first, glm::ivec2(i, j));
+			last = glm::max(last, glm::ivec2(i, j));
+			int neighbours[4] = { i > 0 ? at - 1 : -1, i + 1 < columns ? at + 1 : -1, j > 0 ? at - columns : -1, j + 1 < rows ? at + columns : -1 };
+			for (int n : neighbours)
+			{
+				if (n < 0 || !open[n]) continue;
+				open[n] = 0;
+				stack.push_back(n);
+			}
+		}
+		found.push_back({ first, last });
+	}
+	if ((int)found.size() > MaxDoorwaysPerFace)
+	{
+		for (size_t i = 1; i < found.size(); i++)
+		{
+			found[0].first = glm::min(found[0].first, found[i].first);
+			found[0].second = glm::max(found[0].second, found[i].second);
+		}
+		found.resize(1);
+	}
+
+	std::vector<std::pair<glm::vec2, glm::vec2>> openings;
+	for (const auto& rect : found)
+	{
+		glm::vec2 min = glm::max(lo, lo + glm::vec2(rect.first) * spacing);
+		glm::vec2 max = glm::min(hi, lo + glm::vec2(rect.second + 1) * spacing);
+		openings.push_back({ min, max });
+	}
+	return openings;
+}
+
+// Whether any part of a box may be inside
+bool CellPortalGraph::View::Intersects(const AABB& box) const
+{
+	for (const auto& plane : planes)
+	{
+		glm::vec3 corner(
+			plane.x >= 0.0f ? box.max.x : box.min.x,
+			plane.y >= 0.0f ? box.max.y : box.min.y,
+			plane.z >= 0.0f ? box.max.z : box.min.z);
+		if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) return false;
+	}
+	return true;
+}
+
+// Reads the cells and portals from a file
+bool CellPortalGraph::Load(const std::string& path, const std::vector<glm::vec3>& walls)
+{
+	std::ifstream in(path);
+	if (!in) return false;
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(in, line))
+	{
+		lineNumber++;
+		std::istringstream words(line);
+		std::string kind;
+		if (!(words >> kind) || kind[0] == '#') continue;
+
+		if (kind == "cell")
+		{
+			std::string name;
+			AABB box;
+			if (words >> name >> box.min.x >> box.min.y >> box.min.z >> box.max.x >> box.max.y >> box.max.z)
+			{
+				if (AddCell(name, { glm::min(box.min, box.max), glm::max(box.min, box.max) }) < 0)
+				{
+					LOG_WARNING("%s:%d: more than %d cells", path.c_str(), lineNumber, MaxCells);
+				}
+				continue;
+			}
+		}
+		else if (kind == "portal")
+		{
+			std::string nameA, nameB;
+			std::vector<glm::vec3> corners;
+			glm::vec3 corner;
+			words >> nameA >> nameB;
+			while (words >> corner.x >> corner.y >> corner.z) corners.push_back(corner);
+			auto find = [this](const std::string& name)
+			{
+				for (size_t i = 0; i < cells.size(); i++) if (cells[i].name == name) return (int)i;
+				return -1;
+			};
+			int a = find(nameA);
+			int b = find(nameB);
+			if (a >= 0 && b >= 0 && a != b && corners.size() >= 3)
+			{
+				AddPortal(a, b, corners);
+				continue;
+			}
+		}
+		LOG_WARNING("%s:%d: ignored \"%s\"", path.c_str(), lineNumber, line.c_str());
+	}
+
+	if (portals.empty()) AddSharedFacePortals(walls);
+	return true;
+}
+
+// Adds a box to a cell, creating the cell if the name is new
+int CellPortalGraph::AddCell(const std::string& name, const AABB& box)
+{
+	for (size_t i = 0; i < cells.size(); i++)
+	{
+		if (cells[i].name == name)
+		{
+			cells[i].boxes.push_back(box);
+			version++;
+			return (int)i;
+		}
+	}
+	if (cells.size() >= MaxCells) return -1;
+	Cell cell;
+	cell.name = name;
+	cell.boxes.push_back(box);
+	cells.push_back(cell);
+	version++;
+	return (int)cells.size() - 1;
+}
+
+// Adds a doorway between two cells
+void CellPortalGraph::AddPortal(int a, int b, const std::vector<glm::vec3>& corners)
+{
+	portals.push_back({ a, b, corners });
+	cells[a].portals.push_back((int)portals.size() - 1);
+	cells[b].portals.push_back((int)portals.size() - 1);
+	version++;
+}
+
+// Turns every face shared by the boxes of two cells into portals, one per opening the walls leave in it
+void CellPortalGraph::AddSharedFacePortals(const std::vector<glm::vec3>& walls)
+{
+	for (size_t a = 0; a < cells.size(); a++)
+	{
+		for (size_t b = a + 1; b < cells.size(); b++)
+		{
+			for (const auto& boxA : cells[a].boxes)
+			{
+				for (const auto& boxB : cells[b].boxes)
+				{
+					glm::vec3 lo = glm::max(boxA.min, boxB.min);
+					glm::vec3 hi = glm::min(boxA.max, boxB.max);
+					glm::vec3 size = hi - lo;
+					if (size.x < -Epsilon || size.y < -Epsilon || size.z < -Epsilon) continue;
+
+					// The thinnest axis of the contact is the one the portal faces along
+					int axis = 0;
+					if (size.y < size[axis]) axis = 1;
+					if (size.z < size[axis]) axis = 2;
+					int u = (axis + 1) % 3;
+					int v = (axis + 2) % 3;
+					if (size[u] <= Epsilon || size[v] <= Epsilon) continue;
+
+					float plane = (lo[axis] + hi[axis]) * 0.5f;
+					std::vector<std::pair<glm::vec2, glm::vec2>> openings;
+					if (walls.empty()) openings.push_back({ glm::vec2(lo[u], lo[v]), glm::vec2(hi[u], hi[v]) });
+					else openings = findOpenings(walls, axis, plane, glm::vec2(lo[u], lo[v]), glm::vec2(hi[u], hi[v]));
+
+					for (const auto& opening : openings)
+					{
+						glm::vec3 corner;
+						corner[axis] = plane;
+						std::vector<glm::vec3> corners;
+						corner[u] = opening.first.x; corner[v] = opening.first.y; corners.push_back(corner);
+						corner[u] = opening.second.x; corners.push_back(corner);
+						corner[v] = opening.second.y; corners.push_back(corner);
+						corner[u] = opening.first.x; corners.push_back(corner);
+						AddPortal((int)a, (int)b, corners);
+					}
+				}
+			}
+		}
+	}
+}
+
+// Writes for every box the mask of the cells it overlaps
+void CellPortalGraph::Assign(const AABBList& boxes, std::vector<uint64_t>& masks) const
+{
+	masks.resize(boxes.count);
+	for (size_t i = 0; i < boxes.count; i++) masks[i] = Mask(boxes.Get(i));
+}
+
+// Mask of the cells one box overlaps
+uint64_t CellPortalGraph::Mask(const AABB& box) const
+{
+	uint64_t mask = 0;
+	for (size_t c = 0; c < cells.size(); c++)
+	{
+		for (const auto& cellBox : cells[c].boxes)
+		{
+			if (glm::all(glm::lessThanEqual(box.min, cellBox.max)) && glm::all(glm::lessThanEqual(cellBox.min, box.max)))
+			{
+				mask |= 1ull << c;
+				break;
+			}
+		}
+	}
+	return mask;
+}
+
+// Walks the portals from the cell holding the eye, narrowing the frustum at each one
+void CellPortalGraph::Traverse(const glm::vec3& eye, const Frustum& frustum)
+{
+	for (auto& cell : cells) cell.views.clear();
+	eyeCell = cellAt(eye);
+	if (eyeCell < 0)
+	{
+		// Outside of the map's cells nothing is known, so everything stays visible
+		visibleCells = ~0ull;
+		return;
+	}
+
+	visibleCells = 0;
+	viewCount = 0;
+	truncated = false;
+	View view;
+	view.planes.assign(frustum.planes, frustum.planes + 6);
+	visit(eyeCell, eye, view, 1ull << eyeCell, 0);
+
+	if (truncated)
+	{
+		// Cells past where the traversal stopped may still be seen, so every cell gets the plain frustum
+		visibleCells = ~0ull;
+		for (auto& cell : cells)
+		{
+			cell.views.clear();
+			cell.views.push_back(view);
+		}
+	}
+}
+
+// Whether a box overlapping the cells of a mask can be seen
+bool CellPortalGraph::Visible(uint64_t mask, const AABB& box) const
+{
+	if (eyeCell < 0 || mask == 0) return true;
+	uint64_t seen = mask & visibleCells;
+	for (size_t c = 0; seen != 0; c++, seen >>= 1)
+	{
+		if ((seen & 1) == 0) continue;
+		for (const auto& view : cells[c].views)
+		{
+			if (view.Intersects(box)) return true;
+		}
+	}
+	return false;
+}
+
+// Index of the cell holding a point
+int CellPortalGraph::cellAt(const glm::vec3& point) const
+{
+	for (size_t c = 0; c < cells.size(); c++)
+	{
+		for (const auto& box : cells[c].boxes)
+		{
+			if (glm::all(glm::lessThanEqual(box.min, point)) && glm::all(glm::lessThanEqual(point, box.max))) return (int)c;
+		}
+	}
+	return -1;
+}
+
+// Marks a cell as seen through a view and continues through its portals
+void CellPortalGraph::visit(int cell, const glm::vec3& eye, const View& view, uint64_t path, int depth)
+{
+	if (truncated) return;
+	cells[cell].views.push_back(view);
+	viewCount++;
+	visibleCells |= 1ull << cell;
+
+	for (int index : cells[cell].portals)
+	{
+		const Portal& portal = portals[index];
+		int next = portal.a == cell ? portal.b : portal.a;
+		// A cell already on the path is never entered again, which also stops loops
+		if (path & (1ull << next)) continue;
+
+		// The part of the doorway inside the current view
+		std::vector<glm::vec3> polygon = portal.corners;
+		for (const auto& plane : view.planes)
+		{
+			std::vector<glm::vec3> clipped;
+			for (size_t i = 0; i < polygon.size(); i++)
+			{
+				const glm::vec3& p = polygon[i];
+				const glm::vec3& q = polygon[(i + 1) % polygon.size()];
+				float dp = glm::dot(glm::vec3(plane), p) + plane.w;
+				float dq = glm::dot(glm::vec3(plane), q) + plane.w;
+				if (dp >= 0.0f) clipped.push_back(p);
+				if ((dp >= 0.0f) != (dq >= 0.0f)) clipped.push_back(p + (q - p) * (dp / (dp - dq)));
+			}
+			polygon.swap(clipped);
+			if (polygon.size() < 3) break;
+		}
+		if (polygon.size() < 3) continue;
+
+		// A doorway in view that can't be followed any further
+		if (depth >= MaxPortalDepth || viewCount >= MaxViews)
+		{
+			truncated = true;
+			return;
+		}
+
+		glm::vec3 normal = glm::cross(portal.corners[1] - portal.corners[0], portal.corners[2] - portal.corners[0]);
+		float length = glm::length(normal);
+		float distance = length > 0.0f ? glm::dot(normal / length, eye - portal.corners[0]) : 0.0f;
+
+		View narrowed;
+		if (std::fabs(distance) < Epsilon)
+		{
+			// Standing in the doorway, the next cell is seen through the whole current view
+			narrowed = view;
+		}
+		else
+		{
+			// One plane through the eye and each edge of the visible part of the doorway
+			glm::vec3 centroid(0.0f);
+			for (const auto& p : polygon) centroid += p;
+			centroid /= (float)polygon.size();
+			for (size_t i = 0; i < polygon.size(); i++)
+			{
+				glm::vec3 n = glm::cross(polygon[i] - eye, polygon[(i + 1) % polygon.size()] - eye);
+				float l = glm::length(n);
+				if (l < 1e-6f) continue;
+				n /= l;
+				glm::vec4 plane(n, -glm::dot(n, eye));
+				if (glm::dot(n, centroid) + plane.w < 0.0f) plane = -plane;
+				narrowed.planes.push_back(plane);
+			}
+			// Nothing on the eye's side of the doorway is seen through it
+			glm::vec3 away = normal / length * (distance > 0.0f ? -1.0f : 1.0f);
+			narrowed.planes.push_back(glm::vec4(away, -glm::dot(away, portal.corners[0])));
+			// Keeps the far plane of the camera
+			narrowed.planes.push_back(view.planes.back());
+		}
+		visit(next, eye, narrowed, path | (1ull << next), depth + 1);
+	}
+}
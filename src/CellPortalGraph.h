@@ -0,0 +1,94 @@
+#ifndef CELL_PORTAL_GRAPH_CLASS_H
+#define CELL_PORTAL_GRAPH_CLASS_H
+
+#include<cstdint>
+#include<string>
+#include<vector>
+#include<glm/glm.hpp>
+
+#include"AABB.h"
+#include"Frustum.h"
+
+// Splits the map into cells (rooms) joined by portals (doorways) and finds each frame which
+// cells the camera can see through the portals, and through which part of them.
+//
+// Cells and portals are authored in a text file, one per line, lengths in world units:
+//   cell <name> <min x y z> <max x y z>           a box of a cell, repeat the name for L-shaped rooms
+//   portal <cell> <cell> <x y z> <x y z> <x y z> <x y z>   the corners of a doorway, in order around it
+// When the file has no portals, every face two cells share becomes one, or with the map's wall
+// triangles given, every opening the walls leave in such a face.
+class CellPortalGraph
+{
+public:
+	// Cells are tracked in a 64 bit mask
+	static const int MaxCells = 64;
+
+	// Convex region the camera sees through a chain of portals
+	struct View
+	{
+		std::vector<glm::vec4> planes;
+		// Whether any part of a box may be inside
+		bool Intersects(const AABB& box) const;
+	};
+
+	// Reads the cells and portals from a file, returns false if it can't be read. Without portals in
+	// the file, doorways are found in the walls, three corners per triangle in world space
+	bool Load(const std::string& path, const std::vector<glm::vec3>& walls = {});
+	// Adds a box to a cell, creating the cell if the name is new, returns its index or -1 when full
+	int AddCell(const std::string& name, const AABB& box);
+	// Adds a doorway between two cells
+	void AddPortal(int a, int b, const std::vector<glm::vec3>& corners);
+	// Turns every face shared by the boxes of two cells into portals, one per opening the walls
+	// leave in it, the whole face when no walls are given
+	void AddSharedFacePortals(const std::vector<glm::vec3>& walls = {});
+	// Whether there is anything to traverse
+	bool Empty() const { return cells.empty(); }
+	// Changes whenever cells or portals are added
+	unsigned int Version() const { return version; }
+
+	// Writes for every box the mask of the cells it overlaps, 0 for boxes outside of every cell
+	void Assign(const AABBList& boxes, std::vector<uint64_t>& masks) const;
+	// Mask of the cells one box overlaps, for boxes that move every frame
+	uint64_t Mask(const AABB& box) const;
+	// Walks the portals from the cell holding the eye, narrowing the frustum at each one
+	void Traverse(const glm::vec3& eye, const Frustum& frustum);
+	// Whether a box overlapping the cells of a mask can be seen, boxes outside of every cell always can
+	bool Visible(uint64_t mask, const AABB& box) const;
+	// Cells reached by the last Traverse, every cell when the eye was outside of them or the
+	// traversal ran out of views or depth
+	uint64_t VisibleCells() const { return visibleCells; }
+	// Index of the cell the eye was in at the last Traverse, -1 if none
+	int EyeCell() const { return eyeCell; }
+private:
+	struct Portal
+	{
+		int a;
+		int b;
+		std::vector<glm::vec3> corners;
+	};
+	struct Cell
+	{
+		std::string name;
+		std::vector<AABB> boxes;
+		std::vector<int> portals;
+		// Every view the cell was reached through this frame
+		std::vector<View> views;
+	};
+
+	std::vector<Cell> cells;
+	std::vector<Portal> portals;
+	unsigned int version = 0;
+	uint64_t visibleCells = ~0ull;
+	int eyeCell = -1;
+	// Views gathered by the current Traverse
+	int viewCount = 0;
+	// Set when the current Traverse stopped before reaching every cell it could see
+	bool truncated = false;
+
+	// Index of the cell holding a point, -1 if none
+	int cellAt(const glm::vec3& point) const;
+	// Marks a cell as seen through a view and continues through its portals
+	void visit(int cell, const glm::vec3& eye, const View& view, uint64_t path, int depth);
+};
+
+#endif
@@ -0,0 +1,291 @@
+#include"ClusteredLights.h"
+#include<algorithm>
+#include<cfloat>
+#include<cmath>
+#include<future>
+
+// Constructor that creates the buffer textures and starts the binning threads
+ClusteredLights::ClusteredLights(unsigned int threads)
+	: clusterLights(Clusters), grid(Clusters), workers(std::make_unique<ThreadPool>(std::max(threads, 1u)))
+{
+	// Light data as three RGBA texels per light, an offset and count per cluster, and the light lists
+	const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R16UI };
+	glGenBuffers(3, buffers);
+	glGenTextures(3, textures);
+	for (int i = 0; i < 3; i++)
+	{
+		upload(i, nullptr, 0);
+		glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+	}
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+// Waits for the workers, the GL objects are released by Delete
+ClusteredLights::~ClusteredLights()
+{
+	workers.reset();
+}
+
+// Points the light samplers of a shader using default.frag at the units above
+void ClusteredLights::Attach(Shader& shader)
+{
+	shader.Activate();
+	shader.SetInt("lightData", LightUnit);
+	shader.SetInt("lightGrid", GridUnit);
+	shader.SetInt("lightIndices", IndexUnit);
+}
+
+// Assigns the lights to the clusters of the camera's view, uploads the lists and binds them
+void ClusteredLights::Update(const Camera& camera, float FOVdeg, float nearPlane, float farPlane, int viewportWidth, int viewportHeight, FrameUniforms& frame)
+{
+	float aspect = (float)camera.width / camera.height;
+	float tanHalfY = std::tan(glm::radians(FOVdeg) * 0.5f);
+	float tanHalfX = tanHalfY * aspect;
+	if (FOVdeg != boxesFov || aspect != boxesAspect || nearPlane != boxesNear || farPlane != boxesFar)
+	{
+		buildClusterBoxes(tanHalfX, tanHalfY, nearPlane, farPlane);
+		boxesFov = FOVdeg;
+		boxesAspect = aspect;
+		boxesNear = nearPlane;
+		boxesFar = farPlane;
+	}
+
+	// Slices grow exponentially with depth so clusters keep roughly the same shape
+	float logRatio = std::log(farPlane / nearPlane);
+	float sliceScale = Slices / logRatio;
+	float sliceBias = -Slices * std::log(nearPlane) / logRatio;
+	auto sliceOf = [&](float depth) { return std::clamp((int)std::floor(std::log(depth) * sliceScale + sliceBias), 0, Slices - 1); };
+	auto tileOf = [](float ndc, int tiles) { return std::clamp((int)std::floor((ndc * 0.5f + 0.5f) * tiles), 0, tiles - 1); };
+
+	// The range of clusters of each light in view, found once before the workers test them
+	glm::mat4 view = glm::lookAt(camera.Position, camera.Position + camera.Orientation, camera.Up);
+	visible.clear();
+	size_t count = enabled ? std::min(lights.size(), (size_t)UINT16_MAX) : 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		const PointLight& light = lights[i];
+		glm::vec3 p = glm::vec3(view * glm::vec4(light.position, 1.0f));
+		Bounds b;
+		b.center = glm::vec3(p.x, p.y, -p.z);
+		b.radius = light.radius;
+		float depth0 = std::max(b.center.z - b.radius, nearPlane);
+		float depth1 = std::min(b.center.z + b.radius, farPlane);
+		if (depth0 > depth1) continue;
+
+		// The box around the sphere projects inside the range spanned by its corners
+		float x0 = std::min((b.center.x - b.radius) / depth0, (b.center.x - b.radius) / depth1) / tanHalfX;
+		float x1 = std::max((b.center.x + b.radius) / depth0, (b.center.x + b.radius) / depth1) / tanHalfX;
+		float y0 = std::min((b.center.y - b.radius) / depth0, (b.center.y - b.radius) / depth1) / tanHalfY;
+		float y1 = std::max((b.center.y + b.radius) / depth0, (b.center.y + b.radius) / depth1) / tanHalfY;
+		if (x0 > 1.0f || x1 < -1.0f || y0 > 1.0f || y1 < -1.0f) continue;
+
+		b.slice0 = sliceOf(depth0);
+		b.slice1 = sliceOf(depth1);
+		b.tileX0 = tileOf(x0, TilesX);
+		b.tileX1 = tileOf(x1, TilesX);
+		b.tileY0 = tileOf(y0, TilesY);
+		b.tileY1 = tileOf(y1, TilesY);
+		b.light = (uint32_t)i;
+		visible.push_back(b);
+	}
+
+	// Every worker owns whole slices, so no two of them write the same cluster
+	int jobs = std::min((int)workers->Size(), Slices);
+	std::vector<std::future<void>> done;
+	for (int j = 0; j < jobs; j++)
+	{
+		int first = Slices * j / jobs;
+		int last = Slices * (j + 1) / jobs;
+		auto task = std::make_shared<std::packaged_task<void()>>([this, first, last]() { bin(first, last); });
+		done.push_back(task->get_future());
+		workers->Submit([task]() { (*task)(); });
+	}
+	for (auto& d : done) d.get();
+
+	indices.clear();
+	for (int cluster = 0; cluster < Clusters; cluster++)
+	{
+		grid[cluster] = glm::uvec2((unsigned int)indices.size(), (unsigned int)clusterLights[cluster].size());
+		indices.insert(indices.end(), clusterLights[cluster].begin(), clusterLights[cluster].end());
+	}
+
+	lightData.resize(count * 3);
+	for (size_t i = 0; i < count; i++)
+	{
+		const PointLight& light = lights[i];
+		lightData[i * 3 + 0] = glm::vec4(light.position, light.radius);
+		lightData[i * 3 + 1] = glm::vec4(light.color, light.intensity);
+		lightData[i * 3 + 2] = glm::vec4(glm::normalize(light.direction), light.cosOuterCone);
+	}
+	upload(0, lightData.data(), lightData.size() * sizeof(glm::vec4));
+	upload(1, grid.data(), grid.size() * sizeof(glm::uvec2));
+	upload(2, indices.data(), indices.size() * sizeof(uint16_t));
+
+	for (int i = 0; i < 3; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + LightUnit + i);
+		glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+	}
+	glActiveTexture(GL_TEXTURE0);
+
+	frame.camForward = camera.Orientation;
+	frame.clusterParams = glm::vec4(sliceScale, sliceBias, (float)viewportWidth / TilesX, (float)viewportHeight / TilesY);
+	frame.clusterGrid = glm::uvec4(TilesX, TilesY, Slices, (unsigned int)count);
+}
+
+// Deletes the buffers and textures
+void ClusteredLights::Delete()
+{
+	workers.reset();
+	glDeleteTextures(3, textures);
+	glDeleteBuffers(3, buffers);
+	for (int i = 0; i < 3; i++)
+	{
+		textures[i] = 0;
+		buffers[i] = 0;
+	}
+}
+
+// Height of a triangle above a point of the ground plane, false if the point is outside it
+static bool heightAt(const Mesh::Triangle& t, const glm::vec2& p, float& y)
+{
+	glm::vec2 a(t.a.x, t.a.z), b(t.b.x, t.b.z), c(t.c.x, t.c.z);
+	float area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+	// Walls have no height to give
+	if (std::abs(area) < 1e-8f) return false;
+	float u = ((b.x - p.x) * (c.y - p.y) - (c.x - p.x) * (b.y - p.y)) / area;
+	float v = ((c.x - p.x) * (a.y - p.y) - (a.x - p.x) * (c.y - p.y)) / area;
+	float w = 1.0f - u - v;
+	if (u < 0.0f || v < 0.0f || w < 0.0f) return false;
+	y = u * t.a.y + v * t.b.y + w * t.c.y;
+	return true;
+}
+
+// Places a light under every ceiling found above eyeHeight on a grid over the world triangles of the meshes
+std::vector<PointLight> ClusteredLights::CeilingLights(const std::vector<Mesh>& meshes, float eyeHeight, float spacing, const PointLight& light)
+{
+	std::vector<PointLight> placed;
+	glm::vec2 lo(FLT_MAX), hi(-FLT_MAX);
+	for (const auto& mesh : meshes)
+	{
+		for (const auto& t : mesh.worldTriangles)
+		{
+			for (const glm::vec3& v : { t.a, t.b, t.c })
+			{
+				lo = glm::min(lo, glm::vec2(v.x, v.z));
+				hi = glm::max(hi, glm::vec2(v.x, v.z));
+			}
+		}
+	}
+	if (lo.x > hi.x) return placed;
+
+	// Triangles sorted into the grid cells their footprint overlaps, so each spot only tests its own
+	int columns = (int)((hi.x - lo.x) / spacing) + 1;
+	int rows = (int)((hi.y - lo.y) / spacing) + 1;
+	std::vector<std::vector<const Mesh::Triangle*>> buckets((size_t)columns * rows);
+	for (const auto& mesh : meshes)
+	{
+		for (const auto& t : mesh.worldTriangles)
+		{
+			glm::vec2 tlo = glm::min(glm::min(glm::vec2(t.a.x, t.a.z), glm::vec2(t.b.x, t.b.z)), glm::vec2(t.c.x, t.c.z));
+			glm::vec2 thi = glm::max(glm::max(glm::vec2(t.a.x, t.a.z), glm::vec2(t.b.x, t.b.z)), glm::vec2(t.c.x, t.c.z));
+			int x0 = std::min((int)((tlo.x - lo.x) / spacing), columns - 1);
+			int x1 = std::min((int)((thi.x - lo.x) / spacing), columns - 1);
+			int z0 = std::min((int)((tlo.y - lo.y) / spacing), rows - 1);
+			int z1 = std::min((int)((thi.y - lo.y) / spacing), rows - 1);
+			for (int z = z0; z <= z1; z++)
+			{
+				for (int x = x0; x <= x1; x++) buckets[(size_t)z * columns + x].push_back(&t);
+			}
+		}
+	}
+
+	// A ceiling within reach above the eye and a floor below it mean the spot is indoors
+	const float reach = 4.0f;
+	for (int z = 0; z < rows; z++)
+	{
+		for (int x = 0; x < columns; x++)
+		{
+			glm::vec2 p = lo + glm::vec2(x + 0.5f, z + 0.5f) * spacing;
+			float ceiling = FLT_MAX;
+			bool floor = false;
+			for (const Mesh::Triangle* t : buckets[(size_t)z * columns + x])
+			{
+				float y;
+				if (!heightAt(*t, p, y)) continue;
+				if (y > eyeHeight) ceiling = std::min(ceiling, y);
+				else if (y > eyeHeight - reach) floor = true;
+			}
+			if (!floor || ceiling > eyeHeight + reach) continue;
+			PointLight l = light;
+			l.position = glm::vec3(p.x, ceiling - 0.25f, p.y);
+			placed.push_back(l);
+		}
+	}
+	return placed;
+}
+
+// Computes the view space box of every cluster
+void ClusteredLights::buildClusterBoxes(float tanHalfX, float tanHalfY, float nearPlane, float farPlane)
+{
+	clusterBoxes.resize(Clusters);
+	for (int slice = 0; slice < Slices; slice++)
+	{
+		float depth0 = nearPlane * std::pow(farPlane / nearPlane, (float)slice / Slices);
+		float depth1 = nearPlane * std::pow(farPlane / nearPlane, (float)(slice + 1) / Slices);
+		for (int y = 0; y < TilesY; y++)
+		{
+			float y0 = (-1.0f + 2.0f * y / TilesY) * tanHalfY;
+			float y1 = (-1.0f + 2.0f * (y + 1) / TilesY) * tanHalfY;
+			for (int x = 0; x < TilesX; x++)
+			{
+				float x0 = (-1.0f + 2.0f * x / TilesX) * tanHalfX;
+				float x1 = (-1.0f + 2.0f * (x + 1) / TilesX) * tanHalfX;
+				// The tile's sides are planes through the eye, so its extremes are at the slice's near or far depth
+				AABB& box = clusterBoxes[x + TilesX * (y + TilesY * slice)];
+				box.min = glm::vec3(std::min(x0 * depth0, x0 * depth1), std::min(y0 * depth0, y0 * depth1), depth0);
+				box.max = glm::vec3(std::max(x1 * depth0, x1 * depth1), std::max(y1 * depth0, y1 * depth1), depth1);
+			}
+		}
+	}
+}
+
+// Lists the lights of the clusters in slices [first, last)
+void ClusteredLights::bin(int first, int last)
+{
+	for (int cluster = first * TilesX * TilesY; cluster < last * TilesX * TilesY; cluster++) clusterLights[cluster].clear();
+
+	for (size_t i = 0; i < visible.size(); i++)
+	{
+		const Bounds& b = visible[i];
+		int slice0 = std::max(b.slice0, first);
+		int slice1 = std::min(b.slice1, last - 1);
+		for (int slice = slice0; slice <= slice1; slice++)
+		{
+			for (int y = b.tileY0; y <= b.tileY1; y++)
+			{
+				for (int x = b.tileX0; x <= b.tileX1; x++)
+				{
+					int cluster = x + TilesX * (y + TilesY * slice);
+					const AABB& box = clusterBoxes[cluster];
+					glm::vec3 closest = glm::clamp(b.center, box.min, box.max);
+					glm::vec3 d = closest - b.center;
+					if (glm::dot(d, d) > b.radius * b.radius) continue;
+					std::vector<uint16_t>& list = clusterLights[cluster];
+					if (list.size() < maxLightsPerCluster) list.push_back((uint16_t)b.light);
+				}
+			}
+		}
+	}
+}
+
+// Replaces the contents of a buffer, keeping it at least one element long
+void ClusteredLights::upload(int buffer, const void* data, size_t bytes)
+{
+	static const unsigned char empty[16] = {};
+	glBindBuffer(GL_TEXTURE_BUFFER, buffers[buffer]);
+	if (bytes == 0) glBufferData(GL_TEXTURE_BUFFER, sizeof(empty), empty, GL_STREAM_DRAW);
+	else glBufferData(GL_TEXTURE_BUFFER, bytes, data, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
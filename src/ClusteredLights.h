@@ -0,0 +1,105 @@
+#ifndef CLUSTERED_LIGHTS_CLASS_H
+#define CLUSTERED_LIGHTS_CLASS_H
+
+#include<glad/glad.h>
+#include<cstdint>
+#include<memory>
+#include<vector>
+#include<glm/glm.hpp>
+
+#include"Camera.h"
+#include"FrameUniforms.h"
+#include"Mesh.h"
+#include"shaderClass.h"
+#include"ThreadPool.h"
+
+// A light with a finite range, a spot light when cosOuterCone is above -1
+struct PointLight
+{
+	glm::vec3 position = glm::vec3(0.0f);
+	float radius = 5.0f;
+	glm::vec3 color = glm::vec3(1.0f);
+	float intensity = 1.0f;
+	glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+	float cosOuterCone = -1.0f;
+};
+
+// Splits the view frustum into a grid of clusters, screen tiles by depth slices, and lists
+// the lights touching each one on worker threads every frame, so a fragment only shades the
+// lights of its own cluster however many lights the scene has. The lights, the per-cluster
+// ranges and the light lists go to the shaders as buffer textures.
+class ClusteredLights
+{
+public:
+	// Screen tiles across, screen tiles down and depth slices of the grid
+	static constexpr int TilesX = 16;
+	static constexpr int TilesY = 9;
+	static constexpr int Slices = 24;
+	static constexpr int Clusters = TilesX * TilesY * Slices;
+	// Texture units of the light data, cluster ranges and light lists
+	static constexpr GLuint LightUnit = 13;
+	static constexpr GLuint GridUnit = 14;
+	static constexpr GLuint IndexUnit = 15;
+
+	// Every light of the scene, at most 65535
+	std::vector<PointLight> lights;
+	// Lights past this many in one cluster are dropped
+	size_t maxLightsPerCluster = 128;
+	// When false no light is assigned and the shaders skip the loop
+	bool enabled = true;
+
+	// Constructor that creates the buffer textures and starts the binning threads
+	ClusteredLights(unsigned int threads);
+	// Waits for the workers, the GL objects are released by Delete
+	~ClusteredLights();
+	ClusteredLights(const ClusteredLights&) = delete;
+	ClusteredLights& operator=(const ClusteredLights&) = delete;
+
+	// Points the light samplers of a shader using default.frag at the units above
+	void Attach(Shader& shader);
+	// Assigns the lights to the clusters of the camera's view, uploads the lists, binds them
+	// and writes the grid parameters for a viewport of the given size to the frame uniforms
+	void Update(const Camera& camera, float FOVdeg, float nearPlane, float farPlane, int viewportWidth, int viewportHeight, FrameUniforms& frame);
+	// Light references written by the last Update, summed over every cluster
+	size_t Assigned() const { return indices.size(); }
+	// Deletes the buffers and textures
+	void Delete();
+
+	// Places a light under every ceiling found above eyeHeight on a grid of the given spacing
+	// over the world triangles of the meshes, keeping only spots with a floor below
+	static std::vector<PointLight> CeilingLights(const std::vector<Mesh>& meshes, float eyeHeight, float spacing, const PointLight& light);
+
+private:
+	// A light in view space with depth growing away from the camera, and the clusters it may touch
+	struct Bounds
+	{
+		glm::vec3 center;
+		float radius;
+		uint32_t light;
+		int slice0, slice1;
+		int tileX0, tileX1;
+		int tileY0, tileY1;
+	};
+
+	GLuint buffers[3] = { 0, 0, 0 };
+	GLuint textures[3] = { 0, 0, 0 };
+	// Box of every cluster in view space, rebuilt when the projection changes
+	std::vector<AABB> clusterBoxes;
+	float boxesFov = 0.0f, boxesAspect = 0.0f, boxesNear = 0.0f, boxesFar = 0.0f;
+	std::vector<Bounds> visible;
+	// Lights of each cluster, each written by the worker that owns its slice
+	std::vector<std::vector<uint16_t>> clusterLights;
+	std::vector<glm::uvec2> grid;
+	std::vector<uint16_t> indices;
+	std::vector<glm::vec4> lightData;
+	std::unique_ptr<ThreadPool> workers;
+
+	// Computes the view space box of every cluster
+	void buildClusterBoxes(float tanHalfX, float tanHalfY, float nearPlane, float farPlane);
+	// Lists the lights of the clusters in slices [first, last)
+	void bin(int first, int last);
+	// Replaces the contents of a buffer, keeping it at least one element long
+	void upload(int buffer, const void* data, size_t bytes);
+};
+
+#endif
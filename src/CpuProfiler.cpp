@@ -0,0 +1,182 @@
+#include"CpuProfiler.h"
+#include"Logger.h"
+#include<chrono>
+#include<cstdio>
+#include<memory>
+#include<mutex>
+#include<vector>
+
+std::atomic<bool> CpuProfiler::capturing{ false };
+
+namespace
+{
+	struct Event
+	{
+		const char* name;
+		uint64_t start;
+		uint64_t end;
+	};
+
+	// Events are stored in chunks allocated as a thread needs them, past the last one they're dropped
+	constexpr size_t ChunkEvents = 4096;
+	constexpr size_t MaxChunks = 256;
+
+	// Written only by its own thread; the exporter reads the events below the published count
+	struct ThreadBuffer
+	{
+		std::atomic<Event*> chunks[MaxChunks] = {};
+		std::atomic<size_t> count{ 0 };
+		// Capture the events belong to, the owner empties the buffer when a new one starts
+		std::atomic<unsigned int> capture{ 0 };
+		std::atomic<size_t> dropped{ 0 };
+		unsigned int id = 0;
+		// Guarded by the registry mutex
+		std::string name;
+
+		~ThreadBuffer()
+		{
+			for (auto& chunk : chunks) delete[] chunk.load(std::memory_order_relaxed);
+		}
+	};
+
+	// Buffers outlive their threads so finished workers still show up in the trace
+	std::mutex registryMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> registry;
+	std::atomic<unsigned int> capture{ 0 };
+	uint64_t captureStart = 0;
+	thread_local ThreadBuffer* localBuffer = nullptr;
+
+	// The calling thread's buffer, registered on first use
+	ThreadBuffer& threadBuffer()
+	{
+		if (localBuffer == nullptr)
+		{
+			std::lock_guard<std::mutex> lock(registryMutex);
+			registry.push_back(std::make_unique<ThreadBuffer>());
+			localBuffer = registry.back().get();
+			localBuffer->id = (unsigned int)registry.size();
+			localBuffer->name = "Thread " + std::to_string(localBuffer->id);
+		}
+		return *localBuffer;
+	}
+
+	// Writes a string as a JSON string
+	void writeString(FILE* file, const char* text)
+	{
+		fputc('"', file);
+		for (const char* c = text; *c != '\0'; c++)
+		{
+			if (*c == '"' || *c == '\\') fputc('\\', file);
+			fputc(*c, file);
+		}
+		fputc('"', file);
+	}
+}
+
+// Starts a new capture, dropping the zones of the last one
+void CpuProfiler::Start()
+{
+	if (!CPU_PROFILER_ENABLED) LOG_WARNING("CPU profiler zones are compiled out of this build");
+	captureStart = Now();
+	capture.fetch_add(1, std::memory_order_release);
+	capturing.store(true, std::memory_order_relaxed);
+}
+
+// Stops recording new zones, the ones already open still end in the capture
+void CpuProfiler::Stop()
+{
+	capturing.store(false, std::memory_order_relaxed);
+}
+
+// Writes the zones of the current or last capture to a trace file, false if it can't be written
+bool CpuProfiler::Export(const std::string& path)
+{
+	FILE* file = std::fopen(path.c_str(), "w");
+	if (file == nullptr) return false;
+
+	std::vector<std::pair<ThreadBuffer*, std::string>> buffers;
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		for (auto& buffer : registry) buffers.emplace_back(buffer.get(), buffer->name);
+	}
+
+	unsigned int current = capture.load(std::memory_order_acquire);
+	size_t events = 0, dropped = 0;
+	std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool first = true;
+	for (auto& [buffer, name] : buffers)
+	{
+		// A buffer still holding an older capture has nothing recorded in this one
+		if (buffer->capture.load(std::memory_order_acquire) != current) continue;
+		size_t count = buffer->count.load(std::memory_order_acquire);
+
+		std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", buffer->id);
+		writeString(file, name.c_str());
+		std::fprintf(file, "}}");
+		first = false;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			const Event& event = buffer->chunks[i / ChunkEvents].load(std::memory_order_acquire)[i % ChunkEvents];
+			// Zones opened before the capture started are left out
+			if (event.start < captureStart) continue;
+			std::fprintf(file, ",\n{\"name\":");
+			writeString(file, event.name);
+			std::fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				buffer->id, (event.start - captureStart) / 1000.0, (event.end - event.start) / 1000.0);
+			events++;
+		}
+		dropped += buffer->dropped.load(std::memory_order_relaxed);
+	}
+	std::fprintf(file, "\n]}\n");
+	bool ok = std::ferror(file) == 0;
+	std::fclose(file);
+
+	if (dropped > 0) LOG_INFO("Wrote %zu zones to %s, %zu dropped with full buffers", events, path.c_str(), dropped);
+	else LOG_INFO("Wrote %zu zones to %s", events, path.c_str());
+	return ok;
+}
+
+// Names the calling thread in the trace
+void CpuProfiler::SetThreadName(const char* name)
+{
+	ThreadBuffer& buffer = threadBuffer();
+	std::lock_guard<std::mutex> lock(registryMutex);
+	buffer.name = name;
+}
+
+// Nanoseconds on a steady clock
+uint64_t CpuProfiler::Now()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Adds a finished zone to the calling thread's buffer
+void CpuProfiler::Record(const char* name, uint64_t start, uint64_t end)
+{
+	ThreadBuffer& buffer = threadBuffer();
+	unsigned int current = capture.load(std::memory_order_acquire);
+	if (buffer.capture.load(std::memory_order_relaxed) != current)
+	{
+		// Emptied before the new capture is published, so the exporter never sees old events under it
+		buffer.count.store(0, std::memory_order_relaxed);
+		buffer.dropped.store(0, std::memory_order_relaxed);
+		buffer.capture.store(current, std::memory_order_release);
+	}
+
+	size_t count = buffer.count.load(std::memory_order_relaxed);
+	if (count >= ChunkEvents * MaxChunks)
+	{
+		buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	std::atomic<Event*>& slot = buffer.chunks[count / ChunkEvents];
+	Event* chunk = slot.load(std::memory_order_relaxed);
+	if (chunk == nullptr)
+	{
+		chunk = new Event[ChunkEvents];
+		slot.store(chunk, std::memory_order_release);
+	}
+	chunk[count % ChunkEvents] = { name, start, end };
+	buffer.count.store(count + 1, std::memory_order_release);
+}
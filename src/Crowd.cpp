@@ -0,0 +1,147 @@
+#include"Crowd.h"
+#include"DebugDraw.h"
+#include"RenderQueue.h"
+#include<algorithm>
+#include<cfloat>
+#include<cmath>
+#include<cstddef>
+#include<glm/gtc/matrix_inverse.hpp>
+#include<glm/gtc/matrix_transform.hpp>
+
+// Constructor that seeds the random paths
+Crowd::Crowd(const AABB& area, unsigned int seed)
+	: area(area), random(seed)
+{
+}
+
+// Adds the per-instance model matrix at attribute locations 5 to 8 and its normal matrix at 9 to 11 of the model's meshes
+void Crowd::Attach(std::vector<Mesh>& meshes)
+{
+	if (instanceBuffer == 0) glGenBuffers(1, &instanceBuffer);
+
+	localBounds = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	for (auto& mesh : meshes)
+	{
+		localBounds.min = glm::min(localBounds.min, mesh.localAABB.min);
+		localBounds.max = glm::max(localBounds.max, mesh.localAABB.max);
+
+		// A matrix attribute takes one location per column
+		mesh.VAO.Bind();
+		for (GLuint column = 0; column < 4; column++)
+		{
+			glVertexAttribPointer(5 + column, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offsetof(Instance, model) + column * sizeof(glm::vec4)));
+			glVertexAttribDivisor(5 + column, 1);
+			glEnableVertexAttribArray(5 + column);
+		}
+		for (GLuint column = 0; column < 3; column++)
+		{
+			glVertexAttribPointer(9 + column, 3, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offsetof(Instance, normalMatrix) + column * sizeof(glm::vec3)));
+			glVertexAttribDivisor(9 + column, 1);
+			glEnableVertexAttribArray(9 + column);
+		}
+		mesh.VAO.Unbind();
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Adds or removes agents, new ones start at random points
+void Crowd::Resize(size_t count)
+{
+	std::uniform_real_distribution<float> speed(minSpeed, maxSpeed);
+	while (agents.size() < count)
+	{
+		glm::vec3 start = randomPoint();
+		agents.push_back({ start, start, randomPoint(), speed(random) });
+	}
+	agents.resize(count);
+}
+
+// Walks every agent towards its target, picking a new one on arrival
+void Crowd::Update(float deltaTime)
+{
+	for (auto& agent : agents)
+	{
+		agent.previous = agent.position;
+		glm::vec3 toTarget = agent.target - agent.position;
+		float distance = glm::length(toTarget);
+		float step = agent.speed * deltaTime;
+		if (distance <= step)
+		{
+			agent.position = agent.target;
+			agent.target = randomPoint();
+		}
+		else
+		{
+			agent.position += toTarget * (step / distance);
+		}
+	}
+}
+
+// Writes the matrices of the agents the queue's frustum, portals and occluders let through to
+// the instance buffer, each placed alpha of the way from where it was before the last Update to where it is now
+void Crowd::Upload(const RenderQueue& queue, float alpha)
+{
+	instances.clear();
+	for (const auto& agent : agents)
+	{
+		glm::mat4 model = matrix(agent, glm::mix(agent.previous, agent.position, alpha));
+		if (queue.Visible(transformAABB(localBounds, model))) instances.push_back({ model, glm::inverseTranspose(glm::mat3(model)) });
+	}
+	visible = instances.size();
+	if (instanceBuffer == 0 || instances.empty()) return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	capacity = std::max(instances.size(), capacity);
+	// Orphans last frame's storage so the GPU can keep reading it
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(Instance), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(Instance), instances.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Draws the uploaded agents with variants taking the model matrix as an instance attribute
+void Crowd::Draw(std::vector<Mesh>& meshes, ShaderVariants& variants, uint32_t features, GLStateCache& state)
+{
+	if (visible == 0) return;
+	for (auto& mesh : meshes)
+	{
+		Shader& shader = variants.Get(features | MeshFeatures(mesh));
+		state.UseProgram(shader.ID);
+		state.BindVertexArray(mesh.VAO.ID);
+		mesh.BindTextures(shader, state);
+		glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)mesh.indices.size(), GL_UNSIGNED_INT, 0, (GLsizei)visible);
+		state.Draw();
+	}
+}
+
+// Adds a line from every agent to the point it walks to
+void Crowd::DrawPaths(DebugDraw& debug, uint32_t color) const
+{
+	for (const Agent& agent : agents) debug.Line(agent.position, agent.target, color);
+}
+
+// Deletes the instance buffer
+void Crowd::Delete()
+{
+	if (instanceBuffer != 0) glDeleteBuffers(1, &instanceBuffer);
+	instanceBuffer = 0;
+}
+
+// Random point of the area
+glm::vec3 Crowd::randomPoint()
+{
+	std::uniform_real_distribution<float> x(area.min.x, area.max.x);
+	std::uniform_real_distribution<float> z(area.min.z, area.max.z);
+	return glm::vec3(x(random), area.min.y, z(random));
+}
+
+// Model matrix of an agent at position, facing the way it walks
+glm::mat4 Crowd::matrix(const Agent& agent, const glm::vec3& position) const
+{
+	glm::vec3 direction = agent.target - position;
+	// The model faces +z, as Nathan's 90 degree turn to walk along +x shows
+	float angle = std::atan2(direction.x, direction.z);
+	glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+	model = glm::scale(model, glm::vec3(scale));
+	return glm::rotate(model, angle, glm::vec3(0.0f, 1.0f, 0.0f));
+}
@@ -0,0 +1,86 @@
+#ifndef CROWD_CLASS_H
+#define CROWD_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<random>
+#include<vector>
+
+#include"AABB.h"
+#include"GLStateCache.h"
+#include"Mesh.h"
+#include"ShaderVariants.h"
+
+class DebugDraw;
+class RenderQueue;
+
+// Many copies of one model walking independently between random points of an area, drawn
+// with one instanced draw per mesh from a buffer of model matrices written once per frame
+class Crowd
+{
+public:
+	// Where the agents pick the points they walk to, at the height of its min
+	AABB area;
+	// Scale applied to the model of every agent
+	float scale = 0.0088f;
+	// Walking speeds, in units per second, are picked between these
+	float minSpeed = 1.5f;
+	float maxSpeed = 2.5f;
+
+	// Constructor that seeds the random paths
+	Crowd(const AABB& area, unsigned int seed = 1);
+
+	// Adds the per-instance model matrix at attribute locations 5 to 8 and its normal matrix at 9 to 11 of the model's meshes
+	void Attach(std::vector<Mesh>& meshes);
+	// Adds or removes agents, new ones start at random points
+	void Resize(size_t count);
+	// Walks every agent towards its target, picking a new one on arrival
+	void Update(float deltaTime);
+	// Writes the matrices of the agents the queue's frustum, portals and occluders let through to
+	// the instance buffer, each placed alpha of the way from where it was before the last Update
+	// to where it is now; the queue's Begin must have been called for this frame
+	void Upload(const RenderQueue& queue, float alpha = 1.0f);
+	// Draws the uploaded agents with variants taking the model matrix as an instance attribute,
+	// each mesh with the given features and the ones it needs
+	void Draw(std::vector<Mesh>& meshes, ShaderVariants& variants, uint32_t features, GLStateCache& state);
+	// Adds a line from every agent to the point it walks to
+	void DrawPaths(DebugDraw& debug, uint32_t color) const;
+	// Deletes the instance buffer
+	void Delete();
+
+	// Number of agents
+	size_t Size() const { return agents.size(); }
+	// Number of agents drawn by the last Upload
+	size_t Visible() const { return visible; }
+private:
+	struct Agent
+	{
+		glm::vec3 position;
+		// Position before the last Update
+		glm::vec3 previous;
+		glm::vec3 target;
+		float speed;
+	};
+
+	std::vector<Agent> agents;
+	std::mt19937 random;
+	// Bounds of the model before scale and rotation
+	AABB localBounds = { glm::vec3(0.0f), glm::vec3(0.0f) };
+	// Per-instance attributes, mirrors instanced.vert
+	struct Instance
+	{
+		glm::mat4 model;
+		glm::mat3 normalMatrix;
+	};
+	std::vector<Instance> instances;
+	GLuint instanceBuffer = 0;
+	size_t capacity = 0;
+	size_t visible = 0;
+
+	// Random point of the area
+	glm::vec3 randomPoint();
+	// Model matrix of an agent at position, facing the way it walks
+	glm::mat4 matrix(const Agent& agent, const glm::vec3& position) const;
+};
+
+#endif
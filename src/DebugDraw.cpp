@@ -0,0 +1,181 @@
+#include"DebugDraw.h"
+#include"GLExtensions.h"
+#include<algorithm>
+#include<cstddef>
+
+// Packs a color into the bytes of a vertex
+uint32_t DebugDraw::Color(float r, float g, float b, float a)
+{
+	auto byte = [](float value) { return (uint32_t)(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f); };
+	return byte(r) | (byte(g) << 8) | (byte(b) << 16) | (byte(a) << 24);
+}
+
+// Constructor that creates the line shader and room for maxLines lines per frame
+DebugDraw::DebugDraw(size_t maxLines)
+	: shader("src/debugLines.vert", "src/debugLines.frag"), maxVertices(maxLines * 2)
+{
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	if (glExt.BufferStorage != nullptr)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		GLsizeiptr bytes = (GLsizeiptr)(Frames * maxVertices * sizeof(Vertex));
+		glExt.BufferStorage(GL_ARRAY_BUFFER, bytes, nullptr, flags);
+		mapped = (Vertex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, flags);
+	}
+	if (mapped == nullptr)
+	{
+		// A buffer with immutable storage can't be resized, so the fallback starts from a fresh one
+		if (glExt.BufferStorage != nullptr)
+		{
+			glDeleteBuffers(1, &VBO);
+			glGenBuffers(1, &VBO);
+			glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		}
+		glBufferData(GL_ARRAY_BUFFER, maxVertices * sizeof(Vertex), nullptr, GL_STREAM_DRAW);
+		client.reserve(maxVertices);
+	}
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)offsetof(Vertex, color));
+	glEnableVertexAttribArray(1);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Adds a line
+void DebugDraw::Line(const glm::vec3& a, const glm::vec3& b, uint32_t color)
+{
+	Vertex* vertices = reserve(2);
+	if (vertices == nullptr) return;
+	vertices[0] = { a, color };
+	vertices[1] = { b, color };
+}
+
+// Adds the 12 edges of a box
+void DebugDraw::Box(const AABB& box, uint32_t color)
+{
+	Box(box, glm::mat4(1.0f), color);
+}
+
+// Adds the 12 edges of a box in a model's space
+void DebugDraw::Box(const AABB& box, const glm::mat4& model, uint32_t color)
+{
+	static const int edges[24] = {
+		0,1, 1,2, 2,3, 3,0, // bottom
+		4,5, 5,6, 6,7, 7,4, // top
+		0,4, 1,5, 2,6, 3,7  // sides
+	};
+	Vertex* vertices = reserve(24);
+	if (vertices == nullptr) return;
+	const glm::vec3& min = box.min;
+	const glm::vec3& max = box.max;
+	glm::vec3 corners[8] = {
+		{min.x, min.y, min.z}, {max.x, min.y, min.z},
+		{max.x, max.y, min.z}, {min.x, max.y, min.z},
+		{min.x, min.y, max.z}, {max.x, min.y, max.z},
+		{max.x, max.y, max.z}, {min.x, max.y, max.z}
+	};
+	for (auto& corner : corners) corner = glm::vec3(model * glm::vec4(corner, 1.0f));
+	for (int i = 0; i < 24; i++) vertices[i] = { corners[edges[i]], color };
+}
+
+// Adds three crossing lines of the given size at a point
+void DebugDraw::Cross(const glm::vec3& point, float size, uint32_t color)
+{
+	float half = size * 0.5f;
+	Line(point - glm::vec3(half, 0.0f, 0.0f), point + glm::vec3(half, 0.0f, 0.0f), color);
+	Line(point - glm::vec3(0.0f, half, 0.0f), point + glm::vec3(0.0f, half, 0.0f), color);
+	Line(point - glm::vec3(0.0f, 0.0f, half), point + glm::vec3(0.0f, 0.0f, half), color);
+}
+
+// Adds lines joining the points in order
+void DebugDraw::Path(const std::vector<glm::vec3>& points, uint32_t color, bool closed)
+{
+	for (size_t i = 1; i < points.size(); i++) Line(points[i - 1], points[i], color);
+	if (closed && points.size() > 2) Line(points.back(), points.front(), color);
+}
+
+// Draws the lines added since the last Flush with one draw call and starts over
+void DebugDraw::Flush(GLStateCache& state)
+{
+	lastLines = count / 2;
+	if (count > 0)
+	{
+		GLint first = 0;
+		if (mapped != nullptr)
+		{
+			first = (GLint)(region * maxVertices);
+		}
+		else
+		{
+			// Orphans last frame's storage so the copy doesn't wait for the GPU to read it
+			glBindBuffer(GL_ARRAY_BUFFER, VBO);
+			glBufferData(GL_ARRAY_BUFFER, maxVertices * sizeof(Vertex), nullptr, GL_STREAM_DRAW);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(Vertex), client.data());
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		state.UseProgram(shader.ID);
+		state.BindVertexArray(VAO);
+		glDrawArrays(GL_LINES, first, (GLsizei)count);
+		state.Draw();
+		if (mapped != nullptr) fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	count = 0;
+	client.clear();
+	if (mapped == nullptr) return;
+
+	// The next region was drawn Frames - 1 frames ago, so this almost never waits
+	region = (region + 1) % Frames;
+	if (fences[region] != 0)
+	{
+		glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		glDeleteSync(fences[region]);
+		fences[region] = 0;
+	}
+}
+
+// Deletes the buffer, vertex array and shader
+void DebugDraw::Delete()
+{
+	for (GLsync& fence : fences)
+	{
+		if (fence != 0) glDeleteSync(fence);
+		fence = 0;
+	}
+	if (mapped != nullptr)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		mapped = nullptr;
+	}
+	glDeleteBuffers(1, &VBO);
+	glDeleteVertexArrays(1, &VAO);
+	shader.Delete();
+}
+
+// Room for vertices in this frame's lines, nullptr if the frame is full
+DebugDraw::Vertex* DebugDraw::reserve(size_t vertices)
+{
+	if (!enabled) return nullptr;
+	if (count + vertices > maxVertices)
+	{
+		dropped += vertices / 2;
+		return nullptr;
+	}
+	Vertex* start;
+	if (mapped != nullptr)
+	{
+		start = mapped + region * maxVertices + count;
+	}
+	else
+	{
+		client.resize(count + vertices);
+		start = client.data() + count;
+	}
+	count += vertices;
+	return start;
+}
@@ -0,0 +1,80 @@
+#ifndef DEBUG_DRAW_CLASS_H
+#define DEBUG_DRAW_CLASS_H
+
+#include<glad/glad.h>
+#include<cstdint>
+#include<vector>
+#include<glm/glm.hpp>
+
+#include"AABB.h"
+#include"GLStateCache.h"
+#include"shaderClass.h"
+
+// Collects world space lines from anywhere on the main thread during a frame and draws them
+// all with one draw call. With GL 4.4 the lines are written straight into a persistently
+// mapped buffer split in one region per frame in flight, a fence per region tells when the
+// GPU is done reading it; otherwise they are copied in at Flush.
+class DebugDraw
+{
+public:
+	// Regions of the buffer, so the CPU writes one while the GPU still reads the others
+	static constexpr int Frames = 3;
+
+	// Packs a color into the bytes of a vertex
+	static uint32_t Color(float r, float g, float b, float a = 1.0f);
+	static constexpr uint32_t Red = 0xFF0000FFu;
+	static constexpr uint32_t Green = 0xFF00FF00u;
+	static constexpr uint32_t Yellow = 0xFF00FFFFu;
+	static constexpr uint32_t Cyan = 0xFFFFFF00u;
+
+	// When false lines are thrown away and Flush draws nothing
+	bool enabled = true;
+
+	// Constructor that creates the line shader and room for maxLines lines per frame
+	DebugDraw(size_t maxLines = 65536);
+	DebugDraw(const DebugDraw&) = delete;
+	DebugDraw& operator=(const DebugDraw&) = delete;
+
+	// Adds a line
+	void Line(const glm::vec3& a, const glm::vec3& b, uint32_t color);
+	// Adds the 12 edges of a box
+	void Box(const AABB& box, uint32_t color);
+	// Adds the 12 edges of a box in a model's space
+	void Box(const AABB& box, const glm::mat4& model, uint32_t color);
+	// Adds three crossing lines of the given size at a point
+	void Cross(const glm::vec3& point, float size, uint32_t color);
+	// Adds lines joining the points in order
+	void Path(const std::vector<glm::vec3>& points, uint32_t color, bool closed = false);
+	// Draws the lines added since the last Flush with one draw call and starts over
+	void Flush(GLStateCache& state);
+	// Lines drawn by the last Flush
+	size_t Lines() const { return lastLines; }
+	// Lines lost because the frame had more than maxLines
+	size_t Dropped() const { return dropped; }
+	// Deletes the buffer, vertex array and shader
+	void Delete();
+private:
+	struct Vertex
+	{
+		glm::vec3 position;
+		uint32_t color;
+	};
+
+	Shader shader;
+	GLuint VAO = 0;
+	GLuint VBO = 0;
+	size_t maxVertices;
+	// The whole buffer when persistently mapped, nullptr when lines go through client memory
+	Vertex* mapped = nullptr;
+	std::vector<Vertex> client;
+	int region = 0;
+	GLsync fences[Frames] = {};
+	size_t count = 0;
+	size_t lastLines = 0;
+	size_t dropped = 0;
+
+	// Room for vertices in this frame's lines, nullptr if the frame is full
+	Vertex* reserve(size_t vertices);
+};
+
+#endif
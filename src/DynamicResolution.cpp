@@ -0,0 +1,133 @@
+#include"DynamicResolution.h"
+#include"Logger.h"
+#include<algorithm>
+#include<cmath>
+
+// Constructor that creates a render target big enough for the window at maxScale
+DynamicResolution::DynamicResolution(int windowWidth, int windowHeight, float maxScale)
+	: maxScale(maxScale), windowWidth(windowWidth), windowHeight(windowHeight), width(windowWidth), height(windowHeight), scale(maxScale)
+{
+	int maxWidth = (int)std::ceil(windowWidth * maxScale);
+	int maxHeight = (int)std::ceil(windowHeight * maxScale);
+
+	glGenRenderbuffers(1, &colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, maxWidth, maxHeight);
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, maxWidth, maxHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (!complete) LOG_WARNING("Dynamic resolution render target incomplete, drawing at full resolution");
+
+	glGenQueries(Queries, queries);
+}
+
+// Reads the finished timer queries, picks this frame's scale, binds the target and starts timing
+void DynamicResolution::Begin()
+{
+	// Oldest first, stopping at the first the GPU hasn't reached so the times stay in order
+	for (;;)
+	{
+		int oldest = -1;
+		for (int i = 0; i < Queries; i++)
+		{
+			if (pending[i] && (oldest < 0 || issued[i] < issued[oldest])) oldest = i;
+		}
+		if (oldest < 0) break;
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(queries[oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == GL_FALSE) break;
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(queries[oldest], GL_QUERY_RESULT, &nanoseconds);
+		pending[oldest] = false;
+		adjust(nanoseconds / 1.0e6);
+	}
+
+	float current = scaled() ? scale : 1.0f;
+	width = std::max(1, (int)(windowWidth * current));
+	height = std::max(1, (int)(windowHeight * current));
+	glBindFramebuffer(GL_FRAMEBUFFER, active() ? framebuffer : 0);
+	glViewport(0, 0, width, height);
+
+	// When every query is still in flight this frame goes untimed
+	timing = -1;
+	for (int i = 0; i < Queries; i++)
+	{
+		if (!pending[i])
+		{
+			timing = i;
+			break;
+		}
+	}
+	if (timing >= 0) glBeginQuery(GL_TIME_ELAPSED, queries[timing]);
+	frame++;
+}
+
+// Stops timing and upscales the target into the window's framebuffer
+void DynamicResolution::End()
+{
+	if (timing >= 0)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		pending[timing] = true;
+		issued[timing] = frame;
+	}
+
+	if (active())
+	{
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBlitFramebuffer(0, 0, width, height, 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+	glViewport(0, 0, windowWidth, windowHeight);
+}
+
+// Reads this frame's pixels, bottom row first, as RGBA; false if the frame isn't in the render target
+bool DynamicResolution::ReadPixels(std::vector<unsigned char>& pixels) const
+{
+	if (!active()) return false;
+	pixels.resize((size_t)width * height * 4);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	return true;
+}
+
+// Deletes the framebuffer, renderbuffers and queries
+void DynamicResolution::Delete()
+{
+	glDeleteQueries(Queries, queries);
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &colorBuffer);
+	glDeleteRenderbuffers(1, &depthBuffer);
+	framebuffer = colorBuffer = depthBuffer = 0;
+	complete = false;
+}
+
+// Feeds a measured GPU time to the scale
+void DynamicResolution::adjust(double milliseconds)
+{
+	gpuMilliseconds = gpuMilliseconds == 0.0 ? milliseconds : gpuMilliseconds * 0.8 + milliseconds * 0.2;
+	if (gpuMilliseconds > targetMilliseconds)
+	{
+		// The cost follows the pixel count, the square of the scale; drops fast but not all at once
+		float factor = (float)std::sqrt(targetMilliseconds / gpuMilliseconds);
+		scale *= std::max(factor, 0.9f);
+	}
+	else if (gpuMilliseconds < targetMilliseconds * headroom)
+	{
+		// Grows slowly so it doesn't swing back over the target
+		scale += 0.01f;
+	}
+	scale = std::clamp(scale, minScale, maxScale);
+}
@@ -0,0 +1,75 @@
+#ifndef DYNAMIC_RESOLUTION_CLASS_H
+#define DYNAMIC_RESOLUTION_CLASS_H
+
+#include<glad/glad.h>
+#include<vector>
+
+// Renders the scene into an offscreen target whose resolution follows the GPU time of the
+// previous frames, measured with timer queries read back a few frames late so they never
+// stall, and upscales it to the window with a blit. Heavy views lose pixels instead of frames.
+class DynamicResolution
+{
+public:
+	// Bounds of the scale applied to both sides of the window
+	float minScale = 0.5f;
+	float maxScale = 1.0f;
+	// GPU time per frame to stay under, in milliseconds
+	double targetMilliseconds = 15.0;
+	// The scale only grows again once the GPU time is below this fraction of the target
+	double headroom = 0.8;
+	// When false the scene is drawn straight to the window, the GPU time is still measured
+	bool enabled = true;
+	// When set the frame goes through the render target even at full resolution, so it can be read back
+	bool offscreen = false;
+
+	// Constructor that creates a render target big enough for the window at maxScale
+	DynamicResolution(int windowWidth, int windowHeight, float maxScale = 1.0f);
+	DynamicResolution(const DynamicResolution&) = delete;
+	DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+	// Reads the finished timer queries, picks this frame's scale, binds the target and starts timing
+	void Begin();
+	// Stops timing and upscales the target into the window's framebuffer
+	void End();
+	// Size the scene is rendered at this frame
+	int Width() const { return width; }
+	int Height() const { return height; }
+	// Scale of this frame
+	float Scale() const { return scaled() ? scale : 1.0f; }
+	// GPU time of the latest measured frame, smoothed, in milliseconds
+	double GpuMilliseconds() const { return gpuMilliseconds; }
+	// Reads this frame's pixels, bottom row first, as RGBA; false if the frame isn't in the render target
+	bool ReadPixels(std::vector<unsigned char>& pixels) const;
+	// Deletes the framebuffer, renderbuffers and queries
+	void Delete();
+private:
+	static constexpr int Queries = 4;
+
+	int windowWidth;
+	int windowHeight;
+	int width;
+	int height;
+	float scale = 1.0f;
+	double gpuMilliseconds = 0.0;
+
+	GLuint framebuffer = 0;
+	GLuint colorBuffer = 0;
+	GLuint depthBuffer = 0;
+	bool complete = false;
+
+	GLuint queries[Queries] = {};
+	bool pending[Queries] = {};
+	// Frames the queries were issued in, read back in that order
+	unsigned int issued[Queries] = {};
+	unsigned int frame = 0;
+	int timing = -1;
+
+	// Whether this frame goes through the offscreen target
+	bool active() const { return (enabled || offscreen) && complete; }
+	// Whether this frame's resolution follows the GPU time
+	bool scaled() const { return enabled && complete; }
+	// Feeds a measured GPU time to the scale
+	void adjust(double milliseconds);
+};
+
+#endif
@@ -0,0 +1,34 @@
+#include"FixedTimestep.h"
+#include<algorithm>
+
+// Constructor that sets the number of steps per second
+FixedTimestep::FixedTimestep(float rate)
+{
+	SetRate(rate);
+}
+
+// Changes the number of steps per second, keeping the time already simulated
+void FixedTimestep::SetRate(float rate)
+{
+	step = 1.0f / std::max(rate, 1.0f);
+	accumulator = std::min(accumulator, (double)step);
+}
+
+// Adds the seconds since the last frame and returns how many steps to run
+int FixedTimestep::Advance(float deltaTime)
+{
+	accumulator += std::max(deltaTime, 0.0f);
+	int count = (int)(accumulator / step);
+	if (count > maxSteps)
+	{
+		dropped += accumulator - (double)maxSteps * step;
+		accumulator = (double)maxSteps * step;
+		count = maxSteps;
+	}
+	accumulator -= (double)count * step;
+	// Rounding can leave the remainder a hair outside a step
+	accumulator = std::min(std::max(accumulator, 0.0), (double)step);
+	time += (double)count * step;
+	steps += count;
+	return count;
+}
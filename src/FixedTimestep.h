@@ -0,0 +1,41 @@
+#ifndef FIXED_TIMESTEP_CLASS_H
+#define FIXED_TIMESTEP_CLASS_H
+
+// Splits the time between frames into simulation steps of one fixed length, so movement and
+// collision behave the same at any frame rate and the simulation doesn't run once per refresh.
+// What's left over after the last whole step is the fraction to blend the drawn transforms by.
+class FixedTimestep
+{
+public:
+	// Steps run in one frame at most, the rest of a longer stall is dropped so the simulation
+	// catches up instead of falling further behind
+	int maxSteps = 8;
+
+	// Constructor that sets the number of steps per second
+	FixedTimestep(float rate = 60.0f);
+
+	// Changes the number of steps per second, keeping the time already simulated
+	void SetRate(float rate);
+	// Adds the seconds since the last frame and returns how many steps to run
+	int Advance(float deltaTime);
+	// Seconds simulated by one step
+	float Step() const { return step; }
+	// Steps per second
+	float Rate() const { return 1.0f / step; }
+	// How far the frame is between the previous step and the last one, from 0 to 1
+	float Alpha() const { return (float)(accumulator / step); }
+	// Seconds simulated by every step run so far
+	double Time() const { return time; }
+	// Steps run so far
+	unsigned long long Steps() const { return steps; }
+	// Frame time dropped because more than maxSteps were due
+	double Dropped() const { return dropped; }
+private:
+	float step;
+	double accumulator = 0.0;
+	double time = 0.0;
+	double dropped = 0.0;
+	unsigned long long steps = 0;
+};
+
+#endif
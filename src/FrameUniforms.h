@@ -0,0 +1,54 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include<cstddef>
+#include<glm/glm.hpp>
+
+// Binding point of the FrameData uniform block
+const unsigned int FRAME_UNIFORMS_BINDING = 0;
+
+// Camera and lighting state shared by every draw of a frame, mirrors the std140
+// FrameData block of src/frameData.glsl member for member
+struct FrameUniforms
+{
+	glm::mat4 camMatrix;
+	glm::vec3 camPos;
+	float time;
+	glm::vec4 lightColor;
+	glm::vec4 lightColor2;
+	glm::vec3 lightPos;
+	int isOn;
+	glm::vec3 spotDirection;
+	float pad0;
+	glm::vec3 lightPos2;
+	float pad1;
+	glm::vec3 spotDirection2;
+	float pad2;
+	glm::vec3 lampPos;
+	float pad3;
+	glm::vec3 camForward;
+	float pad4;
+	// Clustered lighting: depth slice scale and bias, then the tile size in pixels
+	glm::vec4 clusterParams;
+	// Clustered lighting: tiles across, tiles down, depth slices and number of lights
+	glm::uvec4 clusterGrid;
+};
+
+// std140 puts every vec3 and vec4 on a 16 byte boundary, a float or int may fill the gap after a vec3
+static_assert(offsetof(FrameUniforms, camMatrix) == 0, "FrameData layout mismatch");
+static_assert(offsetof(FrameUniforms, camPos) == 64, "FrameData layout mismatch");
+static_assert(offsetof(FrameUniforms, time) == 76, "FrameData layout mismatch");
+static_assert(offsetof(FrameUniforms, lightColor) == 80, "FrameData layout mismatch");
+static_assert(offsetof(FrameUniforms, lightColor2) == 96, "FrameData layout mismatch");
+static_assert(offsetof(FrameUniforms, lightPos) == 112, "FrameData layout mismatch");
+static_assert(offsetof(FrameUniforms, isOn) == 124, "FrameData layout mismatch");
+static_assert(offsetof(FrameUniforms, spotDirection) == 128, "FrameData layout mismatch");
+static_assert(offsetof(FrameUniforms, lightPos2) == 144, "FrameData layout mismatch");
+static_assert(offsetof(FrameUniforms, spotDirection2) == 160, "FrameData layout mismatch");
+static_assert(offsetof(FrameUniforms, lampPos) == 176, "FrameData layout mismatch");
+static_assert(offsetof(FrameUniforms, camForward) == 192, "FrameData layout mismatch");
+static_assert(offsetof(FrameUniforms, clusterParams) == 208, "FrameData layout mismatch");
+static_assert(offsetof(FrameUniforms, clusterGrid) == 224, "FrameData layout mismatch");
+static_assert(sizeof(FrameUniforms) == 240, "FrameData layout mismatch");
+
+#endif
@@ -0,0 +1,130 @@
+#include"Frustum.h"
+#include<cfloat>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include<emmintrin.h>
+#define FRUSTUM_USE_SSE2
+#endif
+
+// Removes every box
+void AABBList::Clear()
+{
+	minX.clear(); minY.clear(); minZ.clear();
+	maxX.clear(); maxY.clear(); maxZ.clear();
+	count = 0;
+}
+
+// Adds a box at the end
+void AABBList::Add(const AABB& box)
+{
+	// Drops the padding of the last group of four before appending
+	minX.resize(count); minY.resize(count); minZ.resize(count);
+	maxX.resize(count); maxY.resize(count); maxZ.resize(count);
+	minX.push_back(box.min.x); minY.push_back(box.min.y); minZ.push_back(box.min.z);
+	maxX.push_back(box.max.x); maxY.push_back(box.max.y); maxZ.push_back(box.max.z);
+	count++;
+
+	// Inverted boxes are outside of every plane
+	size_t padded = (count + 3) & ~(size_t)3;
+	minX.resize(padded, FLT_MAX); minY.resize(padded, FLT_MAX); minZ.resize(padded, FLT_MAX);
+	maxX.resize(padded, -FLT_MAX); maxY.resize(padded, -FLT_MAX); maxZ.resize(padded, -FLT_MAX);
+}
+
+// Constructor that sees everything
+Frustum::Frustum()
+{
+	for (auto& plane : planes) plane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+// Extracts the planes of a projection * view matrix
+Frustum::Frustum(const glm::mat4& viewProjection)
+{
+	// Gribb and Hartmann: every plane is the last row of the matrix plus or minus one of the others
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+	planes[0] = rows[3] + rows[0];
+	planes[1] = rows[3] - rows[0];
+	planes[2] = rows[3] + rows[1];
+	planes[3] = rows[3] - rows[1];
+	planes[4] = rows[3] + rows[2];
+	planes[5] = rows[3] - rows[2];
+	for (auto& plane : planes)
+	{
+		float length = glm::length(glm::vec3(plane));
+		if (length > 0.0f) plane /= length;
+	}
+}
+
+// Whether any part of a box may be inside
+bool Frustum::Intersects(const AABB& box) const
+{
+	for (const auto& plane : planes)
+	{
+		// The corner furthest along the normal is the last to leave the plane
+		glm::vec3 corner(
+			plane.x >= 0.0f ? box.max.x : box.min.x,
+			plane.y >= 0.0f ? box.max.y : box.min.y,
+			plane.z >= 0.0f ? box.max.z : box.min.z);
+		if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) return false;
+	}
+	return true;
+}
+
+// Writes 1 for every box that may be inside and 0 for every box that is outside, returns the number inside
+size_t Frustum::Cull(const AABBList& boxes, std::vector<uint8_t>& visible) const
+{
+	visible.resize(boxes.minX.size());
+
+	// Per plane the corner tested is picked by the signs of the normal, so the choice
+	// of arrays is made once and the boxes only need multiplies and adds
+	const float* cornerX[6];
+	const float* cornerY[6];
+	const float* cornerZ[6];
+	for (int p = 0; p < 6; p++)
+	{
+		cornerX[p] = planes[p].x >= 0.0f ? boxes.maxX.data() : boxes.minX.data();
+		cornerY[p] = planes[p].y >= 0.0f ? boxes.maxY.data() : boxes.minY.data();
+		cornerZ[p] = planes[p].z >= 0.0f ? boxes.maxZ.data() : boxes.minZ.data();
+	}
+
+	size_t inside = 0;
+#ifdef FRUSTUM_USE_SSE2
+	__m128 zero = _mm_setzero_ps();
+	for (size_t i = 0; i < boxes.minX.size(); i += 4)
+	{
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(
+					_mm_mul_ps(_mm_set1_ps(planes[p].x), _mm_loadu_ps(cornerX[p] + i)),
+					_mm_mul_ps(_mm_set1_ps(planes[p].y), _mm_loadu_ps(cornerY[p] + i))),
+				_mm_add_ps(
+					_mm_mul_ps(_mm_set1_ps(planes[p].z), _mm_loadu_ps(cornerZ[p] + i)),
+					_mm_set1_ps(planes[p].w)));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, zero));
+		}
+		int mask = _mm_movemask_ps(outside);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			visible[i + lane] = (mask & (1 << lane)) == 0;
+		}
+	}
+#else
+	for (size_t i = 0; i < boxes.minX.size(); i++)
+	{
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; p++)
+		{
+			outside = planes[p].x * cornerX[p][i] + planes[p].y * cornerY[p][i] + planes[p].z * cornerZ[p][i] + planes[p].w < 0.0f;
+		}
+		visible[i] = !outside;
+	}
+#endif
+	// Only the real boxes are counted, the padding is always outside
+	visible.resize(boxes.count);
+	for (uint8_t v : visible) inside += v;
+	return inside;
+}
@@ -0,0 +1,45 @@
+#ifndef FRUSTUM_CLASS_H
+#define FRUSTUM_CLASS_H
+
+#include<cstdint>
+#include<vector>
+#include<glm/glm.hpp>
+
+#include"AABB.h"
+
+// Axis aligned boxes stored one component per array so four of them can be tested at once,
+// the arrays are padded to a multiple of four with empty boxes
+struct AABBList
+{
+	std::vector<float> minX, minY, minZ;
+	std::vector<float> maxX, maxY, maxZ;
+	// Number of boxes without the padding
+	size_t count = 0;
+
+	// Removes every box
+	void Clear();
+	// Adds a box at the end
+	void Add(const AABB& box);
+	// Returns the box at an index
+	AABB Get(size_t i) const { return { glm::vec3(minX[i], minY[i], minZ[i]), glm::vec3(maxX[i], maxY[i], maxZ[i]) }; }
+};
+
+// The six planes bounding what a camera matrix can see
+class Frustum
+{
+public:
+	// Left, right, bottom, top, near and far, each as normal and distance with the normal pointing inside
+	glm::vec4 planes[6];
+
+	// Constructor that sees everything
+	Frustum();
+	// Extracts the planes of a projection * view matrix
+	explicit Frustum(const glm::mat4& viewProjection);
+
+	// Whether any part of a box may be inside
+	bool Intersects(const AABB& box) const;
+	// Writes 1 for every box that may be inside and 0 for every box that is outside, returns the number inside
+	size_t Cull(const AABBList& boxes, std::vector<uint8_t>& visible) const;
+};
+
+#endif
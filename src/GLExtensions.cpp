@@ -0,0 +1,91 @@
+#include"GLExtensions.h"
+#include<GLFW/glfw3.h>
+#include<cstdio>
+
+GLExtensions glExt;
+
+// Whether the context is at least the given version
+bool GLExtensions::AtLeast(int major, int minor) const
+{
+	return GLExtensions::major > major || (GLExtensions::major == major && GLExtensions::minor >= minor);
+}
+
+// Whether shaders can declare at least the given #version
+bool GLExtensions::ShadingAtLeast(int major, int minor) const
+{
+	return shadingMajor > major || (shadingMajor == major && shadingMinor >= minor);
+}
+
+// Whether the context advertises an extension
+bool GLExtensions::Has(const char* extension) const
+{
+	return extensions.count(extension) != 0;
+}
+
+// Loads the entry points newer than GL 3.3, call after gladLoadGL
+void LoadGLExtensions()
+{
+	glGetIntegerv(GL_MAJOR_VERSION, &glExt.major);
+	glGetIntegerv(GL_MINOR_VERSION, &glExt.minor);
+	// "4.60 NVIDIA ..." or "4.30", vendor text after the number
+	const char* shading = (const char*)glGetString(GL_SHADING_LANGUAGE_VERSION);
+	if (shading == nullptr || sscanf(shading, "%d.%d", &glExt.shadingMajor, &glExt.shadingMinor) != 2)
+	{
+		glExt.shadingMajor = 3;
+		glExt.shadingMinor = 30;
+	}
+
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++)
+	{
+		glExt.extensions.insert((const char*)glGetStringi(GL_EXTENSIONS, i));
+	}
+
+	if (glExt.AtLeast(4, 2) || glExt.Has("GL_ARB_texture_storage"))
+	{
+		glExt.TexStorage2D = (PFNGLTEXSTORAGE2DPROC)glfwGetProcAddress("glTexStorage2D");
+	}
+	if (glExt.AtLeast(4, 4) || glExt.Has("GL_ARB_buffer_storage"))
+	{
+		glExt.BufferStorage = (PFNGLBUFFERSTORAGEPROC)glfwGetProcAddress("glBufferStorage");
+	}
+	if (glExt.AtLeast(4, 3) || glExt.Has("GL_ARB_multi_draw_indirect"))
+	{
+		glExt.MultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)glfwGetProcAddress("glMultiDrawElementsIndirect");
+	}
+	if (glExt.AtLeast(4, 1) || glExt.Has("GL_ARB_get_program_binary"))
+	{
+		// Some drivers expose the entry points but can't save anything
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		if (formats > 0)
+		{
+			glExt.GetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)glfwGetProcAddress("glGetProgramBinary");
+			glExt.ProgramBinary = (PFNGLPROGRAMBINARYPROC)glfwGetProcAddress("glProgramBinary");
+			glExt.ProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)glfwGetProcAddress("glProgramParameteri");
+		}
+	}
+	if (glExt.AtLeast(4, 1) || glExt.Has("GL_ARB_separate_shader_objects"))
+	{
+		glExt.ProgramUniform1i = (PFNGLPROGRAMUNIFORM1IPROC)glfwGetProcAddress("glProgramUniform1i");
+		glExt.ProgramUniform1f = (PFNGLPROGRAMUNIFORM1FPROC)glfwGetProcAddress("glProgramUniform1f");
+		glExt.ProgramUniform3fv = (PFNGLPROGRAMUNIFORM3FVPROC)glfwGetProcAddress("glProgramUniform3fv");
+		glExt.ProgramUniform4fv = (PFNGLPROGRAMUNIFORM4FVPROC)glfwGetProcAddress("glProgramUniform4fv");
+		glExt.ProgramUniformMatrix3fv = (PFNGLPROGRAMUNIFORMMATRIX3FVPROC)glfwGetProcAddress("glProgramUniformMatrix3fv");
+		glExt.ProgramUniformMatrix4fv = (PFNGLPROGRAMUNIFORMMATRIX4FVPROC)glfwGetProcAddress("glProgramUniformMatrix4fv");
+		// All or nothing, so the setters can test one of them
+		if (!glExt.ProgramUniform1i || !glExt.ProgramUniform1f || !glExt.ProgramUniform3fv || !glExt.ProgramUniform4fv
+			|| !glExt.ProgramUniformMatrix3fv || !glExt.ProgramUniformMatrix4fv) glExt.ProgramUniform1i = nullptr;
+	}
+	if (glExt.Has("GL_KHR_parallel_shader_compile"))
+	{
+		glExt.MaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+	}
+	else if (glExt.Has("GL_ARB_parallel_shader_compile"))
+	{
+		glExt.MaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+	}
+	// Lets the driver pick how many threads to compile on
+	if (glExt.MaxShaderCompilerThreadsKHR != nullptr) glExt.MaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+}
@@ -0,0 +1,114 @@
+#ifndef GL_EXTENSIONS_CLASS_H
+#define GL_EXTENSIONS_CLASS_H
+
+#include<glad/glad.h>
+#include<string>
+#include<unordered_set>
+
+// glad was generated for the OpenGL 3.3 core profile, so the newer enums and entry points
+// used by the optional fast paths are declared here and loaded at runtime when available
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_DYNAMIC_STORAGE_BIT
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+#ifndef GL_VERTICES_SUBMITTED_ARB
+#define GL_VERTICES_SUBMITTED_ARB 0x82EE
+#endif
+#ifndef GL_PRIMITIVES_SUBMITTED_ARB
+#define GL_PRIMITIVES_SUBMITTED_ARB 0x82EF
+#endif
+#ifndef GL_VERTEX_SHADER_INVOCATIONS_ARB
+#define GL_VERTEX_SHADER_INVOCATIONS_ARB 0x82F0
+#endif
+#ifndef GL_FRAGMENT_SHADER_INVOCATIONS_ARB
+#define GL_FRAGMENT_SHADER_INVOCATIONS_ARB 0x82F4
+#endif
+
+typedef void (APIENTRYP PFNGLTEXSTORAGE2DPROC)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+typedef void (APIENTRYP PFNGLPROGRAMUNIFORM1IPROC)(GLuint program, GLint location, GLint v0);
+typedef void (APIENTRYP PFNGLPROGRAMUNIFORM1FPROC)(GLuint program, GLint location, GLfloat v0);
+typedef void (APIENTRYP PFNGLPROGRAMUNIFORM3FVPROC)(GLuint program, GLint location, GLsizei count, const GLfloat* value);
+typedef void (APIENTRYP PFNGLPROGRAMUNIFORM4FVPROC)(GLuint program, GLint location, GLsizei count, const GLfloat* value);
+typedef void (APIENTRYP PFNGLPROGRAMUNIFORMMATRIX3FVPROC)(GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value);
+typedef void (APIENTRYP PFNGLPROGRAMUNIFORMMATRIX4FVPROC)(GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value);
+
+struct GLExtensions
+{
+	// Version of the current context
+	int major = 3;
+	int minor = 3;
+	// GLSL version of the current context, 4.30 as 4 and 30
+	int shadingMajor = 3;
+	int shadingMinor = 30;
+	// Extensions advertised by the current context
+	std::unordered_set<std::string> extensions;
+
+	// GL 4.2 / ARB_texture_storage
+	PFNGLTEXSTORAGE2DPROC TexStorage2D = nullptr;
+	// GL 4.4 / ARB_buffer_storage
+	PFNGLBUFFERSTORAGEPROC BufferStorage = nullptr;
+	// GL 4.3 / ARB_multi_draw_indirect
+	PFNGLMULTIDRAWELEMENTSINDIRECTPROC MultiDrawElementsIndirect = nullptr;
+	// GL 4.1 / ARB_get_program_binary, only set when the driver offers at least one binary format
+	PFNGLGETPROGRAMBINARYPROC GetProgramBinary = nullptr;
+	PFNGLPROGRAMBINARYPROC ProgramBinary = nullptr;
+	PFNGLPROGRAMPARAMETERIPROC ProgramParameteri = nullptr;
+	// KHR_parallel_shader_compile: compiles and links run on driver threads until their
+	// status is queried, GL_COMPLETION_STATUS_KHR tells whether that would wait
+	PFNGLMAXSHADERCOMPILERTHREADSKHRPROC MaxShaderCompilerThreadsKHR = nullptr;
+	// GL 4.1 / ARB_separate_shader_objects: uniforms written to a program without binding it
+	PFNGLPROGRAMUNIFORM1IPROC ProgramUniform1i = nullptr;
+	PFNGLPROGRAMUNIFORM1FPROC ProgramUniform1f = nullptr;
+	PFNGLPROGRAMUNIFORM3FVPROC ProgramUniform3fv = nullptr;
+	PFNGLPROGRAMUNIFORM4FVPROC ProgramUniform4fv = nullptr;
+	PFNGLPROGRAMUNIFORMMATRIX3FVPROC ProgramUniformMatrix3fv = nullptr;
+	PFNGLPROGRAMUNIFORMMATRIX4FVPROC ProgramUniformMatrix4fv = nullptr;
+
+	// Whether the context is at least the given version
+	bool AtLeast(int major, int minor) const;
+	// Whether shaders can declare at least the given #version, e.g. 4, 30 for 430
+	bool ShadingAtLeast(int major, int minor) const;
+	// Whether the context advertises an extension
+	bool Has(const char* extension) const;
+};
+
+// Entry points of the current context, filled by LoadGLExtensions
+extern GLExtensions glExt;
+
+// Loads the entry points newer than GL 3.3, call after gladLoadGL
+void LoadGLExtensions();
+
+#endif
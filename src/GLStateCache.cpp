@@ -0,0 +1,58 @@
+#include"GLStateCache.h"
+
+// Binds a program if it isn't already in use
+void GLStateCache::UseProgram(GLuint program)
+{
+	if (GLStateCache::program == program)
+	{
+		counters.skipped++;
+		return;
+	}
+	glUseProgram(program);
+	GLStateCache::program = program;
+	counters.programs++;
+}
+
+// Binds a vertex array if it isn't already bound
+void GLStateCache::BindVertexArray(GLuint vertexArray)
+{
+	if (GLStateCache::vertexArray == vertexArray)
+	{
+		counters.skipped++;
+		return;
+	}
+	glBindVertexArray(vertexArray);
+	GLStateCache::vertexArray = vertexArray;
+	counters.vertexArrays++;
+}
+
+// Binds a 2D texture to a unit if it isn't already bound there
+void GLStateCache::BindTexture(GLuint unit, GLuint texture)
+{
+	if (unit < MaxTextureUnits && textures[unit] == texture)
+	{
+		counters.skipped++;
+		return;
+	}
+	if (activeUnit != unit)
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		activeUnit = unit;
+		counters.textures++;
+	}
+	glBindTexture(GL_TEXTURE_2D, texture);
+	if (unit < MaxTextureUnits) textures[unit] = texture;
+	counters.textures++;
+}
+
+// Forgets the tracked state, call after GL state was changed without the cache
+void GLStateCache::Invalidate()
+{
+	program = ~0u;
+	vertexArray = ~0u;
+	activeUnit = ~0u;
+	for (int i = 0; i < MaxTextureUnits; i++)
+	{
+		textures[i] = ~0u;
+	}
+}
@@ -0,0 +1,50 @@
+#ifndef GL_STATE_CACHE_CLASS_H
+#define GL_STATE_CACHE_CLASS_H
+
+#include<glad/glad.h>
+
+// Remembers the program, vertex array and textures that are bound so that binding
+// them again doesn't reach the driver, and counts the calls that do
+class GLStateCache
+{
+public:
+	// Number of texture units tracked
+	static const int MaxTextureUnits = 16;
+
+	// Driver calls issued and skipped since the last ResetCounters
+	struct Counters
+	{
+		unsigned int programs = 0;
+		unsigned int vertexArrays = 0;
+		unsigned int textures = 0;
+		unsigned int draws = 0;
+		unsigned int uniforms = 0;
+		unsigned int skipped = 0;
+		// Every call that reached the driver
+		unsigned int Total() const { return programs + vertexArrays + textures + draws + uniforms; }
+	};
+	Counters counters;
+
+	// Constructor that starts with nothing known about the bound state
+	GLStateCache() { Invalidate(); }
+	// Binds a program if it isn't already in use
+	void UseProgram(GLuint program);
+	// Binds a vertex array if it isn't already bound
+	void BindVertexArray(GLuint vertexArray);
+	// Binds a 2D texture to a unit if it isn't already bound there
+	void BindTexture(GLuint unit, GLuint texture);
+	// Counts a draw call
+	void Draw() { counters.draws++; }
+	// Forgets the tracked state, call after GL state was changed without the cache
+	void Invalidate();
+	// Clears the counters
+	void ResetCounters() { counters = Counters(); }
+private:
+	// ~0u marks state that isn't known
+	GLuint program = ~0u;
+	GLuint vertexArray = ~0u;
+	GLuint activeUnit = ~0u;
+	GLuint textures[MaxTextureUnits];
+};
+
+#endif
@@ -0,0 +1,159 @@
+#include"GeometryBuffer.h"
+#include"GLExtensions.h"
+#include<algorithm>
+#include<cstdint>
+
+// Whether the context can use this path
+bool GeometryBuffer::Supported()
+{
+	// The window only asks for 3.3 core, most drivers hand out their newest core version but
+	// some stop at exactly what was asked. indirect.vert and depthIndirect.vert are #version 430
+	// for the storage buffer, the draw ID is an instanced attribute selected by each command's
+	// base instance rather than gl_DrawID, so ARB_shader_draw_parameters isn't needed
+	return glExt.AtLeast(4, 3) && glExt.ShadingAtLeast(4, 30) && glExt.MultiDrawElementsIndirect != nullptr;
+}
+
+// Copies the vertices and indices of meshes
+void GeometryBuffer::Add(const std::vector<Mesh>& meshes)
+{
+	for (const auto& mesh : meshes)
+	{
+		Range range;
+		range.firstIndex = (GLuint)indices.size();
+		range.count = (GLuint)mesh.indices.size();
+		range.baseVertex = (GLint)vertices.size();
+		ranges[&mesh] = range;
+		vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+		indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+	}
+}
+
+// Uploads the added meshes into the shared buffers
+void GeometryBuffer::Build()
+{
+	if (vertexArray == 0)
+	{
+		glGenVertexArrays(1, &vertexArray);
+		glGenBuffers(1, &vertexBuffer);
+		glGenVertexArrays(1, &depthVertexArray);
+		glGenBuffers(1, &positionBuffer);
+		glGenBuffers(1, &indexBuffer);
+		glGenBuffers(1, &drawIDBuffer);
+		glGenBuffers(1, &commandBuffer);
+		glGenBuffers(1, &drawDataBuffer);
+	}
+
+	glBindVertexArray(vertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+	// Same layout as the meshes' own vertex arrays
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(3 * sizeof(float)));
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(6 * sizeof(float)));
+	glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(9 * sizeof(float)));
+	for (GLuint i = 0; i < 4; i++) glEnableVertexAttribArray(i);
+	// One draw ID per instance, each command starts at its own with its base instance
+	glBindBuffer(GL_ARRAY_BUFFER, drawIDBuffer);
+	glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+	glVertexAttribDivisor(4, 1);
+	glEnableVertexAttribArray(4);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+
+	std::vector<glm::vec3> positions;
+	positions.reserve(vertices.size());
+	for (const auto& v : vertices) positions.push_back(v.position);
+	glBindVertexArray(depthVertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+	glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+	glEnableVertexAttribArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, drawIDBuffer);
+	glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+	glVertexAttribDivisor(4, 1);
+	glEnableVertexAttribArray(4);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// The meshes keep their own copy, see Add
+	vertices.clear();
+	vertices.shrink_to_fit();
+	indices.clear();
+	indices.shrink_to_fit();
+}
+
+// Clears the draws of the previous frame
+void GeometryBuffer::Begin()
+{
+	commands.clear();
+	drawData.clear();
+}
+
+// Appends a command drawing a mesh with a model matrix and its normal matrix
+size_t GeometryBuffer::Queue(const Mesh& mesh, const glm::mat4& model, const glm::mat3& normalMatrix)
+{
+	const Range& range = ranges.at(&mesh);
+	GLuint index = (GLuint)commands.size();
+	commands.push_back({ range.count, 1, range.firstIndex, range.baseVertex, index });
+	drawData.push_back({ model, glm::mat4(normalMatrix) });
+	return index;
+}
+
+// Uploads the commands and per-draw data queued this frame
+void GeometryBuffer::Upload()
+{
+	if (commands.empty()) return;
+
+	if (commands.size() > capacity)
+	{
+		capacity = std::max(commands.size(), std::max(capacity * 2, (size_t)256));
+		std::vector<GLuint> ids(capacity);
+		for (size_t i = 0; i < capacity; i++) ids[i] = (GLuint)i;
+		// Both vertex arrays point at this buffer, so it is respecified rather than replaced
+		glBindBuffer(GL_ARRAY_BUFFER, drawIDBuffer);
+		glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(GLuint), ids.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// Fresh storage every frame so the draws of the previous one are never waited on
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, drawData.size() * sizeof(DrawData), drawData.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+// Issues count uploaded commands starting at first in one call
+void GeometryBuffer::Draw(size_t first, size_t count, GLStateCache& state)
+{
+	multiDraw(vertexArray, first, count, state);
+}
+
+// Same as Draw from the position only stream, for the depth pre-pass
+void GeometryBuffer::DrawDepth(size_t first, size_t count, GLStateCache& state)
+{
+	multiDraw(depthVertexArray, first, count, state);
+}
+
+// Issues count uploaded commands starting at first from a vertex array
+void GeometryBuffer::multiDraw(GLuint array, size_t first, size_t count, GLStateCache& state)
+{
+	state.BindVertexArray(array);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DrawDataBinding, drawDataBuffer);
+	glExt.MultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+		(const void*)(uintptr_t)(first * sizeof(DrawElementsIndirectCommand)), (GLsizei)count, 0);
+	state.Draw();
+}
+
+// Deletes the buffers and the vertex array
+void GeometryBuffer::Delete()
+{
+	if (vertexArray == 0) return;
+	glDeleteVertexArrays(1, &vertexArray);
+	glDeleteVertexArrays(1, &depthVertexArray);
+	GLuint buffers[] = { vertexBuffer, positionBuffer, indexBuffer, drawIDBuffer, commandBuffer, drawDataBuffer };
+	glDeleteBuffers(6, buffers);
+	vertexArray = 0;
+}
@@ -0,0 +1,96 @@
+#ifndef GEOMETRY_BUFFER_CLASS_H
+#define GEOMETRY_BUFFER_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<unordered_map>
+#include<vector>
+
+#include"Mesh.h"
+#include"GLStateCache.h"
+
+// Holds the vertices and indices of many static meshes in one vertex buffer, one index buffer
+// and one vertex array, so a whole run of draws goes out as one glMultiDrawElementsIndirect.
+// The model matrix of each draw is read from a shader storage buffer, indexed by a per-instance
+// draw ID attribute at location 4 that each command selects with its base instance. Needs GL 4.3.
+class GeometryBuffer
+{
+public:
+	// Binding of the shader storage buffer with the per-draw data, mirrors indirect.vert
+	static const GLuint DrawDataBinding = 1;
+
+	// Layout of one command read by glMultiDrawElementsIndirect
+	struct DrawElementsIndirectCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+	// Per-draw data in the shader storage buffer, std430
+	struct DrawData
+	{
+		glm::mat4 model;
+		// Inverse transpose of the model matrix in the upper 3x3, a mat4 to keep std430 padding simple
+		glm::mat4 normalMatrix;
+	};
+
+	// Whether the context can use this path
+	static bool Supported();
+
+	// Copies the vertices and indices of meshes, call Build once every mesh is added. The meshes
+	// keep their CPU copies: the occlusion culler rasterizes their triangles, draws that aren't
+	// batched (crowd, depth fallback, benchmarks) take their index count, and the meshes' own
+	// vertex arrays are still what gets drawn if the indirect shaders fail to build
+	void Add(const std::vector<Mesh>& meshes);
+	// Uploads the added meshes into the shared buffers
+	void Build();
+	// Whether a mesh was added
+	bool Contains(const Mesh& mesh) const { return ranges.count(&mesh) != 0; }
+
+	// Clears the draws of the previous frame
+	void Begin();
+	// Appends a command drawing a mesh with a model matrix and its normal matrix, returns its index
+	size_t Queue(const Mesh& mesh, const glm::mat4& model, const glm::mat3& normalMatrix);
+	// Uploads the commands and per-draw data queued this frame
+	void Upload();
+	// Issues count uploaded commands starting at first in one call, the program and textures must be bound
+	void Draw(size_t first, size_t count, GLStateCache& state);
+	// Same as Draw from the position only stream, for the depth pre-pass
+	void DrawDepth(size_t first, size_t count, GLStateCache& state);
+	// Deletes the buffers and the vertex array
+	void Delete();
+private:
+	struct Range
+	{
+		GLuint firstIndex;
+		GLuint count;
+		GLint baseVertex;
+	};
+
+	GLuint vertexArray = 0;
+	GLuint vertexBuffer = 0;
+	// Positions only, with the same index buffer and draw IDs
+	GLuint depthVertexArray = 0;
+	GLuint positionBuffer = 0;
+	GLuint indexBuffer = 0;
+	GLuint drawIDBuffer = 0;
+	GLuint commandBuffer = 0;
+	GLuint drawDataBuffer = 0;
+	// Draws the draw ID and storage buffers have room for
+	size_t capacity = 0;
+
+	std::unordered_map<const Mesh*, Range> ranges;
+	// Geometry waiting for Build
+	std::vector<Vertex> vertices;
+	std::vector<GLuint> indices;
+
+	std::vector<DrawElementsIndirectCommand> commands;
+	std::vector<DrawData> drawData;
+
+	// Issues count uploaded commands starting at first from a vertex array
+	void multiDraw(GLuint array, size_t first, size_t count, GLStateCache& state);
+};
+
+#endif
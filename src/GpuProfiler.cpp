@@ -0,0 +1,252 @@
+#include"GpuProfiler.h"
+#include"GLExtensions.h"
+#include<algorithm>
+#include<cstdio>
+
+namespace
+{
+	// Counted by the pipeline statistics queries, in the order of Section's fields
+	const GLenum statisticsTargets[] =
+	{
+		GL_VERTICES_SUBMITTED_ARB,
+		GL_PRIMITIVES_SUBMITTED_ARB,
+		GL_VERTEX_SHADER_INVOCATIONS_ARB,
+		GL_FRAGMENT_SHADER_INVOCATIONS_ARB,
+	};
+}
+
+// Constructor that checks for pipeline statistics queries, call once the context is current
+GpuProfiler::GpuProfiler()
+{
+	statistics = glExt.AtLeast(4, 6) || glExt.Has("GL_ARB_pipeline_statistics_query");
+	// The frame itself is always the first section
+	section("Frame", 0);
+}
+
+// Reads the frame measured Latency frames ago if the GPU is done with it and starts a new one
+void GpuProfiler::BeginFrame()
+{
+	if (!enabled) return;
+	current = (current + 1) % Slots;
+	Frame& frame = frames[current];
+	if (frame.measured && !collect(frame)) dropped++;
+
+	frame.records.clear();
+	frame.timestampsUsed = 0;
+	frame.statisticsUsed = 0;
+	frame.measured = false;
+	open.clear();
+	counting = false;
+	frame.start = timestamp();
+	glQueryCounter(frame.start, GL_TIMESTAMP);
+	inFrame = true;
+}
+
+// Ends the frame, its whole time is reported as the Frame section
+void GpuProfiler::EndFrame()
+{
+	if (!inFrame) return;
+	// Sections left open are closed so their queries still have an end
+	while (!open.empty()) End();
+	Frame& frame = frames[current];
+	frame.end = timestamp();
+	glQueryCounter(frame.end, GL_TIMESTAMP);
+	frame.measured = true;
+	inFrame = false;
+}
+
+// Starts timing a section, sections may nest
+void GpuProfiler::Begin(const char* name)
+{
+	if (!inFrame) return;
+	Frame& frame = frames[current];
+	Record record;
+	// Sections sit one level below the frame
+	record.section = section(name, (int)open.size() + 1);
+	record.start = timestamp();
+	record.end = timestamp();
+	record.statistics = -1;
+	glQueryCounter(record.start, GL_TIMESTAMP);
+
+	// A query target can only count for one section at a time, so the outermost one gets it
+	if (statistics && !counting)
+	{
+		if (frame.statisticsUsed == frame.statistics.size())
+		{
+			std::array<GLuint, StatisticsTargets> queries;
+			glGenQueries(StatisticsTargets, queries.data());
+			frame.statistics.push_back(queries);
+		}
+		record.statistics = (int)frame.statisticsUsed++;
+		for (int i = 0; i < StatisticsTargets; i++)
+		{
+			glBeginQuery(statisticsTargets[i], frame.statistics[record.statistics][i]);
+		}
+		counting = true;
+	}
+
+	open.push_back(frame.records.size());
+	frame.records.push_back(record);
+}
+
+// Ends the innermost section
+void GpuProfiler::End()
+{
+	if (!inFrame || open.empty()) return;
+	Frame& frame = frames[current];
+	Record& record = frame.records[open.back()];
+	open.pop_back();
+	glQueryCounter(record.end, GL_TIMESTAMP);
+	if (record.statistics >= 0)
+	{
+		for (int i = 0; i < StatisticsTargets; i++) glEndQuery(statisticsTargets[i]);
+		counting = false;
+	}
+}
+
+// Averaged time of the first section with a name, 0 if it was never measured
+double GpuProfiler::Milliseconds(const std::string& name) const
+{
+	for (const auto& section : sections)
+	{
+		if (section.name == name) return section.milliseconds;
+	}
+	return 0.0;
+}
+
+// The averages as a text table
+std::string GpuProfiler::Report() const
+{
+	std::string report = "GPU profile, averaged over about " + std::to_string(Window) + " frames";
+	if (dropped > 0) report += ", " + std::to_string(dropped) + " frames dropped";
+	report += "\n";
+
+	char line[256];
+	for (const Section& section : sections)
+	{
+		if (section.samples == 0) continue;
+		std::string name = std::string(section.depth * 2, ' ') + section.name;
+		int written = std::snprintf(line, sizeof(line), "%-24s %8.3f ms", name.c_str(), section.milliseconds);
+		if (section.hasStatistics && written > 0 && written < (int)sizeof(line))
+		{
+			std::snprintf(line + written, sizeof(line) - written, "  %10.0f vertices %10.0f primitives %10.0f VS %12.0f FS",
+				section.vertices, section.primitives, section.vertexInvocations, section.fragmentInvocations);
+		}
+		report += line;
+		report += "\n";
+	}
+	return report;
+}
+
+// Deletes every query
+void GpuProfiler::Delete()
+{
+	for (Frame& frame : frames)
+	{
+		if (!frame.timestamps.empty()) glDeleteQueries((GLsizei)frame.timestamps.size(), frame.timestamps.data());
+		for (auto& queries : frame.statistics) glDeleteQueries(StatisticsTargets, queries.data());
+		frame.timestamps.clear();
+		frame.statistics.clear();
+		frame.records.clear();
+		frame.timestampsUsed = 0;
+		frame.statisticsUsed = 0;
+		frame.measured = false;
+	}
+	open.clear();
+	counting = false;
+	inFrame = false;
+}
+
+// Finds or adds a section
+size_t GpuProfiler::section(const std::string& name, int depth)
+{
+	auto found = sectionIndices.find(name);
+	if (found != sectionIndices.end()) return found->second;
+	Section section;
+	section.name = name;
+	section.depth = depth;
+	sections.push_back(section);
+	sectionIndices[name] = sections.size() - 1;
+	return sections.size() - 1;
+}
+
+// A timestamp query of the current frame, generated when the frame has none left
+GLuint GpuProfiler::timestamp()
+{
+	Frame& frame = frames[current];
+	if (frame.timestampsUsed == frame.timestamps.size())
+	{
+		GLuint query;
+		glGenQueries(1, &query);
+		frame.timestamps.push_back(query);
+	}
+	return frame.timestamps[frame.timestampsUsed++];
+}
+
+// Reads a frame's results into the averages, false if the GPU isn't done with them
+bool GpuProfiler::collect(Frame& frame)
+{
+	// The GPU finishes queries in order, so once the last timestamp is in the others are too
+	GLint available = 0;
+	glGetQueryObjectiv(frame.end, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) return false;
+	// Statistics queries end before the last timestamp but needn't land in the same order
+	for (size_t i = 0; i < frame.statisticsUsed; i++)
+	{
+		for (GLuint query : frame.statistics[i])
+		{
+			glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) return false;
+		}
+	}
+
+	GLuint64 start, end;
+	glGetQueryObjectui64v(frame.start, GL_QUERY_RESULT, &start);
+	glGetQueryObjectui64v(frame.end, GL_QUERY_RESULT, &end);
+	Section& whole = sections[0];
+	whole.samples++;
+	average(whole.milliseconds, (end - start) / 1e6, whole.samples);
+
+	// A section entered several times in a frame is summed before it is averaged
+	std::vector<double> milliseconds(sections.size(), 0.0);
+	std::vector<std::array<double, StatisticsTargets>> counts(sections.size(), { 0.0, 0.0, 0.0, 0.0 });
+	std::vector<bool> seen(sections.size(), false), counted(sections.size(), false);
+	for (const Record& record : frame.records)
+	{
+		glGetQueryObjectui64v(record.start, GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(record.end, GL_QUERY_RESULT, &end);
+		milliseconds[record.section] += (end - start) / 1e6;
+		seen[record.section] = true;
+		if (record.statistics < 0) continue;
+		for (int i = 0; i < StatisticsTargets; i++)
+		{
+			GLuint64 count;
+			glGetQueryObjectui64v(frame.statistics[record.statistics][i], GL_QUERY_RESULT, &count);
+			counts[record.section][i] += (double)count;
+		}
+		counted[record.section] = true;
+	}
+
+	for (size_t i = 1; i < sections.size(); i++)
+	{
+		if (!seen[i]) continue;
+		Section& section = sections[i];
+		section.samples++;
+		average(section.milliseconds, milliseconds[i], section.samples);
+		if (!counted[i]) continue;
+		section.hasStatistics = true;
+		average(section.vertices, counts[i][0], section.samples);
+		average(section.primitives, counts[i][1], section.samples);
+		average(section.vertexInvocations, counts[i][2], section.samples);
+		average(section.fragmentInvocations, counts[i][3], section.samples);
+	}
+	return true;
+}
+
+// Folds one measurement into a rolling average
+void GpuProfiler::average(double& value, double sample, unsigned int samples)
+{
+	// A plain mean until the window fills, then an exponential average over about Window frames
+	double weight = 1.0 / std::min<unsigned int>(samples, Window);
+	value += (sample - value) * weight;
+}
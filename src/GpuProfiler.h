@@ -0,0 +1,128 @@
+#ifndef GPU_PROFILER_CLASS_H
+#define GPU_PROFILER_CLASS_H
+
+#include<glad/glad.h>
+#include<array>
+#include<string>
+#include<unordered_map>
+#include<vector>
+
+// Times named sections of a frame on the GPU with GL_TIMESTAMP queries, which nest, and counts
+// vertices, primitives and shader invocations of the outermost sections where the context has
+// pipeline statistics queries. Results are read Latency frames later, once the GPU has them,
+// so measuring never stalls, and are kept as rolling averages. Only needs GL 3.3, so it also
+// runs on software rasterizers such as llvmpipe.
+class GpuProfiler
+{
+public:
+	// Frames a result waits before it is read back
+	static constexpr int Latency = 3;
+	// Frames the averages roughly span
+	static constexpr int Window = 60;
+
+	// Averaged results of one section
+	struct Section
+	{
+		std::string name;
+		// Nesting depth the section was first seen at
+		int depth = 0;
+		double milliseconds = 0.0;
+		// Pipeline statistics, only filled when hasStatistics is set
+		bool hasStatistics = false;
+		double vertices = 0.0;
+		double primitives = 0.0;
+		double vertexInvocations = 0.0;
+		double fragmentInvocations = 0.0;
+		// Frames measured so far
+		unsigned int samples = 0;
+	};
+
+	// Times a section for as long as it is in scope
+	class Scope
+	{
+	public:
+		Scope(GpuProfiler& profiler, const char* name) : profiler(profiler) { profiler.Begin(name); }
+		~Scope() { profiler.End(); }
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	private:
+		GpuProfiler& profiler;
+	};
+
+	// When false nothing is measured and Begin and End return at once
+	bool enabled = true;
+
+	// Constructor that checks for pipeline statistics queries, call once the context is current
+	GpuProfiler();
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+	// Reads the frame measured Latency frames ago if the GPU is done with it and starts a new one
+	void BeginFrame();
+	// Ends the frame, its whole time is reported as the Frame section
+	void EndFrame();
+	// Starts timing a section, sections may nest
+	void Begin(const char* name);
+	// Ends the innermost section
+	void End();
+
+	// Every section seen so far, in the order they first appeared
+	const std::vector<Section>& Sections() const { return sections; }
+	// Averaged time of the first section with a name, 0 if it was never measured
+	double Milliseconds(const std::string& name) const;
+	// Frames whose results weren't ready when their queries had to be reused
+	unsigned int Dropped() const { return dropped; }
+	// Whether the context counts vertices, primitives and shader invocations
+	bool HasStatistics() const { return statistics; }
+	// The averages as a text table
+	std::string Report() const;
+	// Deletes every query
+	void Delete();
+private:
+	static constexpr int Slots = Latency + 1;
+	static constexpr int StatisticsTargets = 4;
+
+	struct Record
+	{
+		size_t section;
+		GLuint start;
+		GLuint end;
+		// Index into the frame's statistics queries, -1 without
+		int statistics;
+	};
+	struct Frame
+	{
+		std::vector<Record> records;
+		GLuint start = 0;
+		GLuint end = 0;
+		bool measured = false;
+		// Queries are kept from frame to frame, used ones are counted
+		std::vector<GLuint> timestamps;
+		size_t timestampsUsed = 0;
+		std::vector<std::array<GLuint, StatisticsTargets>> statistics;
+		size_t statisticsUsed = 0;
+	};
+
+	bool statistics = false;
+	std::vector<Section> sections;
+	std::unordered_map<std::string, size_t> sectionIndices;
+	Frame frames[Slots];
+	int current = 0;
+	bool inFrame = false;
+	// Records of the current frame still open, innermost last
+	std::vector<size_t> open;
+	// Whether an open section is counting the pipeline statistics
+	bool counting = false;
+	unsigned int dropped = 0;
+
+	// Finds or adds a section
+	size_t section(const std::string& name, int depth);
+	// A timestamp query of the current frame, generated when the frame has none left
+	GLuint timestamp();
+	// Reads a frame's results into the averages, false if the GPU isn't done with them
+	bool collect(Frame& frame);
+	// Folds one measurement into a rolling average
+	static void average(double& value, double sample, unsigned int samples);
+};
+
+#endif
@@ -0,0 +1,207 @@
+#include"ImageDecoder.h"
+#include"CpuProfiler.h"
+#include<stb/stb_image.h>
+#include<cstring>
+#include<fstream>
+#ifdef ANIMATION_USE_TURBOJPEG
+#include<turbojpeg.h>
+#include<spng.h>
+#endif
+
+// Decodes an image with the given number of channels into a buffer of at least width * height * channels bytes
+bool ImageDecoder::Decode(const char* image, int channels, bool flip, unsigned char* dst, size_t dstSize)
+{
+	std::vector<unsigned char> file;
+	if (!ReadFile(image, file)) return false;
+	return DecodeFromMemory(file.data(), file.size(), channels, flip, dst, dstSize);
+}
+
+// Decodes an image into a newly allocated buffer, empty if it could not be read
+std::vector<unsigned char> ImageDecoder::Decode(const char* image, int channels, bool flip, ImageInfo& info)
+{
+	// The file is read once for both the header and the pixels
+	std::vector<unsigned char> pixels;
+	std::vector<unsigned char> file;
+	if (!ReadFile(image, file) || !InfoFromMemory(file.data(), file.size(), info)) return pixels;
+	pixels.resize((size_t)info.width * info.height * channels);
+	if (!DecodeFromMemory(file.data(), file.size(), channels, flip, pixels.data(), pixels.size())) pixels.clear();
+	return pixels;
+}
+
+// Reads a whole file into memory
+bool ImageDecoder::ReadFile(const char* filename, std::vector<unsigned char>& contents)
+{
+	std::ifstream in(filename, std::ios::binary | std::ios::ate);
+	if (!in) return false;
+	contents.resize((size_t)in.tellg());
+	in.seekg(0, std::ios::beg);
+	in.read((char*)contents.data(), contents.size());
+	return (bool)in;
+}
+
+bool StbImageDecoder::Info(const char* image, ImageInfo& info)
+{
+	// Only reads as far as the header
+	return stbi_info(image, &info.width, &info.height, &info.channels) != 0;
+}
+
+bool StbImageDecoder::InfoFromMemory(const unsigned char* file, size_t fileSize, ImageInfo& info)
+{
+	return stbi_info_from_memory(file, (int)fileSize, &info.width, &info.height, &info.channels) != 0;
+}
+
+bool StbImageDecoder::DecodeFromMemory(const unsigned char* file, size_t fileSize, int channels, bool flip, unsigned char* dst, size_t dstSize)
+{
+	PROFILE_ZONE("Texture decode (stb_image)");
+	// stb_image always allocates its own buffer, so this path pays one extra copy
+	int width, height, numColCh;
+	stbi_set_flip_vertically_on_load_thread(flip);
+	unsigned char* bytes = stbi_load_from_memory(file, (int)fileSize, &width, &height, &numColCh, channels);
+	if (bytes == nullptr) return false;
+
+	size_t size = (size_t)width * height * channels;
+	bool fits = size <= dstSize;
+	if (fits) memcpy(dst, bytes, size);
+	stbi_image_free(bytes);
+	return fits;
+}
+
+#ifdef ANIMATION_USE_TURBOJPEG
+// Swaps the rows of an image so its first row ends up last
+static void flipRows(unsigned char* pixels, int width, int height, int channels)
+{
+	size_t stride = (size_t)width * channels;
+	std::vector<unsigned char> row(stride);
+	for (int y = 0; y < height / 2; y++)
+	{
+		unsigned char* top = pixels + y * stride;
+		unsigned char* bottom = pixels + (height - 1 - y) * stride;
+		memcpy(row.data(), top, stride);
+		memcpy(top, bottom, stride);
+		memcpy(bottom, row.data(), stride);
+	}
+}
+
+static bool isJpeg(const unsigned char* file, size_t size)
+{
+	return size > 2 && file[0] == 0xFF && file[1] == 0xD8;
+}
+
+static bool isPng(const unsigned char* file, size_t size)
+{
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	return size > 8 && memcmp(file, signature, 8) == 0;
+}
+
+// One decompressor per thread so worker threads can decode at the same time,
+// destroyed when its thread exits
+static tjhandle jpegDecompressor()
+{
+	struct Decompressor
+	{
+		tjhandle handle = tjInitDecompress();
+		~Decompressor() { if (handle != nullptr) tjDestroy(handle); }
+	};
+	thread_local Decompressor decompressor;
+	return decompressor.handle;
+}
+
+bool TurboImageDecoder::Info(const char* image, ImageInfo& info)
+{
+	std::vector<unsigned char> file;
+	if (!ReadFile(image, file)) return false;
+	return InfoFromMemory(file.data(), file.size(), info);
+}
+
+bool TurboImageDecoder::InfoFromMemory(const unsigned char* file, size_t fileSize, ImageInfo& info)
+{
+	if (isJpeg(file, fileSize))
+	{
+		int subsamp, colorspace;
+		if (tjDecompressHeader3(jpegDecompressor(), file, (unsigned long)fileSize,
+			&info.width, &info.height, &subsamp, &colorspace) != 0) return false;
+		info.channels = colorspace == TJCS_GRAY ? 1 : 3;
+		return true;
+	}
+	if (isPng(file, fileSize))
+	{
+		spng_ctx* ctx = spng_ctx_new(0);
+		spng_set_png_buffer(ctx, file, fileSize);
+		spng_ihdr ihdr;
+		bool ok = spng_get_ihdr(ctx, &ihdr) == 0;
+		spng_ctx_free(ctx);
+		if (!ok) return false;
+		info.width = (int)ihdr.width;
+		info.height = (int)ihdr.height;
+		switch (ihdr.color_type)
+		{
+		case SPNG_COLOR_TYPE_GRAYSCALE: info.channels = 1; break;
+		case SPNG_COLOR_TYPE_GRAYSCALE_ALPHA: info.channels = 2; break;
+		case SPNG_COLOR_TYPE_TRUECOLOR_ALPHA: info.channels = 4; break;
+		default: info.channels = 3; break;
+		}
+		return true;
+	}
+	return fallback.InfoFromMemory(file, fileSize, info);
+}
+
+bool TurboImageDecoder::DecodeFromMemory(const unsigned char* file, size_t fileSize, int channels, bool flip, unsigned char* dst, size_t dstSize)
+{
+	// Only RGB and RGBA have a direct path, other layouts go through stb_image
+	if (channels != 3 && channels != 4) return fallback.DecodeFromMemory(file, fileSize, channels, flip, dst, dstSize);
+
+	PROFILE_ZONE("Texture decode (turbo)");
+	if (isJpeg(file, fileSize))
+	{
+		tjhandle handle = jpegDecompressor();
+		int width, height, subsamp, colorspace;
+		if (tjDecompressHeader3(handle, file, (unsigned long)fileSize, &width, &height, &subsamp, &colorspace) != 0) return false;
+		if ((size_t)width * height * channels > dstSize) return false;
+		int flags = flip ? TJFLAG_BOTTOMUP : 0;
+#ifdef ANIMATION_TURBOJPEG_FASTDCT
+		// Lossier than stb_image's IDCT, only when asked for
+		flags |= TJFLAG_FASTDCT;
+#endif
+		return tjDecompress2(handle, file, (unsigned long)fileSize, dst, width, 0, height,
+			channels == 3 ? TJPF_RGB : TJPF_RGBA, flags) == 0;
+	}
+	if (isPng(file, fileSize))
+	{
+		spng_ctx* ctx = spng_ctx_new(0);
+		spng_set_png_buffer(ctx, file, fileSize);
+		int format = channels == 3 ? SPNG_FMT_RGB8 : SPNG_FMT_RGBA8;
+		spng_ihdr ihdr;
+		size_t size = 0;
+		bool ok = spng_get_ihdr(ctx, &ihdr) == 0
+			&& spng_decoded_image_size(ctx, format, &size) == 0
+			&& size <= dstSize
+			&& spng_decode_image(ctx, dst, size, format, SPNG_DECODE_TRNS) == 0;
+		spng_ctx_free(ctx);
+		if (ok && flip) flipRows(dst, (int)ihdr.width, (int)ihdr.height, channels);
+		return ok;
+	}
+	return fallback.DecodeFromMemory(file, fileSize, channels, flip, dst, dstSize);
+}
+#endif
+
+// Returns the fastest decoder compiled into this build
+ImageDecoder& DefaultImageDecoder()
+{
+#ifdef ANIMATION_USE_TURBOJPEG
+	static TurboImageDecoder decoder;
+#else
+	static StbImageDecoder decoder;
+#endif
+	return decoder;
+}
+
+// Returns every decoder compiled into this build, the stb_image one first
+std::vector<ImageDecoder*> AvailableImageDecoders()
+{
+	static StbImageDecoder stb;
+	std::vector<ImageDecoder*> decoders = { &stb };
+#ifdef ANIMATION_USE_TURBOJPEG
+	decoders.push_back(&DefaultImageDecoder());
+#endif
+	return decoders;
+}
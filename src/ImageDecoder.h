@@ -0,0 +1,80 @@
+#ifndef IMAGE_DECODER_CLASS_H
+#define IMAGE_DECODER_CLASS_H
+
+#include<cstddef>
+#include<vector>
+
+// Decodes JPEGs with libjpeg-turbo and PNGs with libspng, both SIMD accelerated, when built with
+// ANIMATION_USE_TURBOJPEG. The project does that when the UseTurboJpeg property is true, e.g.
+// msbuild animation.sln /p:UseTurboJpeg=true, with turbojpeg.h and spng.h in Libraries\include
+// and turbojpeg.lib and spng.lib in Libraries\lib. stb_image stays the fallback.
+// JPEGs are decoded with the accurate DCT, so both backends give the same pixels within rounding.
+// /p:TurboJpegFastDct=true defines ANIMATION_TURBOJPEG_FASTDCT, which trades some quality for
+// speed with TJFLAG_FASTDCT; the backend's Name says so, e.g. in the decode benchmark.
+
+// Dimensions of an image as stored in its file
+struct ImageInfo
+{
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+};
+
+class ImageDecoder
+{
+public:
+	virtual ~ImageDecoder() = default;
+
+	// Name of the backend
+	virtual const char* Name() const = 0;
+	// Reads the dimensions of an image without decoding its pixels
+	virtual bool Info(const char* image, ImageInfo& info) = 0;
+	// Reads the dimensions of an image file already in memory
+	virtual bool InfoFromMemory(const unsigned char* file, size_t fileSize, ImageInfo& info) = 0;
+	// Decodes an image file already in memory with the given number of channels into a buffer
+	// of at least width * height * channels bytes
+	virtual bool DecodeFromMemory(const unsigned char* file, size_t fileSize, int channels, bool flip, unsigned char* dst, size_t dstSize) = 0;
+
+	// Decodes an image with the given number of channels into a buffer of at least width * height * channels bytes
+	bool Decode(const char* image, int channels, bool flip, unsigned char* dst, size_t dstSize);
+	// Decodes an image into a newly allocated buffer, empty if it could not be read
+	std::vector<unsigned char> Decode(const char* image, int channels, bool flip, ImageInfo& info);
+
+	// Reads a whole file into memory
+	static bool ReadFile(const char* filename, std::vector<unsigned char>& contents);
+};
+
+// Decodes every format through stb_image
+class StbImageDecoder : public ImageDecoder
+{
+public:
+	const char* Name() const override { return "stb_image"; }
+	bool Info(const char* image, ImageInfo& info) override;
+	bool InfoFromMemory(const unsigned char* file, size_t fileSize, ImageInfo& info) override;
+	bool DecodeFromMemory(const unsigned char* file, size_t fileSize, int channels, bool flip, unsigned char* dst, size_t dstSize) override;
+};
+
+#ifdef ANIMATION_USE_TURBOJPEG
+// Decodes JPEGs with libjpeg-turbo and PNGs with libspng, anything else through stb_image
+class TurboImageDecoder : public ImageDecoder
+{
+public:
+#ifdef ANIMATION_TURBOJPEG_FASTDCT
+	const char* Name() const override { return "libjpeg-turbo (fast DCT)/libspng"; }
+#else
+	const char* Name() const override { return "libjpeg-turbo/libspng"; }
+#endif
+	bool Info(const char* image, ImageInfo& info) override;
+	bool InfoFromMemory(const unsigned char* file, size_t fileSize, ImageInfo& info) override;
+	bool DecodeFromMemory(const unsigned char* file, size_t fileSize, int channels, bool flip, unsigned char* dst, size_t dstSize) override;
+private:
+	StbImageDecoder fallback;
+};
+#endif
+
+// Returns the fastest decoder compiled into this build
+ImageDecoder& DefaultImageDecoder();
+// Returns every decoder compiled into this build, the stb_image one first
+std::vector<ImageDecoder*> AvailableImageDecoders();
+
+#endif
@@ -0,0 +1,160 @@
+#include"InputSource.h"
+#include<cstring>
+
+namespace
+{
+	// Start of a recording, followed by one 16 byte record per frame
+	const char magic[4] = { 'A', 'I', 'N', 'P' };
+	const uint32_t version = 1;
+
+	struct KeyBinding
+	{
+		int key;
+		InputKey bit;
+	};
+	const KeyBinding bindings[] =
+	{
+		{ GLFW_KEY_W, INPUT_FORWARD },
+		{ GLFW_KEY_A, INPUT_LEFT },
+		{ GLFW_KEY_S, INPUT_BACK },
+		{ GLFW_KEY_D, INPUT_RIGHT },
+		{ GLFW_KEY_SPACE, INPUT_UP },
+		{ GLFW_KEY_LEFT_CONTROL, INPUT_DOWN },
+		{ GLFW_KEY_LEFT_SHIFT, INPUT_FAST },
+		{ GLFW_KEY_F1, INPUT_COLLISION },
+		{ GLFW_KEY_F2, INPUT_AABBS },
+		{ GLFW_KEY_F3, INPUT_DEPTH_PREPASS },
+		{ GLFW_KEY_F4, INPUT_DYNAMIC_RESOLUTION },
+		{ GLFW_KEY_F, INPUT_FLASHLIGHT },
+		{ GLFW_KEY_L, INPUT_CEILING_LIGHTS },
+		{ GLFW_KEY_P, INPUT_FOV_UP },
+		{ GLFW_KEY_O, INPUT_FOV_DOWN },
+	};
+}
+
+// Closes the recording
+InputSource::~InputSource()
+{
+	Close();
+}
+
+// Starts writing every frame to a file, false if it can't be created
+bool InputSource::Record(const std::string& path)
+{
+	Close();
+	file = std::fopen(path.c_str(), "wb");
+	if (file == nullptr) return false;
+	std::fwrite(magic, 1, sizeof(magic), file);
+	std::fwrite(&version, sizeof(version), 1, file);
+	mode = Mode::Record;
+	return true;
+}
+
+// Loads a recording to play back instead of the window's input, false if it can't be read
+bool InputSource::Replay(const std::string& path)
+{
+	FILE* in = std::fopen(path.c_str(), "rb");
+	if (in == nullptr) return false;
+	char header[4];
+	uint32_t fileVersion = 0;
+	bool ok = std::fread(header, 1, sizeof(header), in) == sizeof(header) && std::memcmp(header, magic, sizeof(magic)) == 0
+		&& std::fread(&fileVersion, sizeof(fileVersion), 1, in) == 1 && fileVersion == version;
+	std::vector<InputFrame> loaded;
+	InputFrame frame;
+	while (ok && std::fread(&frame.keys, sizeof(frame.keys), 1, in) == 1
+		&& std::fread(&frame.cursorX, sizeof(frame.cursorX), 1, in) == 1
+		&& std::fread(&frame.cursorY, sizeof(frame.cursorY), 1, in) == 1
+		&& std::fread(&frame.deltaTime, sizeof(frame.deltaTime), 1, in) == 1)
+	{
+		loaded.push_back(frame);
+	}
+	std::fclose(in);
+	if (!ok) return false;
+
+	Close();
+	frames = std::move(loaded);
+	position = 0;
+	mode = Mode::Replay;
+	return true;
+}
+
+// The input of the next frame, window is only read when not replaying
+InputFrame InputSource::Next(GLFWwindow* window, int width, int height)
+{
+	InputFrame frame;
+	if (mode == Mode::Replay)
+	{
+		if (position < frames.size()) frame = frames[position++];
+	}
+	else
+	{
+		frame = poll(window, width, height);
+		double clock = glfwGetTime();
+		if (fixedDeltaTime > 0.0f) frame.deltaTime = fixedDeltaTime;
+		else frame.deltaTime = lastClock < 0.0 ? 0.0f : (float)(clock - lastClock);
+		lastClock = clock;
+		if (mode == Mode::Record && file != nullptr)
+		{
+			std::fwrite(&frame.keys, sizeof(frame.keys), 1, file);
+			std::fwrite(&frame.cursorX, sizeof(frame.cursorX), 1, file);
+			std::fwrite(&frame.cursorY, sizeof(frame.cursorY), 1, file);
+			std::fwrite(&frame.deltaTime, sizeof(frame.deltaTime), 1, file);
+		}
+	}
+	time += frame.deltaTime;
+	count++;
+	return frame;
+}
+
+// Finishes writing the recording
+void InputSource::Close()
+{
+	if (file != nullptr)
+	{
+		std::fclose(file);
+		file = nullptr;
+	}
+	if (mode == Mode::Record) mode = Mode::Live;
+}
+
+// Reads the keys and cursor from the window
+InputFrame InputSource::poll(GLFWwindow* window, int width, int height)
+{
+	InputFrame frame;
+	for (const KeyBinding& binding : bindings)
+	{
+		if (glfwGetKey(window, binding.key) == GLFW_PRESS) frame.keys |= binding.bit;
+	}
+
+	if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
+	{
+		frame.keys |= INPUT_LOOK;
+		// Hides mouse cursor
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_HIDDEN);
+
+		// Prevents camera from jumping on the first click
+		if (firstClick)
+		{
+			glfwSetCursorPos(window, (width / 2), (height / 2));
+			firstClick = false;
+		}
+
+		// Movement of the cursor away from the middle of the window since the last frame
+		double mouseX;
+		double mouseY;
+		glfwGetCursorPos(window, &mouseX, &mouseY);
+		frame.cursorX = (float)(mouseX - (width / 2));
+		frame.cursorY = (float)(mouseY - (height / 2));
+
+		// Sets mouse cursor to the middle of the screen so that it doesn't end up roaming around
+		glfwSetCursorPos(window, (width / 2), (height / 2));
+	}
+	else
+	{
+		// Unhides cursor since camera is not looking around anymore
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+		// Makes sure the next time the camera looks around it doesn't jump
+		firstClick = true;
+	}
+	return frame;
+}
@@ -0,0 +1,92 @@
+#ifndef INPUT_SOURCE_CLASS_H
+#define INPUT_SOURCE_CLASS_H
+
+#include<GLFW/glfw3.h>
+#include<cstdint>
+#include<cstdio>
+#include<string>
+#include<vector>
+
+// Keys and buttons the simulation reacts to, one bit each
+enum InputKey : uint32_t
+{
+	INPUT_FORWARD = 1u << 0,          // W
+	INPUT_LEFT = 1u << 1,             // A
+	INPUT_BACK = 1u << 2,             // S
+	INPUT_RIGHT = 1u << 3,            // D
+	INPUT_UP = 1u << 4,               // Space
+	INPUT_DOWN = 1u << 5,             // Left control
+	INPUT_FAST = 1u << 6,             // Left shift
+	INPUT_LOOK = 1u << 7,             // Left mouse button
+	INPUT_COLLISION = 1u << 8,        // F1
+	INPUT_AABBS = 1u << 9,            // F2
+	INPUT_DEPTH_PREPASS = 1u << 10,   // F3
+	INPUT_DYNAMIC_RESOLUTION = 1u << 11, // F4
+	INPUT_FLASHLIGHT = 1u << 12,      // F
+	INPUT_CEILING_LIGHTS = 1u << 13,  // L
+	INPUT_FOV_UP = 1u << 14,          // P
+	INPUT_FOV_DOWN = 1u << 15,        // O
+};
+
+// Everything a frame of the simulation reads from the user
+struct InputFrame
+{
+	uint32_t keys = 0;
+	// Cursor movement from the middle of the window while looking around, in pixels
+	float cursorX = 0.0f;
+	float cursorY = 0.0f;
+	// Seconds since the previous frame
+	float deltaTime = 0.0f;
+
+	// Whether a key is held
+	bool Down(InputKey key) const { return (keys & key) != 0; }
+};
+
+// Hands the simulation one InputFrame per frame: read from the window, read from the window
+// and appended to a recording, or read back from a recording so a session plays out the same
+// way on every run and build
+class InputSource
+{
+public:
+	enum class Mode { Live, Record, Replay };
+
+	// When above zero live frames advance the clock by this many seconds instead of the measured time
+	float fixedDeltaTime = 0.0f;
+
+	InputSource() = default;
+	// Closes the recording
+	~InputSource();
+	InputSource(const InputSource&) = delete;
+	InputSource& operator=(const InputSource&) = delete;
+
+	// Starts writing every frame to a file, false if it can't be created
+	bool Record(const std::string& path);
+	// Loads a recording to play back instead of the window's input, false if it can't be read
+	bool Replay(const std::string& path);
+	// The input of the next frame, window is only read when not replaying
+	InputFrame Next(GLFWwindow* window, int width, int height);
+	// Whether a replay has run out of frames
+	bool Finished() const { return mode == Mode::Replay && position >= frames.size(); }
+	// Seconds simulated so far, the sum of every frame's deltaTime
+	double Time() const { return time; }
+	// Frames handed out so far
+	size_t Frames() const { return count; }
+	Mode GetMode() const { return mode; }
+	// Finishes writing the recording
+	void Close();
+private:
+	Mode mode = Mode::Live;
+	FILE* file = nullptr;
+	std::vector<InputFrame> frames;
+	size_t position = 0;
+	size_t count = 0;
+	double time = 0.0;
+	double lastClock = -1.0;
+	// Prevents the view from jumping on the first frame the button is held
+	bool firstClick = true;
+
+	// Reads the keys and cursor from the window
+	InputFrame poll(GLFWwindow* window, int width, int height);
+};
+
+#endif
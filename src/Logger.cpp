@@ -0,0 +1,242 @@
+#include"Logger.h"
+#include<chrono>
+#include<condition_variable>
+#include<cstdarg>
+#include<cstdio>
+#include<mutex>
+#include<thread>
+
+#ifdef NDEBUG
+std::atomic<int> Logger::minimum{ (int)LogLevel::Info };
+#else
+std::atomic<int> Logger::minimum{ (int)LogLevel::Debug };
+#endif
+
+namespace
+{
+	// A message and the turn it belongs to: a producer may fill it when sequence equals its
+	// position, the writer may read it once sequence is one past that
+	struct Slot
+	{
+		std::atomic<size_t> sequence{ 0 };
+		LogLevel level = LogLevel::Info;
+		double time = 0.0;
+		unsigned int suppressed = 0;
+		char text[Logger::MessageBytes];
+	};
+
+	struct Ring;
+	void stop(Ring& r);
+
+	struct Ring
+	{
+		Slot slots[Logger::Capacity];
+		std::atomic<size_t> enqueue{ 0 };
+		// Only advanced by the writer, read by Flush
+		std::atomic<size_t> dequeue{ 0 };
+		std::atomic<size_t> dropped{ 0 };
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		std::once_flag started;
+		std::thread writer;
+		std::mutex mutex;
+		std::condition_variable wake;
+		bool stopping = false;
+		std::atomic<bool> stopped{ false };
+
+		Ring()
+		{
+			for (size_t i = 0; i < Logger::Capacity; i++) slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		~Ring()
+		{
+			stop(*this);
+		}
+	};
+
+	Ring& ring()
+	{
+		static Ring instance;
+		return instance;
+	}
+
+	const char* levelName(LogLevel level)
+	{
+		switch (level)
+		{
+		case LogLevel::Debug: return "debug";
+		case LogLevel::Info: return "info";
+		case LogLevel::Warning: return "warning";
+		default: return "error";
+		}
+	}
+
+	// Writes one message, warnings and errors go to stderr
+	void print(LogLevel level, double time, unsigned int suppressed, const char* text)
+	{
+		FILE* out = level >= LogLevel::Warning ? stderr : stdout;
+		std::fprintf(out, "[%9.3f] %s: %s", time, levelName(level), text);
+		if (suppressed > 0) std::fprintf(out, " (%u more suppressed)", suppressed);
+		std::fputc('\n', out);
+	}
+
+	// Writes every message that is ready, returns how many there were
+	size_t drain(Ring& r)
+	{
+		size_t written = 0;
+		size_t position = r.dequeue.load(std::memory_order_relaxed);
+		while (true)
+		{
+			Slot& slot = r.slots[position & (Logger::Capacity - 1)];
+			if (slot.sequence.load(std::memory_order_acquire) != position + 1) break;
+			print(slot.level, slot.time, slot.suppressed, slot.text);
+			// Hands the slot to the producer one lap ahead
+			slot.sequence.store(position + Logger::Capacity, std::memory_order_release);
+			position++;
+			written++;
+		}
+		if (written > 0)
+		{
+			std::fflush(stdout);
+			std::fflush(stderr);
+			r.dequeue.store(position, std::memory_order_release);
+		}
+		return written;
+	}
+
+	// Loop of the writer thread, polls the ring so producers never have to wake it
+	void writeLoop(Ring& r)
+	{
+		while (true)
+		{
+			if (drain(r) > 0) continue;
+			std::unique_lock<std::mutex> lock(r.mutex);
+			if (r.stopping) break;
+			r.wake.wait_for(lock, std::chrono::milliseconds(2));
+		}
+		drain(r);
+	}
+
+	// Writes what is queued and joins the writer, once
+	void stop(Ring& r)
+	{
+		if (r.stopped.exchange(true, std::memory_order_acq_rel)) return;
+		// Waits for a writer being started by a message racing the shutdown, or keeps one from starting
+		std::call_once(r.started, []() {});
+		{
+			std::lock_guard<std::mutex> lock(r.mutex);
+			r.stopping = true;
+		}
+		r.wake.notify_one();
+		if (r.writer.joinable()) r.writer.join();
+	}
+
+	// Claims a slot, formats into it and publishes it, or counts the message as dropped
+	void write(LogLevel level, unsigned int suppressed, const char* format, va_list args)
+	{
+		Ring& r = ring();
+		double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - r.start).count();
+		if (r.stopped.load(std::memory_order_acquire))
+		{
+			char text[Logger::MessageBytes];
+			std::vsnprintf(text, sizeof(text), format, args);
+			print(level, time, suppressed, text);
+			return;
+		}
+		std::call_once(r.started, [&r]() { r.writer = std::thread(writeLoop, std::ref(r)); });
+
+		size_t position = r.enqueue.load(std::memory_order_relaxed);
+		Slot* slot;
+		while (true)
+		{
+			slot = &r.slots[position & (Logger::Capacity - 1)];
+			size_t sequence = slot->sequence.load(std::memory_order_acquire);
+			intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+			if (difference == 0)
+			{
+				if (r.enqueue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+			}
+			else if (difference < 0)
+			{
+				// The writer hasn't freed this slot from the last lap yet, so the ring is full
+				r.dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			else
+			{
+				position = r.enqueue.load(std::memory_order_relaxed);
+			}
+		}
+
+		slot->level = level;
+		slot->time = time;
+		slot->suppressed = suppressed;
+		std::vsnprintf(slot->text, sizeof(slot->text), format, args);
+		slot->sequence.store(position + 1, std::memory_order_release);
+	}
+}
+
+Logger::RateLimit::RateLimit(double seconds)
+	: interval((uint64_t)(seconds * 1e9))
+{
+}
+
+// Whether a message may go out now, suppressed is set to how many were held back since the last one
+bool Logger::RateLimit::Allow(unsigned int& suppressed)
+{
+	uint64_t now = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	uint64_t due = next.load(std::memory_order_relaxed);
+	if (now < due || !next.compare_exchange_strong(due, now + interval, std::memory_order_relaxed))
+	{
+		held.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	suppressed = held.exchange(0, std::memory_order_relaxed);
+	return true;
+}
+
+// Queues a printf style message if its level is enabled
+void Logger::Write(LogLevel level, const char* format, ...)
+{
+	if (!Enabled(level)) return;
+	va_list args;
+	va_start(args, format);
+	write(level, 0, format, args);
+	va_end(args);
+}
+
+// Same, if the rate limit lets it through
+void Logger::WriteLimited(RateLimit& limit, LogLevel level, const char* format, ...)
+{
+	unsigned int suppressed = 0;
+	if (!Enabled(level) || !limit.Allow(suppressed)) return;
+	va_list args;
+	va_start(args, format);
+	write(level, suppressed, format, args);
+	va_end(args);
+}
+
+// Waits until every message queued so far has been written
+void Logger::Flush()
+{
+	Ring& r = ring();
+	size_t target = r.enqueue.load(std::memory_order_acquire);
+	// Once stopped the shutdown writes what is left, and the writer thread may be being joined,
+	// so only the atomics are read here
+	while (r.dequeue.load(std::memory_order_acquire) < target && !r.stopped.load(std::memory_order_acquire))
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+// Writes what is queued and stops the writer thread, later messages are written directly
+void Logger::Shutdown()
+{
+	stop(ring());
+}
+
+// Messages lost because the ring was full
+size_t Logger::Dropped()
+{
+	return ring().dropped.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,65 @@
+#ifndef LOGGER_CLASS_H
+#define LOGGER_CLASS_H
+
+#include<atomic>
+#include<cstddef>
+#include<cstdint>
+
+enum class LogLevel
+{
+	Debug,
+	Info,
+	Warning,
+	Error,
+};
+
+// Formats messages on the calling thread into a fixed ring of slots that any thread can claim
+// without locking, and writes them out from a background thread, so logging never waits on the
+// terminal. Messages are dropped, and counted, when the ring is full rather than blocking.
+class Logger
+{
+public:
+	// Slots in the ring, a power of two
+	static constexpr size_t Capacity = 4096;
+	// Longest message kept, longer ones are cut
+	static constexpr size_t MessageBytes = 240;
+
+	// Lets one message through every interval seconds and counts the ones it holds back
+	class RateLimit
+	{
+	public:
+		explicit RateLimit(double seconds);
+		// Whether a message may go out now, suppressed is set to how many were held back since the last one
+		bool Allow(unsigned int& suppressed);
+	private:
+		uint64_t interval;
+		std::atomic<uint64_t> next{ 0 };
+		std::atomic<unsigned int> held{ 0 };
+	};
+
+	// Queues a printf style message if its level is enabled
+	static void Write(LogLevel level, const char* format, ...);
+	// Same, if the rate limit lets it through
+	static void WriteLimited(RateLimit& limit, LogLevel level, const char* format, ...);
+	// Messages below this level are skipped before they are formatted
+	static void SetLevel(LogLevel level) { minimum.store((int)level, std::memory_order_relaxed); }
+	// Whether messages of a level are written
+	static bool Enabled(LogLevel level) { return (int)level >= minimum.load(std::memory_order_relaxed); }
+	// Waits until every message queued so far has been written
+	static void Flush();
+	// Writes what is queued and stops the writer thread, later messages are written directly
+	static void Shutdown();
+	// Messages lost because the ring was full
+	static size_t Dropped();
+private:
+	static std::atomic<int> minimum;
+};
+
+#define LOG_DEBUG(...) Logger::Write(LogLevel::Debug, __VA_ARGS__)
+#define LOG_INFO(...) Logger::Write(LogLevel::Info, __VA_ARGS__)
+#define LOG_WARNING(...) Logger::Write(LogLevel::Warning, __VA_ARGS__)
+#define LOG_ERROR(...) Logger::Write(LogLevel::Error, __VA_ARGS__)
+// Writes at most one message every seconds from this call site, for messages sent every frame
+#define LOG_EVERY(seconds, level, ...) do { static Logger::RateLimit logRateLimit(seconds); Logger::WriteLimited(logRateLimit, level, __VA_ARGS__); } while (0)
+
+#endif
@@ -15,6 +15,32 @@
 #include"Mesh.h"
 #include"ModelLoader.h"
 #include"AABB.h"
+#include"TextureStreamer.h"
+#include"TextureUploader.h"
+#include"GLExtensions.h"
+#include"UBO.h"
+#include"FrameUniforms.h"
+#include"Benchmarks.h"
+#include"RenderQueue.h"
+#include"OcclusionCuller.h"
+#include"CellPortalGraph.h"
+#include"PotentiallyVisibleSet.h"
+#include"GeometryBuffer.h"
+#include"Crowd.h"
+#include"ClusteredLights.h"
+#include"ShaderVariants.h"
+#include"DynamicResolution.h"
+#include"GpuProfiler.h"
+#include"CpuProfiler.h"
+#include"Logger.h"
+#include"DebugDraw.h"
+#include"CameraPath.h"
+#include"InputSource.h"
+#include"FixedTimestep.h"
+#include<algorithm>
+#include<cstdlib>
+#include<string>
+#include<thread>
 
 
 
@@ -23,15 +49,21 @@ const unsigned int height = 1080;
 bool enableCollision = true;
 bool showAABBs = false;
 bool fleshlight = true; // Toggle for fleshlight effect
+bool ceilingLights = true; // Toggle for the school's ceiling lights
+bool depthPrePass = false; // Toggle for laying down depth before shading
+bool dynamicResolution = true; // Toggle for lowering the resolution of heavy views
 float fov = 70.0f; // Field of view for the camera
+size_t textureBudgetMB = 256; // VRAM the streamed textures may use
+float simulationRate = 60.0f; // Steps per second of the camera, collision and walkers, whatever the frame rate
 
 // Nathan animation variables
 float nathanWalkSpeed = 2.0f; // Units per second
 glm::vec3 nathanStartPos = glm::vec3(3.6f, 1.0f, -45.8f);
 glm::vec3 nathanEndPos = glm::vec3(29.6f, 1.0f, -45.8f);
 glm::vec3 nathanCurrentPos = nathanStartPos;
+glm::vec3 nathanPreviousPos = nathanStartPos; // Position before the last simulation step
 bool nathanMovingToEnd = true; // true = moving to end position, false = moving to start
-float nathanLastTime = 0.0f;
+size_t crowdSize = 0; // More Nathans walking around his corridor, --bench-crowd sets its own sizes
 
 // Vertices coordinates
 Vertex vertices[] =
@@ -77,10 +109,9 @@ GLuint lightIndices[] =
 	4, 6, 7
 };
 
-// Function to update Nathan's position
-void updateNathanPosition(float currentTime) {
-	float deltaTime = currentTime - nathanLastTime;
-	nathanLastTime = currentTime;
+// Function to update Nathan's position over one simulation step
+void updateNathanPosition(float deltaTime) {
+	nathanPreviousPos = nathanCurrentPos;
 
 	if (nathanMovingToEnd) {
 		// Move towards end position
@@ -106,9 +137,56 @@ void updateNathanPosition(float currentTime) {
 	}
 }
 
-int main()
+int main(int argc, char** argv)
 {
+	// Benchmarks that don't need a window
+	if (argc > 1 && std::string(argv[1]) == "--bench-decode")
+	{
+		return RunDecodeBenchmark(argc > 2 ? argv[2] : "textures");
+	}
+	if (argc > 1 && std::string(argv[1]) == "--check-occlusion")
+	{
+		return RunOcclusionCheck();
+	}
+	if (argc > 1 && std::string(argv[1]) == "--check-portals")
+	{
+		return RunPortalCheck();
+	}
+	// Bakes the school's potentially visible sets to a file instead of running
+	bool bakePVS = argc > 1 && std::string(argv[1]) == "--bake-pvs";
+	std::string pvsPath = bakePVS && argc > 2 ? argv[2] : "models/MapSchool.pvs";
+	// Measures the frame time with growing crowds from a fixed view
+	bool benchCrowd = argc > 1 && std::string(argv[1]) == "--bench-crowd";
+	// Compares the normal matrix inverted per vertex with the one computed on the CPU
+	bool benchVertex = argc > 1 && std::string(argv[1]) == "--bench-vertex";
+	// Prints the GPU time of each pass when the program exits
+	bool profileGPU = argc > 1 && std::string(argv[1]) == "--profile-gpu";
+	// Captures the CPU zones from startup, loading included, until F6 or exit and writes them as a Chrome trace
+	bool traceCPU = argc > 1 && std::string(argv[1]) == "--trace";
+	std::string tracePath = traceCPU && argc > 2 ? argv[2] : "trace.json";
+	// Renders a fixed number of frames along a camera path into an offscreen target, prints the frame
+	// times and saves some frames as images when given a folder. Only runs without a display through
+	// OSMesa, which GLFW must be built with and recent Mesa releases no longer ship; otherwise it
+	// falls back to a hidden window, which still needs a display (or a virtual one such as Xvfb)
+	bool headless = argc > 1 && std::string(argv[1]) == "--headless";
+	int headlessFrames = headless && argc > 2 ? std::max(1, std::atoi(argv[2])) : 600;
+	std::string imageDir = headless && argc > 3 ? argv[3] : "";
+	std::string cameraPathFile = headless && argc > 4 ? argv[4] : "";
+	// Writes the keys, cursor movement and frame time of every frame to a file
+	bool recordInput = argc > 1 && std::string(argv[1]) == "--record";
+	// Plays a recorded session back instead of reading the keyboard and mouse, then exits
+	bool replayInput = argc > 1 && std::string(argv[1]) == "--replay";
+	std::string inputPath = (recordInput || replayInput) && argc > 2 ? argv[2] : "session.input";
+	// Flies the camera along a path over the given seconds at a fixed step per frame, then exits
+	bool flythrough = argc > 1 && std::string(argv[1]) == "--flythrough";
+	if (flythrough && argc > 2) cameraPathFile = argv[2];
+	float flythroughSeconds = flythrough && argc > 3 ? std::max(1.0f, (float)std::atof(argv[3])) : 30.0f;
+	PROFILE_THREAD("Main");
+	if (traceCPU) CpuProfiler::Start();
+
 	// Initialize GLFW
+	// Headless runs use GLFW's null platform, which needs no display, with a Mesa OSMesa (llvmpipe) context
+	if (headless) glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
 	glfwInit();
 
 	// Tell GLFW what version of OpenGL we are using 
@@ -118,21 +196,43 @@ int main()
 	// Tell GLFW we are using the CORE profile
 	// So that means we only have the modern functions
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	if (headless) {
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	}
 
 	// Create a GLFWwindow object of 800 by 800 pixels, naming it "YoutubeOpenGL"
 	GLFWwindow* window = glfwCreateWindow(width, height, "main", NULL, NULL);
+	// Printed with the headless results, the two contexts run on very different rasterizers
+	std::string headlessContext = "OSMesa";
+	if (window == NULL && headless) {
+		// Without OSMesa a hidden window of the native platform still renders offscreen
+		LOG_WARNING("OSMesa unavailable, rendering headless through a hidden window");
+		glfwTerminate();
+		glfwInitHint(GLFW_PLATFORM, GLFW_ANY_PLATFORM);
+		glfwInit();
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		window = glfwCreateWindow(width, height, "main", NULL, NULL);
+		headlessContext = "hidden window";
+	}
 	// Error check if the window fails to create
 	if (window == NULL)
 	{
-		std::cout << "Failed to create GLFW window" << std::endl;
+		LOG_ERROR("Failed to create GLFW window");
+		Logger::Flush();
 		glfwTerminate();
 		return -1;
 	}
 	// Introduce the window into the current context
 	glfwMakeContextCurrent(window);
 
-	// Load GLAD so it configures OpenGL
-	gladLoadGL();
+	// Load GLAD so it configures OpenGL, through GLFW so OSMesa contexts resolve their functions too
+	gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+	// Load the entry points newer than OpenGL 3.3 the driver offers
+	LoadGLExtensions();
 	// REQUEST A HIGHER PRECISION DEPTH BUFFER
 	glfwWindowHint(GLFW_DEPTH_BITS, 24);
 	// Specify the viewport of OpenGL in the Window
@@ -144,26 +244,33 @@ int main()
 
 
 
-	// Generates Shader object using shaders default.vert and default.frag
-	Shader shaderProgram("src/default.vert", "src/default.frag");
+	// Variants of default.vert and default.frag with only the lighting each draw needs, compiled when first drawn
+	ShaderVariants defaultShaders("src/default.vert", "src/default.frag", DefaultFeatureNames(), DefaultDefines());
+
+	// Decodes textures on worker threads straight into a persistently mapped pixel buffer ring
+	TextureUploader textureUploader(64 * 1024 * 1024, 2);
+	// Streams the school's texture mips in through the uploader as the camera gets closer to them
+	TextureStreamer textureStreamer(textureBudgetMB * 1024 * 1024, 2, &textureUploader);
 
 	Model* schoolModel = nullptr;
 	try {
-		schoolModel = new Model("models/MapSchool.fbx");
-		std::cout << "School model loaded successfully!" << std::endl;
+		schoolModel = new Model("models/MapSchool.fbx", &textureStreamer, &textureUploader);
+		LOG_INFO("School model loaded successfully!");
 	}
 	catch (const std::exception& e) {
-		std::cerr << "Failed to load school model: " << e.what() << std::endl;
+		LOG_ERROR("Failed to load school model: %s", e.what());
 		// Continue without the model
 	}
 
 	Model* nathanModel = nullptr;
 	try {
-		nathanModel = new Model("models/nathan.fbx");
-		std::cout << "Nathan model loaded successfully!" << std::endl;
+		// Nathan and the crowd are always close enough to need every mip, so his textures are
+		// uploaded whole through the uploader instead of streamed
+		nathanModel = new Model("models/nathan.fbx", nullptr, &textureUploader);
+		LOG_INFO("Nathan model loaded successfully!");
 	}
 	catch (const std::exception& e) {
-		std::cerr << "Failed to load nathan model: " << e.what() << std::endl;
+		LOG_ERROR("Failed to load nathan model: %s", e.what());
 		// Continue without the model
 	}
 
@@ -176,26 +283,83 @@ int main()
 	glm::mat4 lightModel2 = glm::mat4(1.0f);
 	glm::vec3 spotDirection2 = glm::vec3(0.0f, 1.0f, 0.0f); // Example: pointing up
 	glm::vec3 lampPos = glm::vec3(-1.615f, 4.4f, 2.894f); // Example position inside your L-shaped room
-	glUniform3f(glGetUniformLocation(shaderProgram.ID, "lampPos"), lampPos.x, lampPos.y, lampPos.z);
 	lightModel = glm::translate(lightModel, lightPos);
 	lightModel2 = glm::translate(lightModel2, lightPos2);
 
 
 	
 
-	shaderProgram.Activate();
-	glUniform4f(glGetUniformLocation(shaderProgram.ID, "lightColor"), lightColor.x, lightColor.y, lightColor.z, lightColor.w);
-	glUniform3f(glGetUniformLocation(shaderProgram.ID, "lightPos"), lightPos.x, lightPos.y, lightPos.z);
-	glUniform4f(glGetUniformLocation(shaderProgram.ID, "lightColor2"), lightColor2.x, lightColor2.y, lightColor2.z, lightColor2.w);
-	glUniform3f(glGetUniformLocation(shaderProgram.ID, "lightPos2"), lightPos2.x, lightPos2.y, lightPos2.z);
-	glUniform3f(glGetUniformLocation(shaderProgram.ID, "spotDirection2"), spotDirection2.x, spotDirection2.y, spotDirection2.z);
-
-	// Set up texture uniforms in the shader
-	// This tells the shader which texture units to use for each texture type
-	glUniform1i(glGetUniformLocation(shaderProgram.ID, "diffuse0"), 0);
-	glUniform1i(glGetUniformLocation(shaderProgram.ID, "specular0"), 1);
-	glUniform1i(glGetUniformLocation(shaderProgram.ID, "normal0"), 2);
+	// Camera and lighting state shared by every draw, uploaded once per frame
+	UBO frameUBO(sizeof(FrameUniforms), FRAME_UNIFORMS_BINDING);
+	FrameUniforms frame = {};
+	frame.lampPos = lampPos;
+	frame.lightColor = lightColor;
+	frame.lightColor2 = lightColor2;
+	frame.lightPos2 = lightPos2;
+	frame.spotDirection2 = spotDirection2;
+
+	// The scene is drawn between half and full resolution, whatever keeps the GPU under the frame time target
+	DynamicResolution resolution(width, height);
+	// GPU time of each pass, read back a few frames late so it never waits on the GPU
+	GpuProfiler gpuProfiler;
+
+	// Sorts the draws of each frame and skips redundant state changes
+	RenderQueue renderQueue;
+	renderQueue.profiler = &gpuProfiler;
+	// Draws and driver calls shown in the title, refreshed once per second
+	double statsTime = glfwGetTime();
+
+	// With GL 4.3 the static meshes share one set of buffers and go out as multi-draws,
+	// otherwise every mesh keeps drawing from its own vertex array
+	GeometryBuffer* geometryBuffer = nullptr;
+	ShaderVariants* indirectShaders = nullptr;
+	if (GeometryBuffer::Supported()) {
+		indirectShaders = new ShaderVariants("src/indirect.vert", "src/default.frag", DefaultFeatureNames(), DefaultDefines());
+		geometryBuffer = new GeometryBuffer();
+		if (schoolModel != nullptr) geometryBuffer->Add(schoolModel->meshes);
+		if (nathanModel != nullptr) geometryBuffer->Add(nathanModel->meshes);
+		geometryBuffer->Build();
+	}
 
+	// Position only shaders for the depth pre-pass, one per path the meshes are drawn through
+	Shader depthShader("src/depth.vert", "src/depth.frag");
+	Shader* depthIndirectShader = nullptr;
+	if (geometryBuffer != nullptr) depthIndirectShader = new Shader("src/depthIndirect.vert", "src/depth.frag");
+
+	// Lights are sorted into clusters of the view each frame so every fragment only shades the few near it
+	ClusteredLights clusteredLights(std::max(2u, std::thread::hardware_concurrency() / 2));
+
+	// Every variant has its samplers pointed at their units once, when it is compiled
+	auto setUpVariant = [&clusteredLights](Shader& shader) {
+		shader.Activate();
+		// This tells the shader which texture units to use for each texture type
+		shader.SetInt("diffuse0", 0);
+		shader.SetInt("specular0", 1);
+		shader.SetInt("normal0", 2);
+		clusteredLights.Attach(shader);
+	};
+	defaultShaders.onCompile = setUpVariant;
+	if (indirectShaders != nullptr) indirectShaders->onCompile = setUpVariant;
+
+	// A driver that reports 4.3 but can't build the 4.30 shaders keeps drawing every mesh from its own vertex array
+	if (geometryBuffer != nullptr) {
+		if (indirectShaders->Get(0).Linked() && depthIndirectShader->Linked()) {
+			renderQueue.UseGeometryBuffer(geometryBuffer, &defaultShaders, indirectShaders);
+			LOG_INFO("Drawing through the shared geometry buffer");
+		}
+		else {
+			LOG_WARNING("Indirect shaders failed to build, drawing every mesh on its own");
+			indirectShaders->Delete();
+			delete indirectShaders;
+			indirectShaders = nullptr;
+			depthIndirectShader->Delete();
+			delete depthIndirectShader;
+			depthIndirectShader = nullptr;
+			geometryBuffer->Delete();
+			delete geometryBuffer;
+			geometryBuffer = nullptr;
+		}
+	}
 
 	// School model transformation
 	glm::mat4 schoolModelMatrix = glm::mat4(1.0f);
@@ -203,14 +367,59 @@ int main()
 	glm::vec3 scaleVec(2.0f, 2.0f, 2.0f);
 	schoolModelMatrix = glm::scale(schoolModelMatrix, scaleVec);
 
-	// Initialize Nathan's starting time
-	nathanLastTime = static_cast<float>(glfwGetTime());
-
 	// Compute world triangles for each mesh in the school model
 	for (auto& mesh : schoolModel->meshes) {
 		mesh.ComputeWorldTriangles(schoolModelMatrix);
 	}
 
+	// A dim warm light every few steps under the school's ceilings
+	if (schoolModel != nullptr) {
+		PointLight ceilingLight;
+		ceilingLight.radius = 6.0f;
+		ceilingLight.color = glm::vec3(1.0f, 0.9f, 0.75f);
+		ceilingLight.intensity = 0.6f;
+		clusteredLights.lights = ClusteredLights::CeilingLights(schoolModel->meshes, 2.5f, 4.0f, ceilingLight);
+		LOG_INFO("Placed %zu ceiling lights", clusteredLights.lights.size());
+	}
+
+	// Meshes of the school seen from each spot of the map, baked offline
+	PotentiallyVisibleSet schoolPVS;
+	if (bakePVS) {
+		if (schoolModel != nullptr) {
+			schoolPVS.Bake(schoolModel->meshes, std::thread::hardware_concurrency());
+			if (!schoolPVS.Save(pvsPath)) LOG_ERROR("Failed to write PVS: %s", pvsPath.c_str());
+		}
+		// Skips the main loop and cleans up
+		glfwSetWindowShouldClose(window, GLFW_TRUE);
+	}
+	else if (schoolModel != nullptr && schoolPVS.Load(pvsPath, schoolModel->meshes.size())) {
+		schoolModel->pvs = &schoolPVS;
+		LOG_INFO("School PVS loaded successfully! (%zu bytes)", schoolPVS.Bytes());
+	}
+
+	// The school's walls and floors hide most of the rooms from any point inside
+	OcclusionCuller occlusionCuller;
+	if (schoolModel != nullptr) occlusionCuller.AddOccluders(schoolModel->meshes, schoolModelMatrix, 4.0f, 20000);
+	renderQueue.occlusion = &occlusionCuller;
+
+	// Rooms and doorways of the school, rooms not seen through a doorway are skipped. The doorways
+	// are the openings the school's walls leave between the rooms
+	CellPortalGraph schoolCells;
+	std::vector<glm::vec3> schoolWalls;
+	if (schoolModel != nullptr) {
+		for (const auto& mesh : schoolModel->meshes) {
+			for (const auto& triangle : mesh.worldTriangles) {
+				schoolWalls.push_back(triangle.a);
+				schoolWalls.push_back(triangle.b);
+				schoolWalls.push_back(triangle.c);
+			}
+		}
+	}
+	if (schoolCells.Load("models/MapSchool.cells", schoolWalls)) {
+		renderQueue.cells = &schoolCells;
+		LOG_INFO("School cells loaded successfully!");
+	}
+
 	// Enables the Depth Buffer
 	glEnable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LESS);
@@ -228,119 +437,360 @@ int main()
 	// Creates camera object
 	Camera camera(width, height, glm::vec3(6.62f, 2.5f, 4.19f));
 
-	static bool prevF1 = false, prevF2 = false, prevF = false;;
+	static bool prevF1 = false, prevF2 = false, prevF = false, prevF3 = false, prevF4 = false, prevF5 = false, prevF6 = false, prevL = false;
+
+	// Lines added by any code during a frame, drawn together in one draw call
+	DebugDraw debugDraw;
 
-	Shader aabbShader("src/aabb.vert", "src/aabb.frag");
+	// The crowd walks anywhere along Nathan's corridor, drawn with one instanced draw per mesh
+	ShaderVariants instancedShaders("src/instanced.vert", "src/default.frag", DefaultFeatureNames(), DefaultDefines());
+	instancedShaders.onCompile = setUpVariant;
+
+	// Starts compiling every variant the meshes can be drawn with all at once at load time, the
+	// first frame's lighting first, so toggling the flashlight or the ceiling lights never compiles
+	// in the middle of a frame. Restored from the binary cache after the first run
+	std::vector<uint32_t> startVariants;
+	uint32_t startFeatures = (fleshlight ? (uint32_t)FEATURE_FLASHLIGHT : 0u) | (ceilingLights ? (uint32_t)FEATURE_CLUSTERED_LIGHTS : 0u);
+	for (uint32_t toggled : { 0u, (uint32_t)FEATURE_FLASHLIGHT, (uint32_t)FEATURE_CLUSTERED_LIGHTS, (uint32_t)(FEATURE_FLASHLIGHT | FEATURE_CLUSTERED_LIGHTS) }) {
+		for (uint32_t meshFeatures : { 0u, (uint32_t)FEATURE_HAS_SPECULAR, (uint32_t)FEATURE_YELLOW_ROOM, (uint32_t)(FEATURE_HAS_SPECULAR | FEATURE_YELLOW_ROOM) }) {
+			startVariants.push_back((startFeatures ^ toggled) | meshFeatures);
+		}
+	}
+	defaultShaders.Prepare(startVariants);
+	if (indirectShaders != nullptr) indirectShaders->Prepare(startVariants);
+	// The crowd is empty unless asked for
+	if (crowdSize > 0 || benchCrowd) instancedShaders.Prepare(startVariants);
+	Crowd crowd(AABB{ nathanStartPos - glm::vec3(0.0f, 0.0f, 1.5f), nathanEndPos + glm::vec3(0.0f, 0.0f, 1.5f) });
+	if (nathanModel != nullptr) {
+		crowd.Attach(nathanModel->meshes);
+		crowd.Resize(crowdSize);
+	}
+	CrowdBenchmark crowdBenchmark({ 100, 250, 500, 1000, 2000, 4000, 8000, 16000 });
+	if (benchCrowd) {
+		crowd.Resize(crowdBenchmark.Agents());
+		// Looks down the corridor at full resolution without vsync so the frame time is the real cost;
+		// drivers that force vsync anyway still pad it, so the crowd's GPU section is printed beside it
+		dynamicResolution = false;
+		camera.Position = glm::vec3(1.0f, 2.5f, -45.8f);
+		camera.Orientation = glm::vec3(1.0f, 0.0f, 0.0f);
+		camera.BeginStep();
+		glfwSwapInterval(0);
+	}
+	if (benchVertex && schoolModel != nullptr) {
+		camera.updateMatrix(fov, 0.1f, 50.0f);
+		frame.camMatrix = camera.cameraMatrix;
+		frame.camPos = camera.Position;
+		frameUBO.Update(&frame);
+		// Both sides shade the same way, only the normal matrix differs
+		uint32_t features = FEATURE_FLASHLIGHT | FEATURE_HAS_SPECULAR;
+		Shader inverseShader("src/default.vert", "src/default.frag", "#define NORMAL_MATRIX_IN_SHADER\n" + defaultShaders.Defines(features));
+		setUpVariant(inverseShader);
+		glfwSwapInterval(0);
+		RunVertexBenchmark(schoolModel->meshes, schoolModelMatrix, inverseShader, defaultShaders.Get(features));
+		inverseShader.Delete();
+		glfwSetWindowShouldClose(window, GLFW_TRUE);
+	}
+	HeadlessBenchmark headlessRun(headlessFrames, 60, imageDir);
+	headlessRun.context = headlessContext + ", " + (const char*)glGetString(GL_RENDERER);
+	CameraPath cameraPath = CameraPath::Default();
+	if ((headless || flythrough) && !cameraPathFile.empty() && !cameraPath.Load(cameraPathFile)) LOG_ERROR("Failed to load camera path: %s", cameraPathFile.c_str());
+	// Every frame's input, and the time the animation runs at, comes from here
+	InputSource inputSource;
+	if (recordInput && !inputSource.Record(inputPath)) LOG_ERROR("Failed to create input recording: %s", inputPath.c_str());
+	if (replayInput && !inputSource.Replay(inputPath)) {
+		LOG_ERROR("Failed to load input recording: %s", inputPath.c_str());
+		glfwSetWindowShouldClose(window, GLFW_TRUE);
+	}
+	// Scripted runs step the clock by frame count so every run draws the same frames
+	if (headless || flythrough) inputSource.fixedDeltaTime = 1.0f / 60.0f;
+	if (headless) {
+		// Full resolution in a render target that can be read back
+		dynamicResolution = false;
+		resolution.offscreen = true;
+		glfwSwapInterval(0);
+	}
+	// Moves the camera, Nathan and the crowd in fixed steps, drawn between the last two
+	FixedTimestep simulation(simulationRate);
+	// Cursor movement read by frames that ran no step, applied by the next step
+	float lookX = 0.0f, lookY = 0.0f;
+	double lastSwapTime = glfwGetTime();
 
 
 	// Main while loop
 	while (!glfwWindowShouldClose(window))
 	{
+		PROFILE_ZONE("Frame");
+
+		// Reads this frame's keys, cursor and time step from the window or the recording
+		InputFrame input = inputSource.Next(window, width, height);
+		if (inputSource.Finished()) {
+			LOG_INFO("Replayed %zu frames, %.3f s", inputSource.Frames() - 1, inputSource.Time());
+			glfwSetWindowShouldClose(window, GLFW_TRUE);
+			break;
+		}
 
 		// Get current time for animation
-		float currentTime = static_cast<float>(glfwGetTime());
-
-		// Update Nathan's position
-		updateNathanPosition(currentTime);
+		float currentTime = static_cast<float>(inputSource.Time());
+
+		// Runs as many simulation steps as the frame's time covers, none on a fast frame
+		lookX += input.cursorX;
+		lookY += input.cursorY;
+		int steps = simulation.Advance(input.deltaTime);
+		for (int step = 0; step < steps; step++) {
+			PROFILE_ZONE("Simulation step");
+			float stepTime = simulation.Step();
+			camera.BeginStep();
+			if (!headless && !flythrough && !benchCrowd) {
+				InputFrame stepInput = input;
+				stepInput.cursorX = lookX;
+				stepInput.cursorY = lookY;
+				camera.Inputs(stepInput, stepTime, schoolModel->meshes, schoolModelMatrix, enableCollision);
+			}
+			// Only the first step of the frame turns the camera
+			lookX = lookY = 0.0f;
+			// Update Nathan's position
+			updateNathanPosition(stepTime);
+			crowd.Update(stepTime);
+		}
+		// Scripted paths place the camera exactly where the frame's time puts it
+		if (headless) cameraPath.Apply(headlessRun.Progress(), camera);
+		else if (flythrough) {
+			cameraPath.Apply(currentTime / flythroughSeconds, camera);
+			if (currentTime >= flythroughSeconds) glfwSetWindowShouldClose(window, GLFW_TRUE);
+		}
+		if (headless || flythrough) camera.BeginStep();
+		// How far this frame is between the last two steps, everything moving is drawn that far along
+		float alpha = simulation.Alpha();
+
+		// Create Nathan's model matrix with updated position
+		glm::mat4 nathanModelMatrix = glm::mat4(1.0f);
+		nathanModelMatrix = glm::translate(nathanModelMatrix, glm::mix(nathanPreviousPos, nathanCurrentPos, alpha));
+		nathanModelMatrix = glm::scale(nathanModelMatrix, glm::vec3(0.0088f, 0.0088f, 0.0088f));
+
+		// Rotate Nathan to face the direction he's walking
+		if (nathanMovingToEnd) {
+			// Face walking direction (90 degrees)
+			nathanModelMatrix = glm::rotate(nathanModelMatrix, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		}
+		else {
+			// Face walking direction (270 degrees)
+			nathanModelMatrix = glm::rotate(nathanModelMatrix, glm::radians(270.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		}
 
+		// Binds the render target at the resolution the last frames' GPU time allows
+		gpuProfiler.BeginFrame();
+		resolution.enabled = dynamicResolution;
+		resolution.Begin();
 		// Specify the color of the background
 		glClearColor(0.07f, 0.13f, 0.17f, 1.0f);
 		// Clean the back buffer and depth buffer
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS)
+		if (input.Down(INPUT_FOV_UP))
 		{
-			fov += 0.5f; // Increase FOV
+			fov += 30.0f * input.deltaTime; // Increase FOV
 		}
-		if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS)
+		if (input.Down(INPUT_FOV_DOWN))
 		{
-			fov -= 0.5f; // Increase FOV
+			fov -= 30.0f * input.deltaTime; // Decrease FOV
 		}
-		// Handles camera inputs
-		camera.Inputs(window, schoolModel->meshes, schoolModelMatrix, enableCollision);
+		// The camera drawn this frame, between where the last two steps put it
+		Camera view = camera.Interpolated(alpha);
 		// Updates and exports the camera matrix to the Vertex Shader
-		camera.updateMatrix(fov, 0.1f, 50.0f);
+		view.updateMatrix(fov, 0.1f, 50.0f);
+		// Rasterizes the occluders on a worker while the finished uploads go to the GPU
+		occlusionCuller.Begin(view.cameraMatrix);
+		textureUploader.Update();
 
-		shaderProgram.Activate();
-		// Set spotlight position to camera position
-		glUniform3f(glGetUniformLocation(shaderProgram.ID, "lightPos"),
-					camera.Position.x, camera.Position.y, camera.Position.z);
-		// Set spotlight direction to camera forward vector
-		glUniform3f(glGetUniformLocation(shaderProgram.ID, "spotDirection"),
-					camera.Orientation.x, camera.Orientation.y, camera.Orientation.z);
-		// ---------------------------------------------------------------------
-		float timeValue = static_cast<float>(glfwGetTime());
-		glUniform1f(glGetUniformLocation(shaderProgram.ID, "time"), timeValue);
 		// Handle toggling of collision and AABB visibility
 
-		bool currF1 = glfwGetKey(window, GLFW_KEY_F1) == GLFW_PRESS;
-		bool currF2 = glfwGetKey(window, GLFW_KEY_F2) == GLFW_PRESS;
-		bool currF = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+		bool currF1 = input.Down(INPUT_COLLISION);
+		bool currF2 = input.Down(INPUT_AABBS);
+		bool currF = input.Down(INPUT_FLASHLIGHT);
 		if (currF1 && !prevF1) enableCollision = !enableCollision;
 		if (currF2 && !prevF2) showAABBs = !showAABBs;
+		bool currF3 = input.Down(INPUT_DEPTH_PREPASS);
+		bool currF4 = input.Down(INPUT_DYNAMIC_RESOLUTION);
+		bool currF5 = glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS;
+		bool currF6 = glfwGetKey(window, GLFW_KEY_F6) == GLFW_PRESS;
+		bool currL = input.Down(INPUT_CEILING_LIGHTS);
 		if (currF && !prevF) fleshlight = !fleshlight;
-		prevF1 = currF1; prevF2 = currF2; prevF = currF;
-		glUniform1i(glGetUniformLocation(shaderProgram.ID, "isOn"), fleshlight ? 1 : 0);
-
-		std::cout << camera.Position.x << " " << camera.Position.y << " " << camera.Position.z << std::endl;
-		// Draw the school model if it loaded successfully
-		if (schoolModel != nullptr) {
-			// Update model matrix for the school
-			glUniformMatrix4fv(glGetUniformLocation(shaderProgram.ID, "model"), 1, GL_FALSE, glm::value_ptr(schoolModelMatrix));
-
-			// Draw the school model using your existing Draw method
-			schoolModel->Draw(shaderProgram, camera);
-		}
-
-		// Draw the nathan model if it loaded successfully
-		if (nathanModel != nullptr) {
-			// Create Nathan's model matrix with updated position
-			glm::mat4 nathanModelMatrix = glm::mat4(1.0f);
-			nathanModelMatrix = glm::translate(nathanModelMatrix, nathanCurrentPos);
-			nathanModelMatrix = glm::scale(nathanModelMatrix, glm::vec3(0.0088f, 0.0088f, 0.0088f));
-
-			// Rotate Nathan to face the direction he's walking
-			if (nathanMovingToEnd) {
-				// Face walking direction (90 degrees)
-				nathanModelMatrix = glm::rotate(nathanModelMatrix, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		if (currF3 && !prevF3) depthPrePass = !depthPrePass;
+		if (currF4 && !prevF4) dynamicResolution = !dynamicResolution;
+		if (currF5 && !prevF5) std::cout << gpuProfiler.Report();
+		// Starts a CPU capture, or ends the running one and writes it out
+		if (currF6 && !prevF6) {
+			if (CpuProfiler::Capturing()) {
+				CpuProfiler::Stop();
+				if (!CpuProfiler::Export(tracePath)) LOG_ERROR("Failed to write trace: %s", tracePath.c_str());
 			}
 			else {
-				// Face walking direction (270 degrees)
-				nathanModelMatrix = glm::rotate(nathanModelMatrix, glm::radians(270.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+				CpuProfiler::Start();
 			}
+		}
+		if (currL && !prevL) ceilingLights = !ceilingLights;
+		prevF1 = currF1; prevF2 = currF2; prevF = currF; prevF3 = currF3; prevF4 = currF4; prevF5 = currF5; prevF6 = currF6; prevL = currL;
+		// Lighting every draw of this frame shades, each mesh adds what it needs on top
+		uint32_t frameFeatures = (fleshlight ? (uint32_t)FEATURE_FLASHLIGHT : 0u) | (ceilingLights ? (uint32_t)FEATURE_CLUSTERED_LIGHTS : 0u);
 
-			// Update model matrix for nathan
-			glUniformMatrix4fv(glGetUniformLocation(shaderProgram.ID, "model"), 1, GL_FALSE, glm::value_ptr(nathanModelMatrix));
+		// Writes the camera and lights for every draw of this frame in one upload
+		{
+			PROFILE_ZONE("Frame uniforms");
+			frame.camMatrix = view.cameraMatrix;
+			frame.camPos = view.Position;
+			// Set spotlight position to camera position
+			frame.lightPos = view.Position;
+			// Set spotlight direction to camera forward vector
+			frame.spotDirection = view.Orientation;
+			frame.time = currentTime;
+			frame.isOn = fleshlight ? 1 : 0;
+			clusteredLights.enabled = ceilingLights;
+			clusteredLights.Update(view, fov, 0.1f, 50.0f, resolution.Width(), resolution.Height(), frame);
+			frameUBO.Update(&frame);
+		}
 
-			// Draw the school model using your existing Draw method
-			nathanModel->Draw(shaderProgram, camera);
+		LOG_EVERY(0.5, LogLevel::Debug, "Camera at %.2f %.2f %.2f", view.Position.x, view.Position.y, view.Position.z);
+		schoolPVS.Update(view.Position);
+		// Picks up the variants the driver finished compiling since the last frame
+		defaultShaders.Poll();
+		if (indirectShaders != nullptr) indirectShaders->Poll();
+		instancedShaders.Poll();
+		renderQueue.UseDepthPrePass(depthPrePass ? &depthShader : nullptr, depthIndirectShader);
+		renderQueue.Begin(view);
+		// Queue the school model if it loaded successfully
+		if (schoolModel != nullptr) schoolModel->Submit(renderQueue, defaultShaders, frameFeatures, &schoolModelMatrix);
+		// Queue the nathan model if it loaded successfully
+		if (nathanModel != nullptr) nathanModel->Submit(renderQueue, defaultShaders, frameFeatures, &nathanModelMatrix);
+		// Streams in the mips of the meshes that survived culling and evicts the rest over budget
+		textureStreamer.Request(renderQueue, view, fov);
+		textureStreamer.Update();
+		// The school and Nathan are sorted into the same draws, so they are timed together
+		gpuProfiler.Begin("Scene");
+		renderQueue.Flush();
+		gpuProfiler.End();
+		if (nathanModel != nullptr) {
+			GpuProfiler::Scope crowdScope(gpuProfiler, "Crowd");
+			crowd.Upload(renderQueue, alpha);
+			crowd.Draw(nathanModel->meshes, instancedShaders, frameFeatures, renderQueue.state);
+		}
+
+		if (glfwGetTime() - statsTime >= 1.0)
+		{
+			const GLStateCache::Counters& stats = renderQueue.lastFrame;
+			std::string title = "main | draws " + std::to_string(stats.draws)
+				+ " | culled " + std::to_string(renderQueue.culled)
+				+ " | pvs " + std::to_string(renderQueue.pvsCulled)
+				+ " | behind doors " + std::to_string(renderQueue.portalCulled)
+				+ " | occluded " + std::to_string(renderQueue.occluded)
+				+ " | lights " + std::to_string(clusteredLights.Assigned())
+				+ " | crowd " + std::to_string(crowd.Visible()) + "/" + std::to_string(crowd.Size())
+				+ " | sim " + std::to_string((int)(simulation.Rate() + 0.5f)) + " Hz"
+				+ " | GL calls " + std::to_string(stats.Total())
+				+ " | skipped " + std::to_string(stats.skipped)
+				+ " | res " + std::to_string((int)(resolution.Scale() * 100.0f + 0.5f)) + "%"
+				+ " | GPU " + std::to_string(resolution.GpuMilliseconds()).substr(0, 4) + " ms"
+				+ " | shader variants " + std::to_string(defaultShaders.Size())
+				+ (renderQueue.DepthPrePass() ? " | depth pre-pass" : "");
+			glfwSetWindowTitle(window, title.c_str());
+			statsTime = glfwGetTime();
 		}
 
 		if (showAABBs) {
-			for (auto& mesh : schoolModel->meshes) {
-				mesh.DrawAABB(schoolModelMatrix, aabbShader, camera);
+			if (schoolModel != nullptr) {
+				for (auto& mesh : schoolModel->meshes) {
+					mesh.DrawAABB(schoolModelMatrix, debugDraw);
+				}
 			}
+			// Where the walls last stopped the camera, and the paths Nathan and the crowd walk
+			if (camera.contact) debugDraw.Cross(camera.contactPoint, 0.3f, DebugDraw::Yellow);
+			debugDraw.Line(nathanStartPos, nathanEndPos, DebugDraw::Green);
+			crowd.DrawPaths(debugDraw, DebugDraw::Cyan);
 		}
+		{
+			GpuProfiler::Scope debugScope(gpuProfiler, "Debug lines");
+			debugDraw.Flush(renderQueue.state);
+		}
+
+		// Upscales the frame to the window
+		gpuProfiler.Begin("Upscale");
+		resolution.End();
+		gpuProfiler.End();
+		gpuProfiler.EndFrame();
 
 		// Swap the back buffer with the front buffer
-		glfwSwapBuffers(window);
+		{
+			PROFILE_ZONE("glfwSwapBuffers");
+			glfwSwapBuffers(window);
+		}
+
+		if (benchCrowd) {
+			double swapTime = glfwGetTime();
+			if (crowdBenchmark.Frame(swapTime - lastSwapTime, gpuProfiler.Milliseconds("Crowd"))) {
+				if (crowdBenchmark.Done()) {
+					crowdBenchmark.Print();
+					glfwSetWindowShouldClose(window, GLFW_TRUE);
+				}
+				else {
+					crowd.Resize(crowdBenchmark.Agents());
+				}
+			}
+			lastSwapTime = swapTime;
+		}
+		if (headless) {
+			// Waits for the software rasterizer so the frame time covers the whole frame
+			glFinish();
+			headlessRun.Frame(glfwGetTime() - lastSwapTime, resolution, renderQueue.portalCulled);
+			if (headlessRun.Done()) glfwSetWindowShouldClose(window, GLFW_TRUE);
+			lastSwapTime = glfwGetTime();
+		}
 		// Take care of all GLFW events
 		glfwPollEvents();
 	}
 
 
 
+	LOG_INFO("Shader programs: %u restored from the binary cache, %u compiled", Shader::cachedPrograms, Shader::compiledPrograms);
+	if (headless) headlessRun.Print();
+	inputSource.Close();
+	if (profileGPU || headless) std::cout << gpuProfiler.Report();
+	if (CpuProfiler::Capturing()) {
+		CpuProfiler::Stop();
+		if (!CpuProfiler::Export(tracePath)) LOG_ERROR("Failed to write trace: %s", tracePath.c_str());
+	}
+
 	// Delete all the objects we've created
-	shaderProgram.Delete();
-	aabbShader.Delete();
+	defaultShaders.Delete();
+	debugDraw.Delete();
+	instancedShaders.Delete();
+	crowd.Delete();
+	clusteredLights.Delete();
+	resolution.Delete();
+	gpuProfiler.Delete();
+	textureUploader.Delete();
+	frameUBO.Delete();
+	if (geometryBuffer != nullptr) {
+		geometryBuffer->Delete();
+		delete geometryBuffer;
+	}
+	if (indirectShaders != nullptr) {
+		indirectShaders->Delete();
+		delete indirectShaders;
+	}
+	depthShader.Delete();
+	if (depthIndirectShader != nullptr) {
+		depthIndirectShader->Delete();
+		delete depthIndirectShader;
+	}
 
 	// Delete the school model
 	if (schoolModel != nullptr) {
+		schoolModel->Delete();
 		delete schoolModel;
 	}
 
 	// Delete nathan model
 	if (nathanModel != nullptr) {
+		nathanModel->Delete();
 		delete nathanModel;
 	}
 
@@ -348,5 +798,7 @@ int main()
 	glfwDestroyWindow(window);
 	// Terminate GLFW before ending the program
 	glfwTerminate();
+	if (Logger::Dropped() > 0) std::cerr << Logger::Dropped() << " log messages were dropped" << std::endl;
+	Logger::Shutdown();
 	return 0;
 }
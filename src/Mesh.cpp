@@ -1,19 +1,50 @@
 #include "Mesh.h"
-#include "Camera.h"
+#include "CpuProfiler.h"
+#include "DebugDraw.h"
+#include "shaderClass.h"
 #include <vector>
+#include <algorithm>
+#include <map>
 #include <glm/gtc/type_ptr.hpp>
 
+// Gives every distinct set of textures its own small ID so draws can be sorted by material
+static unsigned int materialIDFor(const std::vector<Texture>& textures) {
+    static std::map<std::vector<GLuint>, unsigned int> materials;
+    std::vector<GLuint> ids;
+    for (const auto& texture : textures) ids.push_back(texture.ID);
+    auto it = materials.find(ids);
+    if (it == materials.end()) it = materials.emplace(ids, (unsigned int)materials.size()).first;
+    return it->second;
+}
+
 Mesh::Mesh(std::vector<Vertex>& vertices, std::vector<GLuint>& indices, std::vector<Texture>& textures)
     : vertices(vertices), indices(indices), textures(textures)
 {
     // Compute local AABB
     glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+    glm::vec2 uvMin(FLT_MAX), uvMax(-FLT_MAX);
     for (const auto& v : vertices) {
         min = glm::min(min, v.position);
         max = glm::max(max, v.position);
+        uvMin = glm::min(uvMin, v.texUV);
+        uvMax = glm::max(uvMax, v.texUV);
     }
     localAABB = { min, max };
+    uvExtent = std::max(std::max(uvMax.x - uvMin.x, uvMax.y - uvMin.y), 1.0f / 64.0f);
+    materialID = materialIDFor(textures);
+
+    // Builds the sampler names once instead of on every draw
+    unsigned int numDiffuse = 0;
+    unsigned int numSpecular = 0;
+    for (const auto& texture : textures) {
+        std::string type = texture.type;
+        std::string num;
+        if (type == "diffuse") num = std::to_string(numDiffuse++);
+        else if (type == "specular") num = std::to_string(numSpecular++);
+        samplerNames.push_back(type + num);
+    }
 
+    PROFILE_ZONE("Mesh upload");
     VAO.Bind();
     VBO VBO(vertices);
     EBO EBO(indices);
@@ -22,8 +53,30 @@ Mesh::Mesh(std::vector<Vertex>& vertices, std::vector<GLuint>& indices, std::vec
     VAO.LinkAttrib(VBO, 2, 3, GL_FLOAT, sizeof(Vertex), (void*)(6 * sizeof(float)));
     VAO.LinkAttrib(VBO, 3, 2, GL_FLOAT, sizeof(Vertex), (void*)(9 * sizeof(float)));
     VAO.Unbind();
-    VBO.Unbind();
+
+    // The depth pre-pass reads a third of the bytes per vertex from its own stream
+    std::vector<glm::vec3> positions;
+    positions.reserve(vertices.size());
+    for (const auto& v : vertices) positions.push_back(v.position);
+    depthVAO.Bind();
+    ::VBO positionVBO(positions);
+    EBO.Bind();
+    depthVAO.LinkAttrib(positionVBO, 0, 3, GL_FLOAT, sizeof(glm::vec3), (void*)0);
+    depthVAO.Unbind();
+    positionVBO.Unbind();
     EBO.Unbind();
+    vertexBuffer = VBO.ID;
+    positionBuffer = positionVBO.ID;
+    indexBuffer = EBO.ID;
+}
+
+// Deletes the vertex arrays and their buffers
+void Mesh::Delete() {
+    VAO.Delete();
+    depthVAO.Delete();
+    GLuint buffers[] = { vertexBuffer, positionBuffer, indexBuffer };
+    glDeleteBuffers(3, buffers);
+    vertexBuffer = positionBuffer = indexBuffer = 0;
 }
 
 void Mesh::ComputeWorldTriangles(const glm::mat4& modelMatrix) {
@@ -38,70 +91,34 @@ void Mesh::ComputeWorldTriangles(const glm::mat4& modelMatrix) {
     }
 }
 
-void Mesh::Draw(Shader& shader, Camera& camera) {
-    shader.Activate();
-    VAO.Bind();
-
-    // Keep track of how many of each type of textures we have
-    unsigned int numDiffuse = 0;
-    unsigned int numSpecular = 0;
-
-    for (unsigned int i = 0; i < textures.size(); i++)
-    {
-        std::string num;
-        std::string type = textures[i].type;
-        if (type == "diffuse")
-        {
-            num = std::to_string(numDiffuse++);
-        }
-        else if (type == "specular")
-        {
-            num = std::to_string(numSpecular++);
-        }
-        textures[i].texUnit(shader, (type + num).c_str(), i);
-        textures[i].Bind();
-    }
-    // Take care of the camera Matrix
-    glUniform3f(glGetUniformLocation(shader.ID, "camPos"), camera.Position.x, camera.Position.y, camera.Position.z);
-    camera.Matrix(shader, "camMatrix");
+void Mesh::Draw(Shader& shader, GLStateCache& state) {
+    state.UseProgram(shader.ID);
+    state.BindVertexArray(VAO.ID);
+    BindTextures(shader, state);
+    // The camera comes from the FrameData uniform buffer, written once per frame
 
     // Draw the actual mesh
     glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+    state.Draw();
 }
 
-// Draws the AABB as lines (wireframe box)
-void Mesh::DrawAABB(const glm::mat4& modelMatrix, Shader& aabbShader, Camera& camera) {
-    glm::vec3 min = localAABB.min;
-    glm::vec3 max = localAABB.max;
-    glm::vec3 corners[8] = {
-        {min.x, min.y, min.z}, {max.x, min.y, min.z},
-        {max.x, max.y, min.z}, {min.x, max.y, min.z},
-        {min.x, min.y, max.z}, {max.x, min.y, max.z},
-        {max.x, max.y, max.z}, {min.x, max.y, max.z}
-    };
-    GLuint indices[24] = {
-        0,1, 1,2, 2,3, 3,0, // bottom
-        4,5, 5,6, 6,7, 7,4, // top
-        0,4, 1,5, 2,6, 3,7  // sides
-    };
-    GLuint VAO, VBO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+// Draws the positions only, the depth shader and its model matrix must be set
+void Mesh::DrawDepth(GLStateCache& state) {
+    state.BindVertexArray(depthVAO.ID);
+    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+    state.Draw();
+}
 
-    aabbShader.Activate();
-    glUniformMatrix4fv(glGetUniformLocation(aabbShader.ID, "model"), 1, GL_FALSE, glm::value_ptr(modelMatrix));
-    camera.Matrix(aabbShader, "camMatrix");
-    glDrawElements(GL_LINES, 24, GL_UNSIGNED_INT, 0);
+void Mesh::BindTextures(Shader& shader, GLStateCache& state) {
+    // Texture i goes on unit i, which is what its sampler is pointed at
+    for (unsigned int i = 0; i < textures.size(); i++)
+    {
+        shader.SetInt(samplerNames[i], i);
+        state.BindTexture(i, textures[i].ID);
+    }
+}
 
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-    glDeleteVertexArrays(1, &VAO);
+// Adds the AABB as lines (wireframe box) to the frame's debug lines
+void Mesh::DrawAABB(const glm::mat4& modelMatrix, DebugDraw& debug, uint32_t color) const {
+    debug.Box(localAABB, modelMatrix, color);
 }
\ No newline at end of file
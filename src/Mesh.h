@@ -3,13 +3,15 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
 #include <glm/glm.hpp>
 #include "VAO.h"
 #include "EBO.h"
 #include "Texture.h"
 #include "AABB.h"
+#include "GLStateCache.h"
+#include "DebugDraw.h"
 
-class Camera;
 class Shader;
 
 class Mesh {
@@ -22,13 +24,27 @@ public:
     std::vector<GLuint> indices;
     std::vector<Texture> textures;
     VAO VAO;
+    ::VAO depthVAO; // Tightly packed positions only, for the depth pre-pass
+    GLuint vertexBuffer = 0; // Buffers the two vertex arrays read, kept for Delete
+    GLuint positionBuffer = 0;
+    GLuint indexBuffer = 0;
     AABB localAABB; // Always in model (local) space
+    float uvExtent; // Largest span of the texture coordinates, in texture repeats
+    unsigned int materialID; // Same for every mesh with the same textures
+    std::vector<std::string> samplerNames; // Sampler uniform of each texture, e.g. diffuse0
 
     Mesh(std::vector<Vertex>& vertices, std::vector<GLuint>& indices, std::vector<Texture>& textures);
 
-    void Draw(Shader& shader, Camera& camera);
-    void DrawAABB(const glm::mat4& modelMatrix, Shader& aabbShader, Camera& camera);
+    void Draw(Shader& shader, GLStateCache& state);
+    // Draws the positions only, the depth shader and its model matrix must be set
+    void DrawDepth(GLStateCache& state);
+    // Binds texture i to unit i and points its sampler there
+    void BindTextures(Shader& shader, GLStateCache& state);
+    // Adds the AABB as a wireframe box to the frame's debug lines
+    void DrawAABB(const glm::mat4& modelMatrix, DebugDraw& debug, uint32_t color = DebugDraw::Red) const;
     void ComputeWorldTriangles(const glm::mat4& modelMatrix);
+    // Deletes the vertex arrays and their buffers
+    void Delete();
 };
 
 #endif
\ No newline at end of file
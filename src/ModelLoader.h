@@ -15,16 +15,30 @@
 #include "Mesh.h"
 #include "Texture.h"
 #include "AABB.h"
+#include "TextureStreamer.h"
+#include "TextureUploader.h"
+#include "RenderQueue.h"
+#include "Frustum.h"
+#include "OcclusionCuller.h"
+#include "CellPortalGraph.h"
+#include "PotentiallyVisibleSet.h"
+#include "ShaderVariants.h"
+#include "CpuProfiler.h"
+#include "Logger.h"
 
 class Model {
 public:
     std::vector<Mesh> meshes;
     std::string directory;
     std::unordered_map<std::string, Texture> loadedTextures; // Cache for loaded textures
+    TextureStreamer* streamer = nullptr; // Streams the textures' mips when set
+    TextureUploader* uploader = nullptr; // Uploads the textures off the GL thread when set and not streaming
+    PotentiallyVisibleSet* pvs = nullptr; // Baked visibility of the meshes, updated with the camera by the owner
 
     // Optionally, store wall AABBs for easy collision
-    Model(const std::string& path) {
-        std::cout << "Loading model: " << path << std::endl;
+    Model(const std::string& path, TextureStreamer* streamer = nullptr, TextureUploader* uploader = nullptr)
+        : streamer(streamer), uploader(uploader) {
+        LOG_INFO("Loading model: %s", path.c_str());
         loadModel(path);
     }
 
@@ -36,22 +50,95 @@ public:
     Model(Model&&) = default;
     Model& operator=(Model&&) = default;
 
-    void Draw(Shader& shader, Camera& camera) {
-        for (auto& mesh : meshes) {
-            mesh.Draw(shader, camera);
+    // Deletes the vertex arrays and buffers of every mesh
+    void Delete() {
+        for (auto& mesh : meshes) mesh.Delete();
+    }
+
+    // Queues every mesh inside the queue's frustum, in the visible set, seen through the portals and not occluded,
+    // the model matrix must stay alive until the queue is flushed
+    void Submit(RenderQueue& queue, Shader& shader, const glm::mat4* modelMatrix) {
+        submit(queue, modelMatrix, [&](size_t) -> Shader& { return shader; });
+    }
+
+    // Same, drawing each mesh with the variant that has the frame's features and the ones the mesh needs
+    void Submit(RenderQueue& queue, ShaderVariants& variants, uint32_t frameFeatures, const glm::mat4* modelMatrix) {
+        PROFILE_ZONE("Model::Submit");
+        const AABBList& bounds = WorldBounds(*modelMatrix);
+        if (meshFeatures.size() != meshes.size()) {
+            for (size_t i = 0; i < meshes.size(); i++) meshFeatures.push_back(MeshFeatures(meshes[i], bounds.Get(i)));
         }
+        submit(queue, modelMatrix, [&](size_t i) -> Shader& { return variants.Get(frameFeatures | meshFeatures[i]); });
+    }
+
+    // World space AABBs of the meshes, only recomputed when the model matrix changes
+    const AABBList& WorldBounds(const glm::mat4& modelMatrix) {
+        if (!boundsValid || modelMatrix != boundsMatrix || worldBounds.count != meshes.size()) {
+            worldBounds.Clear();
+            cellMasks.clear();
+            meshFeatures.clear();
+            for (const auto& mesh : meshes) worldBounds.Add(transformAABB(mesh.localAABB, modelMatrix));
+            boundsMatrix = modelMatrix;
+            boundsValid = true;
+        }
+        return worldBounds;
     }
 
 private:
+    AABBList worldBounds;
+    glm::mat4 boundsMatrix = glm::mat4(1.0f);
+    bool boundsValid = false;
+    std::vector<uint8_t> visible;
+    // Cells each mesh overlaps, rebuilt with the bounds or when the cells change
+    std::vector<uint64_t> cellMasks;
+    const CellPortalGraph* cellsGraph = nullptr;
+    unsigned int cellsVersion = 0;
+    // Shader features each mesh needs where it is, rebuilt with the bounds
+    std::vector<uint32_t> meshFeatures;
+
+    // Queues the meshes that pass every test with the shader shaderFor picks for each
+    template<typename ShaderFor>
+    void submit(RenderQueue& queue, const glm::mat4* modelMatrix, ShaderFor shaderFor) {
+        const AABBList& bounds = WorldBounds(*modelMatrix);
+        size_t inside = queue.frustum.Cull(bounds, visible);
+        queue.culled += (unsigned int)(meshes.size() - inside);
+        if (queue.cells != nullptr && (queue.cells != cellsGraph || queue.cells->Version() != cellsVersion || cellMasks.size() != meshes.size())) {
+            queue.cells->Assign(bounds, cellMasks);
+            cellsGraph = queue.cells;
+            cellsVersion = queue.cells->Version();
+        }
+        for (size_t i = 0; i < meshes.size(); i++) {
+            if (!visible[i]) continue;
+            if (pvs != nullptr && !pvs->Visible(i)) {
+                queue.pvsCulled++;
+                continue;
+            }
+            if (queue.cells != nullptr && !queue.cells->Visible(cellMasks[i], bounds.Get(i))) {
+                queue.portalCulled++;
+                continue;
+            }
+            if (queue.occlusion != nullptr && !queue.occlusion->Visible(bounds.Get(i))) {
+                queue.occluded++;
+                continue;
+            }
+            queue.Submit(meshes[i], shaderFor(i), modelMatrix);
+        }
+    }
+
     void loadModel(const std::string& path) {
+        PROFILE_ZONE("Model::loadModel");
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path,
-            aiProcess_Triangulate |
-            aiProcess_GenSmoothNormals |
-            aiProcess_CalcTangentSpace);
+        const aiScene* scene = nullptr;
+        {
+            PROFILE_ZONE("Assimp parse");
+            scene = importer.ReadFile(path,
+                aiProcess_Triangulate |
+                aiProcess_GenSmoothNormals |
+                aiProcess_CalcTangentSpace);
+        }
 
         if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-            std::cerr << "Assimp error: " << importer.GetErrorString() << std::endl;
+            LOG_ERROR("Assimp error: %s", importer.GetErrorString());
             return;
         }
 
@@ -62,15 +149,15 @@ private:
             directory += "/";
         }
 
-        std::cout << "Model directory: " << directory << std::endl;
-        std::cout << "Model has " << scene->mNumMeshes << " meshes" << std::endl;
+        LOG_INFO("Model directory: %s", directory.c_str());
+        LOG_INFO("Model has %u meshes", scene->mNumMeshes);
 
         meshes.reserve(scene->mNumMeshes);
 
         // Recursively process all nodes
         processNode(scene->mRootNode, scene);
-        std::cout << "Successfully loaded " << meshes.size() << " meshes" << std::endl;
-        std::cout << "Loaded " << loadedTextures.size() << " unique textures" << std::endl;
+        LOG_INFO("Successfully loaded %zu meshes", meshes.size());
+        LOG_INFO("Loaded %zu unique textures", loadedTextures.size());
     }
 
     void processNode(aiNode* node, const aiScene* scene) {
@@ -86,8 +173,9 @@ private:
     }
 
     void loadMesh(const aiMesh* aiMesh, const aiScene* scene, const std::string& meshName) {
+        PROFILE_ZONE("Model::loadMesh");
         if (!aiMesh || aiMesh->mNumVertices == 0) {
-            std::cout << "  Warning: Invalid or empty mesh!" << std::endl;
+            LOG_WARNING("Invalid or empty mesh: %s", meshName.c_str());
             return;
         }
 
@@ -149,7 +237,7 @@ private:
         }
 
         if (indices.empty()) {
-            std::cout << "  Warning: Mesh has no valid triangular faces!" << std::endl;
+            LOG_WARNING("Mesh has no valid triangular faces: %s", meshName.c_str());
             return;
         }
 
@@ -209,7 +297,10 @@ private:
             std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
             if (extension == ".jpg" || extension == ".jpeg") format = GL_RGB;
 
-            Texture texture(fullPath.c_str(), typeName.c_str(), i, format, pixelType);
+            Texture texture;
+            if (streamer != nullptr) texture = streamer->Load(fullPath.c_str(), typeName.c_str(), i, format);
+            else if (uploader != nullptr) texture = uploader->Load(fullPath.c_str(), typeName.c_str(), i, format);
+            else texture = Texture(fullPath.c_str(), typeName.c_str(), i, format, pixelType);
             textures.push_back(texture);
             loadedTextures[fullPath] = texture;
         }
@@ -0,0 +1,299 @@
+#include"OcclusionCuller.h"
+#include<algorithm>
+#include<array>
+#include<cfloat>
+#include<cmath>
+#include<map>
+#include<memory>
+#include<tuple>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include<emmintrin.h>
+#define OCCLUSION_USE_SSE2
+#endif
+
+// Constructor with the size of the depth buffer, the width is rounded up to a multiple of four
+OcclusionCuller::OcclusionCuller(int width, int height)
+	: width((std::max(width, 4) + 3) & ~3), height(std::max(height, 1)), worker(1)
+{
+	depth.assign((size_t)this->width * this->height, 1.0f);
+}
+
+// Waits for the rasterization in flight
+OcclusionCuller::~OcclusionCuller()
+{
+	wait();
+}
+
+// Adds world space triangles, three vertices each, to the occluders
+void OcclusionCuller::AddTriangles(const std::vector<glm::vec3>& triangles)
+{
+	wait();
+	occluders.insert(occluders.end(), triangles.begin(), triangles.end() - triangles.size() % 3);
+	findOutlines();
+}
+
+// Adds the meshes whose box has a face of at least minArea, largest first, until maxTriangles is reached
+void OcclusionCuller::AddOccluders(const std::vector<Mesh>& meshes, const glm::mat4& modelMatrix, float minArea, size_t maxTriangles)
+{
+	// Walls and floors have one large face and are cheap to draw compared to what they hide
+	std::vector<std::pair<float, const Mesh*>> candidates;
+	for (const auto& mesh : meshes)
+	{
+		AABB box = transformAABB(mesh.localAABB, modelMatrix);
+		glm::vec3 size = box.max - box.min;
+		float area = std::max(std::max(size.x * size.y, size.y * size.z), size.x * size.z);
+		if (area >= minArea) candidates.push_back({ area, &mesh });
+	}
+	std::sort(candidates.begin(), candidates.end(),
+		[](const std::pair<float, const Mesh*>& a, const std::pair<float, const Mesh*>& b) { return a.first > b.first; });
+
+	std::vector<glm::vec3> triangles;
+	for (const auto& candidate : candidates)
+	{
+		const Mesh& mesh = *candidate.second;
+		size_t count = mesh.indices.size() / 3;
+		if (Triangles() + triangles.size() / 3 + count > maxTriangles) continue;
+		for (size_t i = 0; i < count * 3; i++)
+		{
+			triangles.push_back(glm::vec3(modelMatrix * glm::vec4(mesh.vertices[mesh.indices[i]].position, 1.0f)));
+		}
+	}
+	AddTriangles(triangles);
+}
+
+// Removes every occluder
+void OcclusionCuller::ClearOccluders()
+{
+	wait();
+	occluders.clear();
+	outlines.clear();
+}
+
+// Starts rasterizing the occluders as seen by a projection * view matrix on the worker
+void OcclusionCuller::Begin(const glm::mat4& viewProjection)
+{
+	wait();
+	this->viewProjection = viewProjection;
+	auto task = std::make_shared<std::packaged_task<void()>>([this]() { rasterize(); });
+	pending = task->get_future();
+	worker.Submit([task]() { (*task)(); });
+}
+
+// Whether any part of a world space box may be in front of the occluders
+bool OcclusionCuller::Visible(const AABB& box)
+{
+	wait();
+
+	glm::vec2 screenMin(FLT_MAX), screenMax(-FLT_MAX);
+	float nearest = FLT_MAX;
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec3 corner((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z);
+		glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+		// Boxes reaching the near plane surround the camera and can't be hidden
+		if (clip.z < -clip.w || clip.w <= 1e-5f) return true;
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		screenMin = glm::min(screenMin, glm::vec2(ndc));
+		screenMax = glm::max(screenMax, glm::vec2(ndc));
+		nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+	}
+
+	// Every pixel the box's screen rectangle touches, off screen parts are left to frustum culling.
+	// The box is hidden only if its nearest point is behind the farthest occluder depth over all of them
+	int x0 = std::max(0, (int)std::floor((screenMin.x * 0.5f + 0.5f) * width));
+	int x1 = std::min(width - 1, (int)std::floor((screenMax.x * 0.5f + 0.5f) * width));
+	int y0 = std::max(0, (int)std::floor((screenMin.y * 0.5f + 0.5f) * height));
+	int y1 = std::min(height - 1, (int)std::floor((screenMax.y * 0.5f + 0.5f) * height));
+	if (x0 > x1 || y0 > y1) return true;
+
+	for (int y = y0; y <= y1; y++)
+	{
+		const float* row = depth.data() + (size_t)y * width;
+		for (int x = x0; x <= x1; x++)
+		{
+			if (row[x] >= nearest) return true;
+		}
+	}
+	return false;
+}
+
+// Depth buffer of the last Begin from 0 (near) to 1 (far)
+const std::vector<float>& OcclusionCuller::Depth()
+{
+	wait();
+	return depth;
+}
+
+// Waits for the rasterization in flight
+void OcclusionCuller::wait()
+{
+	if (pending.valid()) pending.get();
+}
+
+// Finds the edges of the occluders not shared by two triangles
+void OcclusionCuller::findOutlines()
+{
+	// Edges by their two ends in a fixed order, counted over every triangle
+	auto key = [](const glm::vec3& a, const glm::vec3& b)
+	{
+		bool swap = std::tie(b.x, b.y, b.z) < std::tie(a.x, a.y, a.z);
+		const glm::vec3& first = swap ? b : a;
+		const glm::vec3& second = swap ? a : b;
+		return std::array<float, 6>{ first.x, first.y, first.z, second.x, second.y, second.z };
+	};
+	std::map<std::array<float, 6>, int> edges;
+	for (size_t i = 0; i + 2 < occluders.size(); i += 3)
+	{
+		for (int v = 0; v < 3; v++) edges[key(occluders[i + v], occluders[i + (v + 1) % 3])]++;
+	}
+	outlines.assign(occluders.size() / 3, 0);
+	for (size_t i = 0; i + 2 < occluders.size(); i += 3)
+	{
+		for (int v = 0; v < 3; v++)
+		{
+			if (edges[key(occluders[i + v], occluders[i + (v + 1) % 3])] < 2) outlines[i / 3] |= (uint8_t)(1 << v);
+		}
+	}
+}
+
+// Clears the depth buffer and draws every occluder
+void OcclusionCuller::rasterize()
+{
+	std::fill(depth.begin(), depth.end(), 1.0f);
+
+	for (size_t i = 0; i + 2 < occluders.size(); i += 3)
+	{
+		glm::vec4 in[3] = {
+			viewProjection * glm::vec4(occluders[i], 1.0f),
+			viewProjection * glm::vec4(occluders[i + 1], 1.0f),
+			viewProjection * glm::vec4(occluders[i + 2], 1.0f)
+		};
+
+		// Clips against the near plane, z >= -w, which leaves at most four vertices, each with
+		// whether the edge to the next one is on the outline; the cut along the near plane is
+		uint8_t outline = outlines[i / 3];
+		glm::vec4 out[4];
+		bool outEdge[4];
+		int count = 0;
+		for (int v = 0; v < 3; v++)
+		{
+			const glm::vec4& a = in[v];
+			const glm::vec4& b = in[(v + 1) % 3];
+			bool edge = (outline >> v) & 1;
+			float da = a.z + a.w;
+			float db = b.z + b.w;
+			if (da >= 0.0f)
+			{
+				outEdge[count] = edge;
+				out[count++] = a;
+			}
+			if ((da >= 0.0f) != (db >= 0.0f))
+			{
+				outEdge[count] = da >= 0.0f ? true : edge;
+				out[count++] = a + (b - a) * (da / (da - db));
+			}
+		}
+		// The edges between the triangles of the fan are inside the polygon
+		for (int v = 1; v + 1 < count; v++)
+		{
+			bool first = v == 1 && outEdge[0];
+			bool last = v + 2 == count && outEdge[count - 1];
+			drawTriangle(out[0], out[v], out[v + 1], (uint8_t)(first | (outEdge[v] << 1) | (last << 2)));
+		}
+	}
+}
+
+// Draws a triangle already clipped to the near plane
+void OcclusionCuller::drawTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, uint8_t outline)
+{
+	if (a.w <= 1e-5f || b.w <= 1e-5f || c.w <= 1e-5f) return;
+
+	// Screen space positions with the depth mapped to 0..1
+	glm::vec3 p[3];
+	const glm::vec4* clip[3] = { &a, &b, &c };
+	for (int i = 0; i < 3; i++)
+	{
+		glm::vec3 ndc = glm::vec3(*clip[i]) / clip[i]->w;
+		p[i] = glm::vec3((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z * 0.5f + 0.5f);
+	}
+
+	// Occluders are drawn from both sides, so the winding is made counter clockwise
+	float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[1].y - p[0].y) * (p[2].x - p[0].x);
+	if (std::fabs(area) < 1e-8f) return;
+	// Whether the edge opposite each vertex is on the outline
+	bool shrink[3] = { (outline & 2) != 0, (outline & 4) != 0, (outline & 1) != 0 };
+	if (area < 0.0f)
+	{
+		std::swap(p[1], p[2]);
+		std::swap(shrink[1], shrink[2]);
+		area = -area;
+	}
+
+	int minX = std::max(0, (int)std::floor(std::min(std::min(p[0].x, p[1].x), p[2].x)));
+	int maxX = std::min(width - 1, (int)std::ceil(std::max(std::max(p[0].x, p[1].x), p[2].x)));
+	int minY = std::max(0, (int)std::floor(std::min(std::min(p[0].y, p[1].y), p[2].y)));
+	int maxY = std::min(height - 1, (int)std::ceil(std::max(std::max(p[0].y, p[1].y), p[2].y)));
+	if (minX > maxX || minY > maxY) return;
+
+	// Each edge function is A * x + B * y + C, positive inside; edge i is opposite vertex i
+	float A[3], B[3], C[3];
+	for (int i = 0; i < 3; i++)
+	{
+		const glm::vec3& from = p[(i + 1) % 3];
+		const glm::vec3& to = p[(i + 2) % 3];
+		A[i] = from.y - to.y;
+		B[i] = to.x - from.x;
+		C[i] = -A[i] * from.x - B[i] * from.y;
+	}
+	// The depth is a plane in screen space, weighted by the edge opposite each vertex
+	float zA = (p[0].z * A[0] + p[1].z * A[1] + p[2].z * A[2]) / area;
+	float zB = (p[0].z * B[0] + p[1].z * B[1] + p[2].z * B[2]) / area;
+	float zC = (p[0].z * C[0] + p[1].z * C[1] + p[2].z * C[2]) / area;
+
+	// Conservative: a pixel is only written when the occluder covers all of it, tested at the
+	// corner where each outline edge function is lowest, and gets the farthest depth the triangle
+	// has over it, so nothing seen through part of a pixel or in front of the plane there is
+	// hidden. Edges shared with another triangle are tested at the pixel center as the
+	// neighbour covers the rest of those pixels.
+	for (int i = 0; i < 3; i++)
+	{
+		if (shrink[i]) C[i] -= 0.5f * (std::fabs(A[i]) + std::fabs(B[i]));
+	}
+	zC += 0.5f * (std::fabs(zA) + std::fabs(zB));
+	float farthest = std::max(std::max(p[0].z, p[1].z), p[2].z);
+
+	// Starts on a multiple of four so the rows are processed four pixels at a time
+	minX &= ~3;
+	for (int y = minY; y <= maxY; y++)
+	{
+		float py = y + 0.5f;
+		float* row = depth.data() + (size_t)y * width;
+#ifdef OCCLUSION_USE_SSE2
+		__m128 zero = _mm_setzero_ps();
+		__m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+		for (int x = minX; x <= maxX; x += 4)
+		{
+			__m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int i = 0; i < 3; i++)
+			{
+				__m128 edge = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[i]), px), _mm_set1_ps(B[i] * py + C[i]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(edge, zero));
+			}
+			__m128 z = _mm_min_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(zA), px), _mm_set1_ps(zB * py + zC)), _mm_set1_ps(farthest));
+			__m128 old = _mm_loadu_ps(row + x);
+			__m128 nearer = _mm_min_ps(old, z);
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+		}
+#else
+		for (int x = minX; x <= maxX; x++)
+		{
+			float px = x + 0.5f;
+			if (A[0] * px + B[0] * py + C[0] < 0.0f) continue;
+			if (A[1] * px + B[1] * py + C[1] < 0.0f) continue;
+			if (A[2] * px + B[2] * py + C[2] < 0.0f) continue;
+			row[x] = std::min(row[x], std::min(zA * px + zB * py + zC, farthest));
+		}
+#endif
+	}
+}
@@ -0,0 +1,68 @@
+#ifndef OCCLUSION_CULLER_CLASS_H
+#define OCCLUSION_CULLER_CLASS_H
+
+#include<cstdint>
+#include<future>
+#include<vector>
+#include<glm/glm.hpp>
+
+#include"AABB.h"
+#include"Mesh.h"
+#include"ThreadPool.h"
+
+// Rasterizes a few large occluders into a small depth buffer on a worker thread and tests
+// boxes against it, so meshes hidden behind walls are never submitted. The buffer only holds
+// pixels the occluders cover completely, at their farthest depth there, so a box is never
+// culled while any part of it could show. Everything runs on the CPU and needs no GL context.
+class OcclusionCuller
+{
+public:
+	// Constructor with the size of the depth buffer, the width is rounded up to a multiple of four
+	OcclusionCuller(int width = 256, int height = 128);
+	// Waits for the rasterization in flight
+	~OcclusionCuller();
+	OcclusionCuller(const OcclusionCuller&) = delete;
+	OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+	// Adds world space triangles, three vertices each, to the occluders
+	void AddTriangles(const std::vector<glm::vec3>& triangles);
+	// Adds the meshes whose box has a face of at least minArea, largest first, until maxTriangles is reached
+	void AddOccluders(const std::vector<Mesh>& meshes, const glm::mat4& modelMatrix, float minArea, size_t maxTriangles);
+	// Removes every occluder
+	void ClearOccluders();
+	// Number of occluder triangles rasterized each frame
+	size_t Triangles() const { return occluders.size() / 3; }
+
+	// Starts rasterizing the occluders as seen by a projection * view matrix on the worker
+	void Begin(const glm::mat4& viewProjection);
+	// Whether any part of a world space box may be in front of the occluders, waits for Begin's rasterization
+	bool Visible(const AABB& box);
+	// Depth buffer of the last Begin from 0 (near) to 1 (far), row by row from the bottom, waits for it
+	const std::vector<float>& Depth();
+	int Width() const { return width; }
+	int Height() const { return height; }
+private:
+	int width;
+	int height;
+	std::vector<glm::vec3> occluders;
+	// Per occluder triangle, bit i set when its edge from vertex i to the next is on the outline,
+	// not shared with another triangle
+	std::vector<uint8_t> outlines;
+	std::vector<float> depth;
+	glm::mat4 viewProjection = glm::mat4(1.0f);
+	std::future<void> pending;
+	// Declared last so it finishes its job before anything it uses is destroyed
+	ThreadPool worker;
+
+	// Waits for the rasterization in flight
+	void wait();
+	// Clears the depth buffer and draws every occluder, runs on the worker
+	void rasterize();
+	// Finds the edges of the occluders not shared by two triangles
+	void findOutlines();
+	// Draws a triangle already clipped to the near plane, outline holds bit 0 for the edge
+	// from a to b, bit 1 for b to c and bit 2 for c to a when they are on the outline
+	void drawTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, uint8_t outline);
+};
+
+#endif
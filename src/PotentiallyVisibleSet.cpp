@@ -0,0 +1,409 @@
+#include"PotentiallyVisibleSet.h"
+#include"Logger.h"
+#include"ThreadPool.h"
+#include<algorithm>
+#include<atomic>
+#include<cfloat>
+#include<chrono>
+#include<cmath>
+#include<fstream>
+#include<future>
+#include<map>
+#include<memory>
+#include<random>
+#include<glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+	struct BakeTriangle
+	{
+		glm::vec3 a, b, c;
+		uint32_t mesh;
+	};
+
+	struct BVHNode
+	{
+		AABB bounds;
+		// Leaves hold count triangles from first, inner nodes have count 0 and children left and left + 1
+		uint32_t first;
+		uint32_t count;
+		uint32_t left;
+	};
+
+	// Bounding volume hierarchy over the triangles of the whole map, built by splitting the
+	// centroids at the median of the longest axis
+	class TriangleBVH
+	{
+	public:
+		explicit TriangleBVH(std::vector<BakeTriangle> triangles) : triangles(std::move(triangles))
+		{
+			if (this->triangles.empty()) return;
+			nodes.reserve(this->triangles.size() * 2);
+			nodes.push_back({});
+			build(0, 0, (uint32_t)this->triangles.size());
+		}
+
+		// Finds the closest triangle along a ray, returns false if nothing is hit before maxDistance
+		bool Intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, uint32_t& mesh) const
+		{
+			if (nodes.empty()) return false;
+			glm::vec3 inverse = 1.0f / direction;
+			float closest = maxDistance;
+			bool hit = false;
+			// Nodes still to visit, spilling to the heap for trees deeper than the fixed stack so none is dropped
+			uint32_t stack[64];
+			int size = 0;
+			std::vector<uint32_t> spilled;
+			auto push = [&](uint32_t index)
+			{
+				if (size < 64) stack[size++] = index;
+				else spilled.push_back(index);
+			};
+			push(0);
+			while (size > 0 || !spilled.empty())
+			{
+				uint32_t index;
+				if (!spilled.empty())
+				{
+					index = spilled.back();
+					spilled.pop_back();
+				}
+				else
+				{
+					index = stack[--size];
+				}
+				const BVHNode& node = nodes[index];
+				if (!hitsBox(node.bounds, origin, inverse, closest)) continue;
+				if (node.count > 0)
+				{
+					for (uint32_t i = node.first; i < node.first + node.count; i++)
+					{
+						float distance;
+						if (hitsTriangle(triangles[i], origin, direction, distance) && distance < closest)
+						{
+							closest = distance;
+							mesh = triangles[i].mesh;
+							hit = true;
+						}
+					}
+				}
+				else
+				{
+					push(node.left);
+					push(node.left + 1);
+				}
+			}
+			return hit;
+		}
+	private:
+		std::vector<BakeTriangle> triangles;
+		std::vector<BVHNode> nodes;
+
+		void build(uint32_t index, uint32_t first, uint32_t count)
+		{
+			AABB bounds = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+			AABB centroids = bounds;
+			for (uint32_t i = first; i < first + count; i++)
+			{
+				const BakeTriangle& t = triangles[i];
+				bounds.min = glm::min(glm::min(bounds.min, t.a), glm::min(t.b, t.c));
+				bounds.max = glm::max(glm::max(bounds.max, t.a), glm::max(t.b, t.c));
+				glm::vec3 centroid = (t.a + t.b + t.c) / 3.0f;
+				centroids.min = glm::min(centroids.min, centroid);
+				centroids.max = glm::max(centroids.max, centroid);
+			}
+			nodes[index].bounds = bounds;
+
+			glm::vec3 size = centroids.max - centroids.min;
+			int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+			if (count <= 4 || size[axis] <= 0.0f)
+			{
+				nodes[index].first = first;
+				nodes[index].count = count;
+				return;
+			}
+
+			uint32_t half = count / 2;
+			std::nth_element(triangles.begin() + first, triangles.begin() + first + half, triangles.begin() + first + count,
+				[axis](const BakeTriangle& x, const BakeTriangle& y) { return x.a[axis] + x.b[axis] + x.c[axis] < y.a[axis] + y.b[axis] + y.c[axis]; });
+			uint32_t left = (uint32_t)nodes.size();
+			nodes[index].count = 0;
+			nodes[index].left = left;
+			nodes.push_back({});
+			nodes.push_back({});
+			build(left, first, half);
+			build(left + 1, first + half, count - half);
+		}
+
+		static bool hitsBox(const AABB& box, const glm::vec3& origin, const glm::vec3& inverse, float maxDistance)
+		{
+			glm::vec3 t0 = (box.min - origin) * inverse;
+			glm::vec3 t1 = (box.max - origin) * inverse;
+			glm::vec3 tNear = glm::min(t0, t1);
+			glm::vec3 tFar = glm::max(t0, t1);
+			float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+			float leave = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+			return enter <= leave;
+		}
+
+		// Moller-Trumbore, hit from either side
+		static bool hitsTriangle(const BakeTriangle& t, const glm::vec3& origin, const glm::vec3& direction, float& distance)
+		{
+			glm::vec3 edge1 = t.b - t.a;
+			glm::vec3 edge2 = t.c - t.a;
+			glm::vec3 p = glm::cross(direction, edge2);
+			float determinant = glm::dot(edge1, p);
+			if (std::fabs(determinant) < 1e-9f) return false;
+			float inverse = 1.0f / determinant;
+			glm::vec3 s = origin - t.a;
+			float u = glm::dot(s, p) * inverse;
+			if (u < 0.0f || u > 1.0f) return false;
+			glm::vec3 q = glm::cross(s, edge1);
+			float v = glm::dot(direction, q) * inverse;
+			if (v < 0.0f || u + v > 1.0f) return false;
+			distance = glm::dot(edge2, q) * inverse;
+			return distance > 1e-4f;
+		}
+	};
+}
+
+// Computes the sets of a model's meshes on threads workers
+void PotentiallyVisibleSet::Bake(const std::vector<Mesh>& meshes, unsigned int threads)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<BakeTriangle> triangles;
+	std::vector<AABB> meshBounds(meshes.size(), { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) });
+	AABB scene = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+	for (size_t m = 0; m < meshes.size(); m++)
+	{
+		for (const auto& t : meshes[m].worldTriangles)
+		{
+			triangles.push_back({ t.a, t.b, t.c, (uint32_t)m });
+			meshBounds[m].min = glm::min(glm::min(meshBounds[m].min, t.a), glm::min(t.b, t.c));
+			meshBounds[m].max = glm::max(glm::max(meshBounds[m].max, t.a), glm::max(t.b, t.c));
+		}
+		scene.min = glm::min(scene.min, meshBounds[m].min);
+		scene.max = glm::max(scene.max, meshBounds[m].max);
+	}
+	meshCount = (uint32_t)meshes.size();
+	offsets.clear();
+	data.clear();
+	currentCell = -2;
+	if (triangles.empty()) return;
+	TriangleBVH bvh(std::move(triangles));
+
+	origin = glm::floor(glm::vec2(scene.min.x, scene.min.z) / cellSize) * cellSize;
+	cellsX = std::max(1, (int)std::ceil((scene.max.x - origin.x) / cellSize));
+	cellsZ = std::max(1, (int)std::ceil((scene.max.z - origin.y) / cellSize));
+	int cells = cellsX * cellsZ;
+
+	// Evenly spread directions on the sphere, rotated differently for every sample point
+	std::vector<glm::vec3> directions(raysPerSample);
+	const float goldenAngle = 2.39996323f;
+	for (int i = 0; i < raysPerSample; i++)
+	{
+		float y = 1.0f - 2.0f * (i + 0.5f) / raysPerSample;
+		float radius = std::sqrt(1.0f - y * y);
+		directions[i] = glm::vec3(std::cos(goldenAngle * i) * radius, y, std::sin(goldenAngle * i) * radius);
+	}
+	int side = std::max(1, (int)std::round(std::sqrt((float)samplesPerCell)));
+	float maxDistance = glm::length(scene.max - scene.min) + 1.0f;
+	size_t bytes = (meshes.size() + 7) / 8;
+
+	std::vector<std::vector<uint8_t>> sets(cells);
+	std::vector<uint8_t> walkable(cells, 0);
+	std::atomic<int> next(0);
+	auto work = [&]()
+	{
+		std::vector<uint8_t> bits;
+		for (int cell = next++; cell < cells; cell = next++)
+		{
+			bits.assign(bytes, 0);
+			int cx = cell % cellsX;
+			int cz = cell / cellsX;
+			std::mt19937 random((unsigned int)cell);
+			std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+			for (int s = 0; s < side * side; s++)
+			{
+				glm::vec3 point(origin.x + (cx + (s % side + 0.5f) / side) * cellSize, eyeHeight,
+					origin.y + (cz + (s / side + 0.5f) / side) * cellSize);
+				// Only points standing above a floor are walkable
+				uint32_t mesh;
+				if (!bvh.Intersect(point, glm::vec3(0.0f, -1.0f, 0.0f), maxDistance, mesh)) continue;
+				walkable[cell] = 1;
+
+				for (size_t m = 0; m < meshBounds.size(); m++)
+				{
+					if (glm::all(glm::lessThanEqual(meshBounds[m].min, point)) && glm::all(glm::lessThanEqual(point, meshBounds[m].max)))
+					{
+						bits[m / 8] |= (uint8_t)(1 << (m % 8));
+					}
+				}
+				glm::vec3 axis = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) * 2.0f - 1.0f + glm::vec3(1e-3f));
+				glm::mat3 rotation = glm::mat3(glm::rotate(glm::mat4(1.0f), unit(random) * 6.2831853f, axis));
+				for (const auto& direction : directions)
+				{
+					if (bvh.Intersect(point, rotation * direction, maxDistance, mesh)) bits[mesh / 8] |= (uint8_t)(1 << (mesh % 8));
+				}
+			}
+			if (walkable[cell]) compress(bits, sets[cell]);
+		}
+	};
+	{
+		ThreadPool pool(threads);
+		std::vector<std::future<void>> done;
+		for (unsigned int i = 0; i < pool.Size(); i++)
+		{
+			auto task = std::make_shared<std::packaged_task<void()>>(work);
+			done.push_back(task->get_future());
+			pool.Submit([task]() { (*task)(); });
+		}
+		for (auto& d : done) d.get();
+	}
+
+	// Cells that see the same meshes share one copy of the set
+	std::map<std::vector<uint8_t>, uint32_t> shared;
+	offsets.assign(cells, NoSet);
+	int walkableCells = 0;
+	for (int cell = 0; cell < cells; cell++)
+	{
+		if (!walkable[cell]) continue;
+		walkableCells++;
+		auto it = shared.find(sets[cell]);
+		if (it == shared.end())
+		{
+			it = shared.emplace(sets[cell], (uint32_t)data.size()).first;
+			data.insert(data.end(), sets[cell].begin(), sets[cell].end());
+		}
+		offsets[cell] = it->second;
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	LOG_INFO("Baked PVS: %dx%d cells, %d walkable, %zu meshes, %zu bytes of sets in %.2f s",
+		cellsX, cellsZ, walkableCells, meshes.size(), data.size(), seconds);
+}
+
+// Writes the baked sets to a file
+bool PotentiallyVisibleSet::Save(const std::string& path) const
+{
+	std::ofstream out(path, std::ios::binary);
+	if (!out) return false;
+	uint32_t dataSize = (uint32_t)data.size();
+	out.write("PVS1", 4);
+	out.write((const char*)&cellSize, sizeof(cellSize));
+	out.write((const char*)&eyeHeight, sizeof(eyeHeight));
+	out.write((const char*)&origin, sizeof(origin));
+	out.write((const char*)&cellsX, sizeof(cellsX));
+	out.write((const char*)&cellsZ, sizeof(cellsZ));
+	out.write((const char*)&meshCount, sizeof(meshCount));
+	out.write((const char*)&dataSize, sizeof(dataSize));
+	out.write((const char*)offsets.data(), offsets.size() * sizeof(uint32_t));
+	out.write((const char*)data.data(), data.size());
+	return (bool)out;
+}
+
+// Reads sets written by Save for a model with the given number of meshes
+bool PotentiallyVisibleSet::Load(const std::string& path, size_t meshes)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in) return false;
+	char magic[4];
+	uint32_t dataSize = 0;
+	in.read(magic, 4);
+	in.read((char*)&cellSize, sizeof(cellSize));
+	in.read((char*)&eyeHeight, sizeof(eyeHeight));
+	in.read((char*)&origin, sizeof(origin));
+	in.read((char*)&cellsX, sizeof(cellsX));
+	in.read((char*)&cellsZ, sizeof(cellsZ));
+	in.read((char*)&meshCount, sizeof(meshCount));
+	in.read((char*)&dataSize, sizeof(dataSize));
+	if (!in || std::string(magic, 4) != "PVS1" || cellsX <= 0 || cellsZ <= 0)
+	{
+		LOG_WARNING("Invalid PVS file: %s", path.c_str());
+		offsets.clear();
+		return false;
+	}
+	offsets.resize((size_t)cellsX * cellsZ);
+	data.resize(dataSize);
+	in.read((char*)offsets.data(), offsets.size() * sizeof(uint32_t));
+	in.read((char*)data.data(), data.size());
+	currentCell = -2;
+	// A set must start inside the data, and a file baked for another version of the model
+	// would hide the wrong meshes
+	bool offsetsValid = std::all_of(offsets.begin(), offsets.end(), [dataSize](uint32_t offset) { return offset == NoSet || offset < dataSize; });
+	if (!in || !offsetsValid)
+	{
+		LOG_WARNING("Invalid PVS file: %s", path.c_str());
+		offsets.clear();
+		return false;
+	}
+	if (meshCount != meshes)
+	{
+		LOG_WARNING("PVS file %s was baked for %u meshes, the model has %zu", path.c_str(), (unsigned int)meshCount, meshes);
+		offsets.clear();
+		return false;
+	}
+	return true;
+}
+
+// Unpacks the set of the cell holding the eye if it changed cells
+void PotentiallyVisibleSet::Update(const glm::vec3& eye)
+{
+	int cx = (int)std::floor((eye.x - origin.x) / cellSize);
+	int cz = (int)std::floor((eye.z - origin.y) / cellSize);
+	int cell = (offsets.empty() || cx < 0 || cz < 0 || cx >= cellsX || cz >= cellsZ) ? -1 : cz * cellsX + cx;
+	if (cell == currentCell) return;
+	currentCell = cell;
+	if (cell < 0 || offsets[cell] == NoSet) current.clear();
+	else decompress(offsets[cell], current);
+}
+
+// Whether a mesh can be seen from the cell of the last Update
+bool PotentiallyVisibleSet::Visible(size_t mesh) const
+{
+	if (current.empty() || mesh >= meshCount) return true;
+	return (current[mesh / 8] >> (mesh % 8)) & 1;
+}
+
+// Zero run length encodes a bitset
+void PotentiallyVisibleSet::compress(const std::vector<uint8_t>& bits, std::vector<uint8_t>& out)
+{
+	out.clear();
+	for (size_t i = 0; i < bits.size();)
+	{
+		if (bits[i] != 0)
+		{
+			out.push_back(bits[i++]);
+			continue;
+		}
+		uint8_t run = 0;
+		while (i < bits.size() && bits[i] == 0 && run < 255)
+		{
+			run++;
+			i++;
+		}
+		out.push_back(0);
+		out.push_back(run);
+	}
+}
+
+// Expands a set written by compress
+void PotentiallyVisibleSet::decompress(uint32_t offset, std::vector<uint8_t>& bits) const
+{
+	size_t bytes = (meshCount + 7) / 8;
+	bits.clear();
+	for (size_t i = offset; i < data.size() && bits.size() < bytes;)
+	{
+		uint8_t value = data[i++];
+		if (value != 0)
+		{
+			bits.push_back(value);
+		}
+		else if (i < data.size())
+		{
+			bits.insert(bits.end(), data[i++], 0);
+		}
+	}
+	bits.resize(bytes, 0);
+}
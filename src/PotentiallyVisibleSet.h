@@ -0,0 +1,65 @@
+#ifndef POTENTIALLY_VISIBLE_SET_CLASS_H
+#define POTENTIALLY_VISIBLE_SET_CLASS_H
+
+#include<cstdint>
+#include<string>
+#include<vector>
+#include<glm/glm.hpp>
+
+#include"Mesh.h"
+
+// Meshes of a static model that can be seen from each cell of a grid laid over the walkable
+// space. The sets are baked offline by casting rays from every cell and stored zero run length
+// encoded, so at runtime finding what is visible is one lookup when the camera changes cells.
+class PotentiallyVisibleSet
+{
+public:
+	// Width of a cell on the ground in world units
+	float cellSize = 1.0f;
+	// Height the rays are cast from, the camera's
+	float eyeHeight = 2.5f;
+	// Points sampled per cell, a square number
+	int samplesPerCell = 4;
+	// Rays cast from every sample point
+	int raysPerSample = 1024;
+
+	// Computes the sets of a model's meshes, whose world triangles must have been computed, on threads workers
+	void Bake(const std::vector<Mesh>& meshes, unsigned int threads);
+	// Writes the baked sets to a file
+	bool Save(const std::string& path) const;
+	// Reads sets written by Save for a model with the given number of meshes, false if the file
+	// is damaged or was baked for a different mesh count
+	bool Load(const std::string& path, size_t meshes);
+
+	// Unpacks the set of the cell holding the eye if it changed cells
+	void Update(const glm::vec3& eye);
+	// Whether a mesh can be seen from the cell of the last Update, always when the cell has no set
+	bool Visible(size_t mesh) const;
+	// Whether there are sets to use
+	bool Empty() const { return offsets.empty(); }
+	// Bytes of compressed sets
+	size_t Bytes() const { return data.size(); }
+private:
+	// Cell without a set, outside the walkable space
+	static constexpr uint32_t NoSet = 0xFFFFFFFFu;
+
+	// Corner of the grid on the ground
+	glm::vec2 origin = glm::vec2(0.0f);
+	int cellsX = 0;
+	int cellsZ = 0;
+	uint32_t meshCount = 0;
+	// Offset of every cell's set in data, row by row along x
+	std::vector<uint32_t> offsets;
+	std::vector<uint8_t> data;
+
+	// Set of the current cell, empty when every mesh is visible
+	int currentCell = -2;
+	std::vector<uint8_t> current;
+
+	// Zero run length encodes a bitset, a zero byte is followed by the number of zero bytes it stands for
+	static void compress(const std::vector<uint8_t>& bits, std::vector<uint8_t>& out);
+	// Expands a set written by compress
+	void decompress(uint32_t offset, std::vector<uint8_t>& bits) const;
+};
+
+#endif
@@ -0,0 +1,180 @@
+#include"RenderQueue.h"
+#include"Camera.h"
+#include"CpuProfiler.h"
+#include"CellPortalGraph.h"
+#include"GeometryBuffer.h"
+#include"GpuProfiler.h"
+#include"Mesh.h"
+#include"OcclusionCuller.h"
+#include"shaderClass.h"
+#include"ShaderVariants.h"
+#include<algorithm>
+#include<glm/gtc/matrix_inverse.hpp>
+#include<cstring>
+
+// Starts a new frame seen from the camera
+void RenderQueue::Begin(const Camera& camera)
+{
+	items.clear();
+	normalMatrices.clear();
+	Shader::uploads = 0;
+	culled = 0;
+	occluded = 0;
+	frustum = Frustum(camera.cameraMatrix);
+	portalCulled = 0;
+	pvsCulled = 0;
+	cameraPosition = camera.Position;
+	cameraForward = camera.Orientation;
+	// Walks the portals from this frame's eye
+	if (cells != nullptr) cells->Traverse(cameraPosition, frustum);
+}
+
+// Queues a mesh drawn with a shader and a model matrix
+void RenderQueue::Submit(Mesh& mesh, Shader& shader, const glm::mat4* model)
+{
+	auto it = shaderIndices.find(shader.ID);
+	if (it == shaderIndices.end()) it = shaderIndices.emplace(shader.ID, shaderIndices.size() & 0xFF).first;
+
+	// View depth of the mesh's center; positive floats compare like their bit patterns
+	glm::vec3 center = glm::vec3(*model * glm::vec4((mesh.localAABB.min + mesh.localAABB.max) * 0.5f, 1.0f));
+	float depth = std::max(glm::dot(center - cameraPosition, cameraForward), 0.0f);
+	uint32_t depthBits;
+	memcpy(&depthBits, &depth, sizeof(depthBits));
+
+	uint64_t key = (it->second << 56) | ((uint64_t)(mesh.materialID & 0xFFFFFF) << 32) | depthBits;
+	items.push_back({ key, &mesh, &shader, model });
+}
+
+// Whether a world space box passes this frame's frustum, portal and occlusion tests
+bool RenderQueue::Visible(const AABB& box) const
+{
+	if (!frustum.Intersects(box)) return false;
+	if (cells != nullptr && !cells->Visible(cells->Mask(box), box)) return false;
+	return occlusion == nullptr || occlusion->Visible(box);
+}
+
+// Sorts the queued draws front to back within each shader and material and draws them
+void RenderQueue::Flush()
+{
+	PROFILE_ZONE("RenderQueue::Flush");
+	std::sort(items.begin(), items.end(), [](const DrawItem& a, const DrawItem& b) { return a.key < b.key; });
+
+	// Textures may have been bound by the streamer and uploader since the last frame
+	state.Invalidate();
+	state.ResetCounters();
+
+	// Consecutive draws from the geometry buffer with the same shader and material become one batch
+	batches.clear();
+	if (geometry != nullptr)
+	{
+		geometry->Begin();
+		for (size_t i = 0; i < items.size(); i++)
+		{
+			const DrawItem& item = items[i];
+			uint32_t features;
+			if (!geometryReplaces->Features(*item.shader, features) || !geometry->Contains(*item.mesh)) continue;
+			size_t command = geometry->Queue(*item.mesh, *item.model, normalMatrix(item.model));
+			if (!batches.empty())
+			{
+				Batch& last = batches.back();
+				const DrawItem& first = items[last.firstItem];
+				if (last.firstItem + last.count == i && first.shader == item.shader && first.mesh->materialID == item.mesh->materialID)
+				{
+					last.count++;
+					continue;
+				}
+			}
+			batches.push_back({ i, 1, command, &geometryShaders->Get(features) });
+		}
+		geometry->Upload();
+	}
+
+	if (depthShader != nullptr)
+	{
+		// Depth only, then every fragment that isn't the nearest fails the equal test before shading
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		if (profiler != nullptr) profiler->Begin("Depth pre-pass");
+		draw(true);
+		if (profiler != nullptr) profiler->End();
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+		if (profiler != nullptr) profiler->Begin("Shading");
+		draw(false);
+		if (profiler != nullptr) profiler->End();
+		glDepthFunc(GL_LESS);
+		glDepthMask(GL_TRUE);
+	}
+	else
+	{
+		if (profiler != nullptr) profiler->Begin("Shading");
+		draw(false);
+		if (profiler != nullptr) profiler->End();
+	}
+	lastFrame = state.counters;
+	lastFrame.uniforms = Shader::uploads;
+}
+
+// Draws the meshes of a geometry buffer queued with a variant of one set through the same variant of another
+void RenderQueue::UseGeometryBuffer(GeometryBuffer* buffer, ShaderVariants* replaces, ShaderVariants* indirect)
+{
+	geometry = buffer;
+	geometryReplaces = replaces;
+	geometryShaders = indirect;
+}
+
+// Lays down the depth of every queued draw with a position only shader before shading them with GL_EQUAL
+void RenderQueue::UseDepthPrePass(Shader* depth, Shader* depthIndirect)
+{
+	depthShader = depth;
+	depthIndirectShader = depthIndirect;
+}
+
+// Draws the queued items, positions only with the depth shaders when depthOnly is set
+void RenderQueue::draw(bool depthOnly)
+{
+	size_t batch = 0;
+	for (size_t i = 0; i < items.size();)
+	{
+		if (batch < batches.size() && batches[batch].firstItem == i)
+		{
+			const Batch& run = batches[batch++];
+			if (depthOnly)
+			{
+				state.UseProgram(depthIndirectShader->ID);
+				geometry->DrawDepth(run.firstCommand, run.count, state);
+				i += run.count;
+				continue;
+			}
+			state.UseProgram(run.shader->ID);
+			items[i].mesh->BindTextures(*run.shader, state);
+			geometry->Draw(run.firstCommand, run.count, state);
+			i += run.count;
+			continue;
+		}
+		DrawItem& item = items[i++];
+		if (depthOnly)
+		{
+			state.UseProgram(depthShader->ID);
+			depthShader->SetMat4("model", *item.model);
+			item.mesh->DrawDepth(state);
+			continue;
+		}
+		state.UseProgram(item.shader->ID);
+		item.shader->SetMat4("model", *item.model);
+		item.shader->SetMat3("normalMatrix", normalMatrix(item.model));
+		item.mesh->Draw(*item.shader, state);
+	}
+}
+
+// Inverse transpose of the upper 3x3 of a queued model matrix
+const glm::mat3& RenderQueue::normalMatrix(const glm::mat4* model)
+{
+	// Only a few distinct matrices are drawn per frame, so a linear search is enough
+	for (const auto& entry : normalMatrices)
+	{
+		if (entry.first == model) return entry.second;
+	}
+	normalMatrices.push_back({ model, glm::inverseTranspose(glm::mat3(*model)) });
+	return normalMatrices.back().second;
+}
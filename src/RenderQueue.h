@@ -0,0 +1,114 @@
+#ifndef RENDER_QUEUE_CLASS_H
+#define RENDER_QUEUE_CLASS_H
+
+#include<cstdint>
+#include<unordered_map>
+#include<utility>
+#include<vector>
+#include<glm/glm.hpp>
+
+#include"AABB.h"
+#include"GLStateCache.h"
+#include"Frustum.h"
+
+class Camera;
+class OcclusionCuller;
+class CellPortalGraph;
+class GeometryBuffer;
+class GpuProfiler;
+class Mesh;
+class Shader;
+class ShaderVariants;
+
+// Collects the draws of a frame, sorts them by shader, material and depth and submits
+// them through a state cache so unchanged bindings never reach the driver
+class RenderQueue
+{
+public:
+	struct DrawItem
+	{
+		// Shader in the top 8 bits, material in the next 24, view depth in the low 32
+		uint64_t key;
+		Mesh* mesh;
+		Shader* shader;
+		// Must stay alive until Flush
+		const glm::mat4* model;
+	};
+
+	// Tracks the bound program, vertex array and textures across the draws
+	GLStateCache state;
+	// Counters of the last flushed frame
+	GLStateCache::Counters lastFrame;
+	// What the camera of this frame sees, draws outside of it are not submitted
+	Frustum frustum;
+	// Meshes left out by frustum culling this frame
+	unsigned int culled = 0;
+	// Meshes inside the frustum but outside the potentially visible set of the camera's cell this frame
+	unsigned int pvsCulled = 0;
+	// Hides the meshes of rooms that can't be seen through a doorway when set, traversed by Begin
+	CellPortalGraph* cells = nullptr;
+	// Meshes inside the frustum but in cells not seen through the portals this frame
+	unsigned int portalCulled = 0;
+	// Hides meshes behind the occluders when set, its Begin must have been called for this frame
+	OcclusionCuller* occlusion = nullptr;
+	// Meshes inside the frustum but left out as occluded this frame
+	unsigned int occluded = 0;
+	// Times the depth pre-pass and the shading pass of Flush as sections when set
+	GpuProfiler* profiler = nullptr;
+
+	// Starts a new frame seen from the camera
+	void Begin(const Camera& camera);
+	// Queues a mesh drawn with a shader and a model matrix
+	void Submit(Mesh& mesh, Shader& shader, const glm::mat4* model);
+	// Whether a world space box passes this frame's frustum, portal and occlusion tests, for
+	// objects drawn outside the queue. The potentially visible set only knows the static meshes.
+	bool Visible(const AABB& box) const;
+	// Sorts the queued draws front to back within each shader and material and draws them
+	void Flush();
+	// Draws the meshes of a geometry buffer queued with a variant of one set through the variant
+	// with the same features of another that reads the per-draw data, one multi-draw per run of
+	// the same shader and material; nullptr goes back to single draws
+	void UseGeometryBuffer(GeometryBuffer* buffer, ShaderVariants* replaces, ShaderVariants* indirect);
+	// Lays down the depth of every queued draw with a position only shader before shading them
+	// with GL_EQUAL, so each pixel is shaded once; the indirect shader draws from the geometry
+	// buffer. nullptr turns the pre-pass off.
+	void UseDepthPrePass(Shader* depth, Shader* depthIndirect);
+	// Whether Flush runs the depth pre-pass
+	bool DepthPrePass() const { return depthShader != nullptr; }
+	// Number of draws queued this frame
+	size_t Size() const { return items.size(); }
+	// Draws queued this frame, only the meshes that passed every culling test
+	const std::vector<DrawItem>& Items() const { return items; }
+private:
+	std::vector<DrawItem> items;
+	glm::vec3 cameraPosition = glm::vec3(0.0f);
+	glm::vec3 cameraForward = glm::vec3(0.0f, 0.0f, -1.0f);
+	// Small index per program so it fits in the key
+	std::unordered_map<unsigned int, uint64_t> shaderIndices;
+
+	// Queued draws from firstItem on that go out as one multi-draw
+	struct Batch
+	{
+		size_t firstItem;
+		size_t count;
+		size_t firstCommand;
+		Shader* shader;
+	};
+	GeometryBuffer* geometry = nullptr;
+	ShaderVariants* geometryReplaces = nullptr;
+	ShaderVariants* geometryShaders = nullptr;
+	std::vector<Batch> batches;
+
+	Shader* depthShader = nullptr;
+	Shader* depthIndirectShader = nullptr;
+
+	// Draws the queued items, positions only with the depth shaders when depthOnly is set
+	void draw(bool depthOnly);
+
+	// Normal matrix of every model matrix drawn this frame, computed once each
+	std::vector<std::pair<const glm::mat4*, glm::mat3>> normalMatrices;
+	// Inverse transpose of the upper 3x3 of a queued model matrix
+	const glm::mat3& normalMatrix(const glm::mat4* model);
+};
+
+#endif
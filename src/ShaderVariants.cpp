@@ -0,0 +1,141 @@
+#include"ShaderVariants.h"
+#include<algorithm>
+
+// Constructor with the files, the macro defined by each bit, in bit order, and lines defined in every variant
+ShaderVariants::ShaderVariants(const char* vertexFile, const char* fragmentFile, std::vector<std::string> featureNames, std::string commonDefines)
+	: vertexFile(vertexFile), fragmentFile(fragmentFile), featureNames(std::move(featureNames)), commonDefines(std::move(commonDefines))
+{
+}
+
+// Variant with the given features, compiled the first time it is asked for
+Shader& ShaderVariants::Get(uint32_t features)
+{
+	auto it = variants.find(features);
+	if (it != variants.end()) return *it->second;
+	auto started = pending.find(features);
+	if (started != pending.end())
+	{
+		std::unique_ptr<Shader> shader = std::move(started->second);
+		pending.erase(started);
+		shader->Finish();
+		return add(features, std::move(shader));
+	}
+	return add(features, std::make_unique<Shader>(vertexFile.c_str(), fragmentFile.c_str(), Defines(features)));
+}
+
+// Starts compiling the variants of several masks without waiting
+void ShaderVariants::Prepare(const std::vector<uint32_t>& masks)
+{
+	for (uint32_t features : masks)
+	{
+		if (variants.count(features) != 0 || pending.count(features) != 0) continue;
+		pending[features] = std::make_unique<Shader>(vertexFile.c_str(), fragmentFile.c_str(), Defines(features), false);
+	}
+}
+
+// Finishes the prepared variants the driver is done with without waiting on the others
+void ShaderVariants::Poll()
+{
+	for (auto it = pending.begin(); it != pending.end();)
+	{
+		if (!it->second->Ready())
+		{
+			++it;
+			continue;
+		}
+		uint32_t features = it->first;
+		std::unique_ptr<Shader> shader = std::move(it->second);
+		it = pending.erase(it);
+		shader->Finish();
+		add(features, std::move(shader));
+	}
+}
+
+// Runs onCompile on a finished variant and stores it, keeping the program in use as it was
+Shader& ShaderVariants::add(uint32_t features, std::unique_ptr<Shader> shader)
+{
+	// Variants are compiled in the middle of a frame, so the program a state cache thinks is
+	// bound has to stay bound
+	GLint current = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+	if (onCompile) onCompile(*shader);
+	glUseProgram((GLuint)current);
+
+	programFeatures[shader->ID] = features;
+	return *variants.emplace(features, std::move(shader)).first->second;
+}
+
+// Features of a variant compiled by this set, false if the shader isn't one of them
+bool ShaderVariants::Features(const Shader& shader, uint32_t& features) const
+{
+	auto it = programFeatures.find(shader.ID);
+	if (it == programFeatures.end()) return false;
+	features = it->second;
+	return true;
+}
+
+// The #define lines of a feature mask, after the common ones
+std::string ShaderVariants::Defines(uint32_t features) const
+{
+	std::string defines = commonDefines;
+	for (size_t i = 0; i < featureNames.size(); i++)
+	{
+		if (features & (1u << i)) defines += "#define " + featureNames[i] + "\n";
+	}
+	return defines;
+}
+
+// Deletes every variant
+void ShaderVariants::Delete()
+{
+	for (auto& variant : variants) variant.second->Delete();
+	for (auto& variant : pending) variant.second->Delete();
+	variants.clear();
+	pending.clear();
+	programFeatures.clear();
+}
+
+// Macros of the DefaultFeature bits, in bit order
+const std::vector<std::string>& DefaultFeatureNames()
+{
+	static const std::vector<std::string> names = { "FLASHLIGHT", "HAS_SPECULAR", "YELLOW_ROOM", "CLUSTERED_LIGHTS" };
+	return names;
+}
+
+// Rectangles of the yellow room on the ground, as min x, max x, min z, max z
+const std::vector<glm::vec4>& YellowRoomRects()
+{
+	// The lamp is inside the second one
+	static const std::vector<glm::vec4> rects = { glm::vec4(-5.0f, 9.0f, 1.0f, 6.0f), glm::vec4(-5.0f, 0.0f, -9.0f, 6.0f) };
+	return rects;
+}
+
+// Lines every variant of default.frag gets whatever its features
+std::string DefaultDefines()
+{
+	std::string list;
+	for (const glm::vec4& r : YellowRoomRects())
+	{
+		if (!list.empty()) list += ", ";
+		list += "vec4(" + std::to_string(r.x) + ", " + std::to_string(r.y) + ", " + std::to_string(r.z) + ", " + std::to_string(r.w) + ")";
+	}
+	return "#define YELLOW_ROOM_RECTS " + list + "\n";
+}
+
+// Features of default.frag a mesh needs wherever it is drawn
+uint32_t MeshFeatures(const Mesh& mesh)
+{
+	bool specular = std::find(mesh.samplerNames.begin(), mesh.samplerNames.end(), "specular0") != mesh.samplerNames.end();
+	return specular ? (uint32_t)FEATURE_HAS_SPECULAR : 0u;
+}
+
+// Features of default.frag a mesh needs with its world space box
+uint32_t MeshFeatures(const Mesh& mesh, const AABB& worldBox)
+{
+	// Same rectangles inYellowRoom in default.frag tests
+	bool yellowRoom = std::any_of(YellowRoomRects().begin(), YellowRoomRects().end(), [&](const glm::vec4& r)
+	{
+		return worldBox.min.x <= r.y && worldBox.max.x >= r.x && worldBox.min.z <= r.w && worldBox.max.z >= r.z;
+	});
+	return MeshFeatures(mesh) | (yellowRoom ? (uint32_t)FEATURE_YELLOW_ROOM : 0u);
+}
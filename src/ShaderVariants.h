@@ -0,0 +1,81 @@
+#ifndef SHADER_VARIANTS_CLASS_H
+#define SHADER_VARIANTS_CLASS_H
+
+#include<cstdint>
+#include<functional>
+#include<memory>
+#include<string>
+#include<unordered_map>
+#include<vector>
+
+#include"AABB.h"
+#include"Mesh.h"
+#include"shaderClass.h"
+
+// Compiles the variants of one pair of shader files, each bit of a feature mask injecting a
+// #define, and keeps every variant compiled so far keyed by its mask
+class ShaderVariants
+{
+public:
+	// Called once on every newly compiled variant, e.g. to point its samplers at their units
+	std::function<void(Shader&)> onCompile;
+
+	// Constructor with the files, the macro defined by each bit, in bit order, and lines defined
+	// in every variant
+	ShaderVariants(const char* vertexFile, const char* fragmentFile, std::vector<std::string> featureNames, std::string commonDefines = "");
+	ShaderVariants(const ShaderVariants&) = delete;
+	ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+	// Variant with the given features, compiled the first time it is asked for; the program in
+	// use is left as it was
+	Shader& Get(uint32_t features);
+	// Starts compiling the variants of several masks without waiting, so drivers with parallel
+	// shader compilation build them side by side; Poll or Get finishes them
+	void Prepare(const std::vector<uint32_t>& masks);
+	// Finishes the prepared variants the driver is done with without waiting on the others,
+	// call once per frame so Get rarely has to wait
+	void Poll();
+	// Features of a variant compiled by this set, false if the shader isn't one of them
+	bool Features(const Shader& shader, uint32_t& features) const;
+	// The #define lines of a feature mask, after the common ones
+	std::string Defines(uint32_t features) const;
+	// Number of variants compiled
+	size_t Size() const { return variants.size(); }
+	// Deletes every variant
+	void Delete();
+private:
+	std::string vertexFile;
+	std::string fragmentFile;
+	std::vector<std::string> featureNames;
+	std::string commonDefines;
+	std::unordered_map<uint32_t, std::unique_ptr<Shader>> variants;
+	// Variants started by Prepare that Get hasn't asked for yet
+	std::unordered_map<uint32_t, std::unique_ptr<Shader>> pending;
+	// Mask of each compiled program
+	std::unordered_map<GLuint, uint32_t> programFeatures;
+
+	// Runs onCompile on a finished variant and stores it, keeping the program in use as it was
+	Shader& add(uint32_t features, std::unique_ptr<Shader> shader);
+};
+
+// Features of default.frag, each bit defines the macro of the same name without the prefix
+enum DefaultFeature : uint32_t
+{
+	FEATURE_FLASHLIGHT = 1u << 0,
+	FEATURE_HAS_SPECULAR = 1u << 1,
+	FEATURE_YELLOW_ROOM = 1u << 2,
+	FEATURE_CLUSTERED_LIGHTS = 1u << 3,
+};
+// Macros of the DefaultFeature bits, in bit order
+const std::vector<std::string>& DefaultFeatureNames();
+// Rectangles of the yellow room on the ground, as min x, max x, min z, max z
+const std::vector<glm::vec4>& YellowRoomRects();
+// Lines every variant of default.frag gets whatever its features: YELLOW_ROOM_RECTS, the
+// rectangles of YellowRoomRects as a list of vec4 for inYellowRoom
+std::string DefaultDefines();
+// Features of default.frag a mesh needs wherever it is drawn
+uint32_t MeshFeatures(const Mesh& mesh);
+// Features of default.frag a mesh needs with its world space box
+uint32_t MeshFeatures(const Mesh& mesh, const AABB& worldBox);
+
+#endif
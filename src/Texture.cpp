@@ -1,16 +1,15 @@
 #include "Texture.h"
+#include "ImageDecoder.h"
 
 Texture::Texture(const char* image, const char* texType, GLuint slot, GLenum format, GLenum pixelType)
 {
 	// Assigns the type of the texture ot the texture object
 	type = texType;
 
-	// Stores the width, height, and the number of color channels of the image
-	int widthImg, heightImg, numColCh;
-	// Flips the image so it appears right side up
-	stbi_set_flip_vertically_on_load(true);
-	// Reads the image from a file and stores it in bytes
-	unsigned char* bytes = stbi_load(image, &widthImg, &heightImg, &numColCh, 0);
+	// Reads the image from a file, flipped so it appears right side up, with as many channels as the format has
+	ImageInfo info;
+	std::vector<unsigned char> bytes = DefaultImageDecoder().Decode(image, format == GL_RGB ? 3 : 4, true, info);
+	int widthImg = info.width, heightImg = info.height;
 
 	// Generates an OpenGL texture object
 	glGenTextures(1, &ID);
@@ -32,13 +31,12 @@ Texture::Texture(const char* image, const char* texType, GLuint slot, GLenum for
 	// glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, flatColor);
 
 	// Assigns the image to the OpenGL Texture object
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, widthImg, heightImg, 0, format, pixelType, bytes);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, widthImg, heightImg, 0, format, pixelType, bytes.empty() ? nullptr : bytes.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 	// Generates MipMaps
 	glGenerateMipmap(GL_TEXTURE_2D);
 
-	// Deletes the image data as it is already in the OpenGL Texture object
-	stbi_image_free(bytes);
-
 	// Unbinds the OpenGL Texture object so that it can't accidentally be modified
 	glBindTexture(GL_TEXTURE_2D, 0);
 }
@@ -51,12 +49,10 @@ Texture::Texture() : ID(0), type(nullptr), unit(0)
 
 void Texture::texUnit(Shader& shader, const char* uniform, GLuint unit)
 {
-	// Gets the location of the uniform
-	GLuint texUni = glGetUniformLocation(shader.ID, uniform);
 	// Shader needs to be activated before changing the value of a uniform
 	shader.Activate();
 	// Sets the value of the uniform
-	glUniform1i(texUni, unit);
+	shader.SetInt(uniform, unit);
 }
 
 void Texture::Bind()
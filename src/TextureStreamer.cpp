@@ -0,0 +1,327 @@
+#include"TextureStreamer.h"
+#include"Camera.h"
+#include"Mesh.h"
+#include"AABB.h"
+#include"ImageDecoder.h"
+#include"Logger.h"
+#include"RenderQueue.h"
+#include"TextureUploader.h"
+#include<algorithm>
+#include<cmath>
+#include<iterator>
+#include<cstring>
+
+// Size of a mip along one axis
+static int levelSize(int size, int level)
+{
+	return std::max(1, size >> level);
+}
+
+// Halves an image with a 2x2 box filter, matching the sizes glGenerateMipmap would produce
+static std::vector<unsigned char> downsample(const unsigned char* src, int width, int height, int channels)
+{
+	int w = std::max(1, width / 2);
+	int h = std::max(1, height / 2);
+	std::vector<unsigned char> dst((size_t)w * h * channels);
+	for (int y = 0; y < h; y++)
+	{
+		int y0 = std::min(2 * y, height - 1);
+		int y1 = std::min(2 * y + 1, height - 1);
+		for (int x = 0; x < w; x++)
+		{
+			int x0 = std::min(2 * x, width - 1);
+			int x1 = std::min(2 * x + 1, width - 1);
+			for (int c = 0; c < channels; c++)
+			{
+				int sum = src[((size_t)y0 * width + x0) * channels + c] + src[((size_t)y0 * width + x1) * channels + c]
+					+ src[((size_t)y1 * width + x0) * channels + c] + src[((size_t)y1 * width + x1) * channels + c];
+				dst[((size_t)y * w + x) * channels + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+	return dst;
+}
+
+// Decodes an image and writes its mips from firstLevel up to lastLevel, finest first, into dst
+static bool decodeLevels(const std::string& path, int channels, int width, int height, int firstLevel, int lastLevel, unsigned char* dst)
+{
+	ImageDecoder& decoder = DefaultImageDecoder();
+	// The file is read once for both the header and the pixels
+	std::vector<unsigned char> file;
+	ImageInfo info;
+	if (!ImageDecoder::ReadFile(path.c_str(), file) || !decoder.InfoFromMemory(file.data(), file.size(), info)
+		|| info.width != width || info.height != height) return false;
+
+	// The full resolution mip is decoded in place when it is wanted
+	size_t fullSize = (size_t)width * height * channels;
+	std::vector<unsigned char> full;
+	if (firstLevel > 0) full.resize(fullSize);
+	unsigned char* fullDst = firstLevel > 0 ? full.data() : dst;
+	if (!decoder.DecodeFromMemory(file.data(), file.size(), channels, true, fullDst, fullSize)) return false;
+
+	std::vector<unsigned char> level;
+	const unsigned char* src = fullDst;
+	for (int i = 0; i < lastLevel; i++)
+	{
+		int w = levelSize(width, i);
+		int h = levelSize(height, i);
+		size_t size = (size_t)w * h * channels;
+		if (i >= firstLevel)
+		{
+			if (src != dst) memcpy(dst, src, size);
+			dst += size;
+		}
+		if (i + 1 < lastLevel)
+		{
+			level = downsample(src, w, h, channels);
+			src = level.data();
+		}
+	}
+	return true;
+}
+
+// Constructor that sets the VRAM budget and starts the worker threads
+TextureStreamer::TextureStreamer(size_t budgetBytes, unsigned int workers, TextureUploader* uploader)
+	: budgetBytes(budgetBytes), uploader(uploader), workers(workers)
+{
+}
+
+// Loads an image with only its low mips resident and registers it for streaming
+Texture TextureStreamer::Load(const char* image, const char* texType, GLuint slot, GLenum format)
+{
+	Texture texture;
+	texture.type = texType;
+	texture.unit = slot;
+
+	Entry entry;
+	entry.path = image;
+	entry.format = format;
+	entry.channels = format == GL_RGB ? 3 : 4;
+
+	// Reads the full image once, only its low mips are kept
+	ImageInfo info;
+	std::vector<unsigned char> bytes = DefaultImageDecoder().Decode(image, entry.channels, true, info);
+	entry.width = info.width;
+	entry.height = info.height;
+	if (bytes.empty())
+	{
+		LOG_WARNING("Failed to load texture: %s", image);
+		return texture;
+	}
+
+	entry.levels = 1 + (int)std::floor(std::log2((float)std::max(entry.width, entry.height)));
+	entry.lowBase = 0;
+	while (entry.lowBase < entry.levels - 1 &&
+		std::max(levelSize(entry.width, entry.lowBase), levelSize(entry.height, entry.lowBase)) > residentSize)
+	{
+		entry.lowBase++;
+	}
+	entry.residentBase = entry.lowBase;
+	entry.wantedLevel = entry.lowBase;
+	entry.lastNeeded.assign(entry.levels, 0);
+
+	glGenTextures(1, &entry.ID);
+	glActiveTexture(GL_TEXTURE0 + slot);
+	glBindTexture(GL_TEXTURE_2D, entry.ID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// Only the mips from the base level up are sampled, the finer ones stream in later
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, entry.lowBase);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, entry.levels - 1);
+
+	std::vector<unsigned char> level;
+	const unsigned char* src = bytes.data();
+	for (int i = 0; i < entry.levels; i++)
+	{
+		if (i >= entry.lowBase) uploadLevel(entry, i, src);
+		if (i + 1 < entry.levels)
+		{
+			level = downsample(src, levelSize(entry.width, i), levelSize(entry.height, i), entry.channels);
+			src = level.data();
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	texture.ID = entry.ID;
+	entries[entry.ID] = std::move(entry);
+	return texture;
+}
+
+// Marks the mips the draws the queue accepted this frame need based on their size on screen
+void TextureStreamer::Request(const RenderQueue& queue, const Camera& camera, float FOVdeg)
+{
+	float tanHalfFov = std::tan(glm::radians(FOVdeg) * 0.5f);
+	for (const auto& item : queue.Items()) request(*item.mesh, *item.model, camera, tanHalfFov);
+}
+
+// Marks the mips one mesh needs with its model matrix
+void TextureStreamer::request(const Mesh& mesh, const glm::mat4& modelMatrix, const Camera& camera, float tanHalfFov)
+{
+	AABB box = transformAABB(mesh.localAABB, modelMatrix);
+	glm::vec3 center = (box.min + box.max) * 0.5f;
+	float radius = glm::length(box.max - box.min) * 0.5f;
+	float dist = std::max(glm::distance(camera.Position, center) - radius, 0.1f);
+	// Diameter of the bounding sphere in pixels
+	float pixels = radius * camera.height / (dist * tanHalfFov);
+
+	for (const auto& texture : mesh.textures)
+	{
+		// Textures uploaded whole, like Nathan's, aren't streamed
+		auto it = entries.find(texture.ID);
+		if (it == entries.end()) continue;
+		Entry& entry = it->second;
+
+		float texels = std::max(entry.width, entry.height) * mesh.uvExtent;
+		int level = (int)std::floor(std::log2(std::max(texels / std::max(pixels, 1.0f), 1.0f)));
+		level = std::clamp(level, 0, entry.lowBase);
+		entry.wantedLevel = std::min(entry.wantedLevel, level);
+		for (int i = level; i < entry.lowBase; i++)
+		{
+			entry.lastNeeded[i] = frame;
+		}
+	}
+}
+
+// Uploads streamed mips, starts new jobs and evicts mips over the budget
+void TextureStreamer::Update()
+{
+	std::vector<Result> finished;
+	{
+		std::lock_guard<std::mutex> lock(resultsMutex);
+		size_t count = std::min(results.size(), (size_t)uploadsPerFrame);
+		std::move(results.begin(), results.begin() + count, std::back_inserter(finished));
+		results.erase(results.begin(), results.begin() + count);
+	}
+	for (auto& result : finished)
+	{
+		applyLevels(result.ID, result.firstLevel, result.data.data(), result.ok);
+	}
+
+	while (residentBytes > budgetBytes && evictOne(0)) {}
+
+	for (auto& [id, entry] : entries)
+	{
+		if (pendingJobs < maxPendingJobs && entry.pendingLevel < 0 && entry.wantedLevel < entry.residentBase)
+		{
+			entry.pendingLevel = entry.wantedLevel;
+			pendingJobs++;
+
+			GLuint ID = entry.ID;
+			std::string path = entry.path;
+			int channels = entry.channels;
+			int width = entry.width;
+			int height = entry.height;
+			int firstLevel = entry.wantedLevel;
+			int lastLevel = entry.residentBase;
+			size_t size = 0;
+			for (int i = firstLevel; i < lastLevel; i++)
+			{
+				size += (size_t)levelSize(width, i) * levelSize(height, i) * channels;
+			}
+			auto fill = [path, channels, width, height, firstLevel, lastLevel](unsigned char* dst)
+			{
+				return decodeLevels(path, channels, width, height, firstLevel, lastLevel, dst);
+			};
+
+			if (uploader != nullptr)
+			{
+				// Workers decode straight into the uploader's staging memory
+				uploader->Stage(size, fill, [this, ID, firstLevel](const unsigned char* pixels, bool ok)
+				{
+					applyLevels(ID, firstLevel, pixels, ok);
+				});
+			}
+			else
+			{
+				workers.Submit([this, ID, firstLevel, size, fill]()
+				{
+					Result result{ ID, firstLevel, false, std::vector<unsigned char>(size) };
+					result.ok = fill(result.data.data());
+					std::lock_guard<std::mutex> lock(resultsMutex);
+					results.push_back(std::move(result));
+				});
+			}
+		}
+		// Every frame starts from the always resident mips again
+		entry.wantedLevel = entry.lowBase;
+	}
+	frame++;
+}
+
+// Uploads the mips a streaming job produced, finest first in pixels, within the budget
+void TextureStreamer::applyLevels(GLuint ID, int firstLevel, const unsigned char* pixels, bool ok)
+{
+	pendingJobs--;
+	auto it = entries.find(ID);
+	if (it == entries.end()) return;
+	Entry& entry = it->second;
+	entry.pendingLevel = -1;
+	// The file could not be read again, stop streaming this texture
+	if (!ok)
+	{
+		entry.lowBase = entry.residentBase;
+		return;
+	}
+
+	// Offsets of the mips in pixels, the job covered every mip up to the resident ones
+	std::vector<size_t> offsets(entry.residentBase - firstLevel + 1, 0);
+	for (int level = firstLevel; level < entry.residentBase; level++)
+	{
+		offsets[level - firstLevel + 1] = offsets[level - firstLevel] + (size_t)levelSize(entry.width, level) * levelSize(entry.height, level) * entry.channels;
+	}
+
+	// Uploads from coarse to fine so the resident mips always stay contiguous
+	int newBase = entry.residentBase;
+	for (int level = entry.residentBase - 1; level >= firstLevel; level--)
+	{
+		size_t bytes = (size_t)levelSize(entry.width, level) * levelSize(entry.height, level) * 4;
+		while (residentBytes + bytes > budgetBytes && evictOne(entry.ID)) {}
+		if (residentBytes + bytes > budgetBytes) break;
+
+		glBindTexture(GL_TEXTURE_2D, entry.ID);
+		uploadLevel(entry, level, pixels + offsets[level - firstLevel]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+		newBase = level;
+	}
+	entry.residentBase = newBase;
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Uploads one mip to the bound texture
+void TextureStreamer::uploadLevel(const Entry& entry, int level, const unsigned char* data)
+{
+	int w = levelSize(entry.width, level);
+	int h = levelSize(entry.height, level);
+	// Rows of the small RGB mips are not 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, w, h, 0, entry.format, GL_UNSIGNED_BYTE, data);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	residentBytes += (size_t)w * h * 4;
+}
+
+// Drops the finest resident mip of the least recently needed texture other than keep
+bool TextureStreamer::evictOne(GLuint keep)
+{
+	Entry* victim = nullptr;
+	for (auto& [id, entry] : entries)
+	{
+		if (id == keep || entry.pendingLevel >= 0 || entry.residentBase >= entry.lowBase) continue;
+		unsigned long long last = entry.lastNeeded[entry.residentBase];
+		// Never evict what is on screen right now
+		if (last >= frame) continue;
+		if (victim == nullptr || last < victim->lastNeeded[victim->residentBase]) victim = &entry;
+	}
+	if (victim == nullptr) return false;
+
+	int level = victim->residentBase;
+	glBindTexture(GL_TEXTURE_2D, victim->ID);
+	// Raising the base level first keeps the texture complete, then the mip's storage is released
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1);
+	glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, 0, 0, 0, victim->format, GL_UNSIGNED_BYTE, nullptr);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	victim->residentBase = level + 1;
+	residentBytes -= (size_t)levelSize(victim->width, level) * levelSize(victim->height, level) * 4;
+	return true;
+}
@@ -0,0 +1,101 @@
+#ifndef TEXTURE_STREAMER_CLASS_H
+#define TEXTURE_STREAMER_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<string>
+#include<vector>
+#include<unordered_map>
+#include<mutex>
+
+#include"Texture.h"
+#include"ThreadPool.h"
+
+class Camera;
+class Mesh;
+class RenderQueue;
+class TextureUploader;
+
+// Keeps only the mips that are big enough on screen resident, streaming finer mips in
+// on worker threads and evicting the least recently needed ones over the VRAM budget
+class TextureStreamer
+{
+public:
+	// Mips at or below this size in texels are loaded up front and never evicted
+	int residentSize = 128;
+	// Number of finished streaming jobs uploaded per frame
+	int uploadsPerFrame = 2;
+	// Number of streaming jobs that may be in flight at once
+	int maxPendingJobs = 8;
+	// Bytes of texture memory the streamed textures may use
+	size_t budgetBytes;
+	// Bytes of texture memory the streamed textures currently use
+	size_t residentBytes = 0;
+
+	// Constructor that sets the VRAM budget and starts the worker threads, streamed mips
+	// are staged through the uploader when one is given
+	TextureStreamer(size_t budgetBytes, unsigned int workers, TextureUploader* uploader = nullptr);
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	// Loads an image with only its low mips resident and registers it for streaming
+	Texture Load(const char* image, const char* texType, GLuint slot, GLenum format);
+	// Marks the mips the draws the queue accepted this frame need based on their size on screen,
+	// so meshes culled by the frustum, visible set, portals or occluders never keep their fine
+	// mips resident; call after every Submit of the frame and before Update
+	void Request(const RenderQueue& queue, const Camera& camera, float FOVdeg);
+	// Uploads streamed mips, starts new jobs and evicts mips over the budget
+	void Update();
+
+private:
+	// Marks the mips one mesh needs with its model matrix
+	void request(const Mesh& mesh, const glm::mat4& modelMatrix, const Camera& camera, float tanHalfFov);
+
+	struct Entry
+	{
+		std::string path;
+		GLuint ID;
+		int width;
+		int height;
+		int channels;
+		GLenum format;
+		int levels;
+		// Mips below this are not resident
+		int residentBase;
+		// Finest mip that is never evicted
+		int lowBase;
+		// Finest mip requested this frame
+		int wantedLevel;
+		// Mip a worker is currently producing, -1 when idle
+		int pendingLevel = -1;
+		// Frame in which each mip was last needed
+		std::vector<unsigned long long> lastNeeded;
+	};
+	struct Result
+	{
+		GLuint ID;
+		// Finest mip in data, the coarser ones follow in order
+		int firstLevel;
+		bool ok;
+		std::vector<unsigned char> data;
+	};
+
+	std::unordered_map<GLuint, Entry> entries;
+	unsigned long long frame = 1;
+	int pendingJobs = 0;
+	TextureUploader* uploader;
+
+	std::mutex resultsMutex;
+	std::vector<Result> results;
+	// Declared last so the workers are joined before the rest is destroyed
+	ThreadPool workers;
+
+	// Uploads the mips a streaming job produced, finest first in pixels, within the budget
+	void applyLevels(GLuint ID, int firstLevel, const unsigned char* pixels, bool ok);
+	// Uploads one mip to the bound texture
+	void uploadLevel(const Entry& entry, int level, const unsigned char* data);
+	// Drops the finest resident mip of the least recently needed texture other than keep
+	bool evictOne(GLuint keep);
+};
+
+#endif
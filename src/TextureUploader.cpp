@@ -0,0 +1,236 @@
+#include"TextureUploader.h"
+#include"CpuProfiler.h"
+#include"GLExtensions.h"
+#include"ImageDecoder.h"
+#include"Logger.h"
+#include<algorithm>
+#include<cmath>
+#include<cstdint>
+#include<string>
+
+// Constructor that maps the pixel buffer ring and starts the worker threads
+TextureUploader::TextureUploader(size_t ringBytes, unsigned int workers)
+	: ringBytes(ringBytes), workers(std::make_unique<ThreadPool>(workers))
+{
+	// Without buffer storage the workers stage into client memory instead
+	if (glExt.BufferStorage == nullptr) return;
+
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &PBO);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+	glExt.BufferStorage(GL_PIXEL_UNPACK_BUFFER, ringBytes, nullptr, flags);
+	mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, ringBytes, flags);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (mapped == nullptr)
+	{
+		glDeleteBuffers(1, &PBO);
+		PBO = 0;
+	}
+}
+
+// Waits for the workers, the GL objects are released by Delete
+TextureUploader::~TextureUploader()
+{
+	workers.reset();
+}
+
+// Creates a texture with immutable storage and fills it once a worker has decoded the image
+Texture TextureUploader::Load(const char* image, const char* texType, GLuint slot, GLenum format)
+{
+	Texture texture;
+	texture.type = texType;
+	texture.unit = slot;
+
+	// Only the header is read here, the pixels are decoded on a worker
+	ImageInfo info;
+	if (!DefaultImageDecoder().Info(image, info))
+	{
+		LOG_WARNING("Failed to load texture: %s", image);
+		return texture;
+	}
+	int width = info.width;
+	int height = info.height;
+	int levels = 1 + (int)std::floor(std::log2((float)std::max(width, height)));
+
+	glGenTextures(1, &texture.ID);
+	glActiveTexture(GL_TEXTURE0 + slot);
+	glBindTexture(GL_TEXTURE_2D, texture.ID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	if (glExt.TexStorage2D != nullptr)
+	{
+		glExt.TexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8, width, height);
+	}
+	else
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, format, GL_UNSIGNED_BYTE, nullptr);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	std::string path = image;
+	GLuint ID = texture.ID;
+	int channels = format == GL_RGB ? 3 : 4;
+	size_t size = (size_t)width * height * channels;
+	Stage(size,
+		[path, channels, size](unsigned char* dst)
+		{
+			return DefaultImageDecoder().Decode(path.c_str(), channels, true, dst, size);
+		},
+		[ID, width, height, format, path](const unsigned char* pixels, bool ok)
+		{
+			if (!ok)
+			{
+				LOG_WARNING("Failed to load texture: %s", path.c_str());
+				return;
+			}
+			glBindTexture(GL_TEXTURE_2D, ID);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, pixels);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			glGenerateMipmap(GL_TEXTURE_2D);
+			glBindTexture(GL_TEXTURE_2D, 0);
+		});
+	return texture;
+}
+
+// Runs fill on a worker with size bytes of staging memory, then upload on the GL thread
+void TextureUploader::Stage(size_t size, std::function<bool(unsigned char* dst)> fill, std::function<void(const unsigned char* pixels, bool ok)> upload)
+{
+	auto staging = std::make_unique<Staging>();
+	staging->size = size;
+	staging->upload = std::move(upload);
+
+	unsigned char* dst;
+	bool inRing = mapped != nullptr && allocate(size, staging->offset);
+	if (inRing)
+	{
+		dst = mapped + staging->offset;
+	}
+	else
+	{
+		// Images larger than the ring, or staged while it is full, go through client memory
+		staging->memory.resize(size);
+		dst = staging->memory.data();
+	}
+
+	Staging* state = staging.get();
+	(inRing ? ring : client).push_back(std::move(staging));
+	workers->Submit([state, dst, fill = std::move(fill)]()
+	{
+		bool ok = fill(dst);
+		state->state.store(ok ? 1 : 2, std::memory_order_release);
+	});
+}
+
+// Issues the copies of staged pixels that are ready and recycles the ring space the GPU is done with
+void TextureUploader::Update()
+{
+	size_t copied = 0;
+	if (PBO != 0)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+		for (auto& staging : ring)
+		{
+			if (copied >= uploadBytesPerFrame) break;
+			if (!staging->copied && staging->state.load(std::memory_order_acquire) != 0) copied += copy(*staging, true);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	for (auto it = client.begin(); it != client.end() && copied < uploadBytesPerFrame;)
+	{
+		if ((*it)->state.load(std::memory_order_acquire) != 0)
+		{
+			copied += copy(**it, false);
+			it = client.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	// Ring space is reused in allocation order once the GPU has finished reading it
+	while (!ring.empty() && ring.front()->copied)
+	{
+		GLsync fence = ring.front()->fence;
+		if (fence != 0)
+		{
+			if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) break;
+			glDeleteSync(fence);
+		}
+		ring.pop_front();
+	}
+}
+
+// Waits for the workers and releases the ring
+void TextureUploader::Delete()
+{
+	workers.reset();
+	for (auto& staging : ring)
+	{
+		if (staging->fence != 0) glDeleteSync(staging->fence);
+	}
+	ring.clear();
+	client.clear();
+	if (PBO != 0)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &PBO);
+		PBO = 0;
+		mapped = nullptr;
+	}
+}
+
+// Finds room for size bytes in the ring
+bool TextureUploader::allocate(size_t size, size_t& offset)
+{
+	// Keeps every staging aligned for any pixel type
+	size = (size + 63) & ~(size_t)63;
+	if (size > ringBytes) return false;
+	if (ring.empty()) head = 0;
+
+	size_t tail = ring.empty() ? 0 : ring.front()->offset;
+	bool wrapped = !ring.empty() && head <= tail;
+	if (!wrapped)
+	{
+		// Free space runs from head to the end and from the start to tail
+		if (head + size <= ringBytes)
+		{
+			offset = head;
+		}
+		else if (size <= tail)
+		{
+			offset = 0;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	else
+	{
+		// Free space runs from head to tail
+		if (head + size > tail) return false;
+		offset = head;
+	}
+	head = offset + size;
+	return true;
+}
+
+// Issues the copy of a filled staging, returns the bytes copied
+size_t TextureUploader::copy(Staging& staging, bool inRing)
+{
+	PROFILE_ZONE("Texture upload");
+	staging.copied = true;
+	bool ok = staging.state.load(std::memory_order_acquire) == 1;
+	// With the pixel unpack buffer bound the pointer is an offset into it
+	const unsigned char* pixels = inRing ? reinterpret_cast<const unsigned char*>((uintptr_t)staging.offset) : staging.memory.data();
+	staging.upload(pixels, ok);
+	if (inRing && ok) staging.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	return ok ? staging.size : 0;
+}
@@ -0,0 +1,73 @@
+#ifndef TEXTURE_UPLOADER_CLASS_H
+#define TEXTURE_UPLOADER_CLASS_H
+
+#include<glad/glad.h>
+#include<atomic>
+#include<deque>
+#include<functional>
+#include<memory>
+#include<vector>
+
+#include"Texture.h"
+#include"ThreadPool.h"
+
+// Uploads textures without stalling the GL thread: worker threads decode straight into a
+// persistently mapped pixel buffer ring and the GL thread only issues the copies, recycling
+// ring space once a fence shows the GPU has read it
+class TextureUploader
+{
+public:
+	// Bytes of staged pixels copied to textures per frame, at least one copy always goes through
+	size_t uploadBytesPerFrame = 32 * 1024 * 1024;
+
+	// Constructor that maps the pixel buffer ring and starts the worker threads
+	TextureUploader(size_t ringBytes, unsigned int workers);
+	// Waits for the workers, the GL objects are released by Delete
+	~TextureUploader();
+	TextureUploader(const TextureUploader&) = delete;
+	TextureUploader& operator=(const TextureUploader&) = delete;
+
+	// Creates a texture with immutable storage and fills it once a worker has decoded the image
+	Texture Load(const char* image, const char* texType, GLuint slot, GLenum format);
+	// Runs fill on a worker with size bytes of staging memory, then upload on the GL thread with
+	// the pixel unpack buffer bound and the address to pass to glTex(Sub)Image, or ok false if fill failed
+	void Stage(size_t size, std::function<bool(unsigned char* dst)> fill, std::function<void(const unsigned char* pixels, bool ok)> upload);
+	// Issues the copies of staged pixels that are ready and recycles the ring space the GPU is done with
+	void Update();
+	// Waits for the workers and releases the ring, call while the context is current
+	void Delete();
+	// Whether staging goes through the persistently mapped ring, otherwise through client memory
+	bool Persistent() const { return mapped != nullptr; }
+
+private:
+	struct Staging
+	{
+		// Offset in the ring, unused when staged in client memory
+		size_t offset = 0;
+		size_t size = 0;
+		// Client memory used when the ring is unavailable or full
+		std::vector<unsigned char> memory;
+		std::function<void(const unsigned char*, bool)> upload;
+		// 0 while the worker fills it, 1 once filled, 2 if filling failed
+		std::atomic<int> state{ 0 };
+		bool copied = false;
+		GLsync fence = 0;
+	};
+
+	GLuint PBO = 0;
+	unsigned char* mapped = nullptr;
+	size_t ringBytes;
+	size_t head = 0;
+	// Ring allocations in the order they were made, retired in that order
+	std::deque<std::unique_ptr<Staging>> ring;
+	// Stagings in client memory, retired as soon as they are copied
+	std::deque<std::unique_ptr<Staging>> client;
+	std::unique_ptr<ThreadPool> workers;
+
+	// Finds room for size bytes in the ring
+	bool allocate(size_t size, size_t& offset);
+	// Issues the copy of a filled staging, returns the bytes copied
+	size_t copy(Staging& staging, bool inRing);
+};
+
+#endif
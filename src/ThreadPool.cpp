@@ -0,0 +1,54 @@
+#include"ThreadPool.h"
+#include"CpuProfiler.h"
+
+// Constructor that starts the worker threads
+ThreadPool::ThreadPool(unsigned int threads)
+{
+	if (threads == 0) threads = 1;
+	for (unsigned int i = 0; i < threads; i++)
+	{
+		workers.emplace_back(&ThreadPool::work, this);
+	}
+}
+
+// Finishes the queued jobs and joins the workers
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+// Queues a job to run on one of the workers
+void ThreadPool::Submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push(std::move(job));
+	}
+	wake.notify_one();
+}
+
+// Loop run by every worker thread
+void ThreadPool::work()
+{
+	PROFILE_THREAD("Worker");
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+			if (jobs.empty()) return;
+			job = std::move(jobs.front());
+			jobs.pop();
+		}
+		job();
+	}
+}
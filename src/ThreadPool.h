@@ -0,0 +1,37 @@
+#ifndef THREAD_POOL_CLASS_H
+#define THREAD_POOL_CLASS_H
+
+#include<vector>
+#include<queue>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<functional>
+
+class ThreadPool
+{
+public:
+	// Constructor that starts the worker threads
+	ThreadPool(unsigned int threads);
+	// Finishes the queued jobs and joins the workers
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Queues a job to run on one of the workers
+	void Submit(std::function<void()> job);
+	// Number of worker threads
+	unsigned int Size() const { return (unsigned int)workers.size(); }
+private:
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+
+	// Loop run by every worker thread
+	void work();
+};
+
+#endif
@@ -0,0 +1,40 @@
+#include"UBO.h"
+
+// Constructor that generates a Uniform Buffer Object and attaches it to a binding point
+UBO::UBO(GLsizeiptr size, GLuint binding)
+	: size(size)
+{
+	glGenBuffers(1, &ID);
+	glBindBuffer(GL_UNIFORM_BUFFER, ID);
+	glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+// Replaces the whole contents of the UBO
+void UBO::Update(const void* data)
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, ID);
+	// Orphans the old storage so the driver doesn't wait for draws still reading it
+	glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+// Binds the UBO
+void UBO::Bind()
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, ID);
+}
+
+// Unbinds the UBO
+void UBO::Unbind()
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+// Deletes the UBO
+void UBO::Delete()
+{
+	glDeleteBuffers(1, &ID);
+}
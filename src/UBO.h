@@ -0,0 +1,26 @@
+#ifndef UBO_CLASS_H
+#define UBO_CLASS_H
+
+#include<glad/glad.h>
+
+class UBO
+{
+public:
+	// Reference ID of the Uniform Buffer Object
+	GLuint ID;
+	// Size of the buffer in bytes
+	GLsizeiptr size;
+	// Constructor that generates a Uniform Buffer Object and attaches it to a binding point
+	UBO(GLsizeiptr size, GLuint binding);
+
+	// Replaces the whole contents of the UBO
+	void Update(const void* data);
+	// Binds the UBO
+	void Bind();
+	// Unbinds the UBO
+	void Unbind();
+	// Deletes the UBO
+	void Delete();
+};
+
+#endif
@@ -8,6 +8,14 @@ VBO::VBO(std::vector<Vertex>& vertices)
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
 }
 
+// Constructor that generates a Vertex Buffer Object holding only positions
+VBO::VBO(std::vector<glm::vec3>& positions)
+{
+    glGenBuffers(1, &ID);
+    glBindBuffer(GL_ARRAY_BUFFER, ID);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+}
+
 // Binds the VBO
 void VBO::Bind()
 {
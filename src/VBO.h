@@ -23,6 +23,8 @@ public:
 	GLuint ID;
 	// Constructor that generates a Vertex Buffer Object and links it to vertices
 	VBO(std::vector<Vertex>& vertices);
+	// Constructor that generates a Vertex Buffer Object holding only positions
+	VBO(std::vector<glm::vec3>& positions);
 
 	// Binds the VBO
 	void Bind();
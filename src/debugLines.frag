@@ -1,5 +1,6 @@
 #version 330 core
+in vec4 color;
 out vec4 FragColor;
 void main() {
-    FragColor = vec4(1,0,0,1); // Red
-}
\ No newline at end of file
+    FragColor = color;
+}
@@ -0,0 +1,10 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec4 aColor;
+#include "frameData.glsl"
+out vec4 color;
+void main() {
+    // Lines are already in world space
+    color = aColor;
+    gl_Position = camMatrix * vec4(aPos, 1.0);
+}
@@ -16,30 +16,44 @@ in vec2 texCoord;
 // Gets the Texture Units from the main function
 uniform sampler2D diffuse0;
 uniform sampler2D specular0;
-// Gets the color of the light from the main function
-uniform vec4 lightColor;
-uniform vec4 lightColor2;
-// Gets the position of the light from the main function
-uniform vec3 lightPos;
-uniform vec3 lightPos2;
-uniform vec3 lampPos;
-// Gets the position of the camera from the main function
-uniform vec3 camPos;
-// Gets the direction of the spotlight from the main function
-uniform vec3 spotDirection;
-uniform vec3 spotDirection2;
-// Gets the position of the lamp from the main function
-uniform float time;
-uniform int isOn; // 0 = off, 1 = on
+#ifdef CLUSTERED_LIGHTS
+// Lights of the scene, three texels each: position and radius, color and intensity, direction and cone
+uniform samplerBuffer lightData;
+// Offset into lightIndices and number of lights of each cluster
+uniform usamplerBuffer lightGrid;
+// Lights of every cluster, one list after the other
+uniform usamplerBuffer lightIndices;
+#endif
+#include "frameData.glsl"
+
+// Compiled in variants by ShaderVariants, see DefaultFeature:
+// FLASHLIGHT       the camera's spot light
+// HAS_SPECULAR     the mesh has a specular map, otherwise nothing is specular
+// YELLOW_ROOM      the mesh reaches into the yellow room and its flickering lamp
+// CLUSTERED_LIGHTS the lights binned by ClusteredLights
+
+// Specular map of the mesh
+float specularMap()
+{
+#ifdef HAS_SPECULAR
+	return texture(specular0, texCoord).r;
+#else
+	return 0.0f;
+#endif
+}
 
+// Rectangles of the yellow room as min x, max x, min z, max z, defined by YellowRoomRects in
+// ShaderVariants.cpp so the CPU picks the YELLOW_ROOM variant from the same ones
+const vec4 yellowRoomRects[] = vec4[](YELLOW_ROOM_RECTS);
 
 bool inYellowRoom(vec3 pos)
 {
-    // First rectangle: from (-5, *, 1) to (9, *, 6)
-    bool inRect1 = (pos.x >= -5.0 && pos.x <= 9.0) && (pos.z >= 1.0 && pos.z <= 6.0);
-    // Second rectangle: from (-5, *, -9) to (0, *, 6)
-    bool inRect2 = (pos.x >= -5.0 && pos.x <= 0.0) && (pos.z >= -9.0 && pos.z <= 6.0);
-    return inRect1 || inRect2;
+    for (int i = 0; i < yellowRoomRects.length(); i++)
+    {
+        vec4 rect = yellowRoomRects[i];
+        if (pos.x >= rect.x && pos.x <= rect.y && pos.z >= rect.z && pos.z <= rect.w) return true;
+    }
+    return false;
 }
 
 // Simple hash function for pseudo-randomness
@@ -79,7 +93,7 @@ vec4 pointLight()
 	float specAmount = pow(max(dot(viewDirection, reflectionDirection), 0.0f), 4);
 	float specular = specAmount * specularLight;
 
-	return (texture(diffuse0, texCoord) * (diffuse * inten + ambient) + texture(specular0, texCoord).r * specular * inten) * lightColor2;
+	return (texture(diffuse0, texCoord) * (diffuse * inten + ambient) + specularMap() * specular * inten) * lightColor2;
 }
 
 vec4 direcLight()
@@ -99,7 +113,7 @@ vec4 direcLight()
 	float specAmount = pow(max(dot(viewDirection, reflectionDirection), 0.0f), 16);
 	float specular = specAmount * specularLight;
 
-	return (texture(diffuse0, texCoord) * (diffuse + ambient) + texture(specular0, texCoord).r * specular) * lightColor;
+	return (texture(diffuse0, texCoord) * (diffuse + ambient) + specularMap() * specular) * lightColor;
 }
 
 vec4 spotLight()
@@ -127,7 +141,7 @@ vec4 spotLight()
 	float angle = dot(normalize(spotDirection), -lightDirection);
 	float inten = clamp((angle - outerCone) / (innerCone - outerCone), 0.0f, 1.0f);
 
-	return (texture(diffuse0, texCoord) * (diffuse * inten + ambient) + texture(specular0, texCoord).r * specular * inten) * lightColor;
+	return (texture(diffuse0, texCoord) * (diffuse * inten + ambient) + specularMap() * specular * inten) * lightColor;
 }
 
 vec4 yellowSpotLight(float amb)
@@ -170,13 +184,68 @@ vec4 yellowSpotLight(float amb)
     float specular = specAmount * specularLight;
 
     return (texture(diffuse0, texCoord) * (diffuse * inten * coneIntensity * lampFactor + ambient) +
-            texture(specular0, texCoord).r * specular * inten * coneIntensity * lampFactor) * lightColor2;
+            specularMap() * specular * inten * coneIntensity * lampFactor) * lightColor2;
 }
 
-void main()
+#ifdef CLUSTERED_LIGHTS
+vec4 clusteredLights()
 {
-    FragColor = spotLight()*isOn;
+	if (clusterGrid.w == 0u) return vec4(0.0f);
+
+	// Finds the cluster of this fragment from its tile on screen and its depth slice
+	float viewDepth = max(dot(crntPos - camPos, camForward), 1e-4);
+	uint slice = uint(clamp(floor(log(viewDepth) * clusterParams.x + clusterParams.y), 0.0, float(clusterGrid.z - 1u)));
+	uvec2 tile = min(uvec2(gl_FragCoord.xy / clusterParams.zw), clusterGrid.xy - 1u);
+	uvec2 range = texelFetch(lightGrid, int(tile.x + clusterGrid.x * (tile.y + clusterGrid.y * slice))).xy;
 
+	vec3 normal = normalize(Normal);
+	vec3 viewDirection = normalize(camPos - crntPos);
+	vec4 albedo = texture(diffuse0, texCoord);
+	float specularAmount = specularMap();
+	vec4 result = vec4(0.0f);
+	for (uint i = 0u; i < range.y; i++)
+	{
+		int light = int(texelFetch(lightIndices, int(range.x + i)).r) * 3;
+		vec4 positionRadius = texelFetch(lightData, light);
+		vec4 colorIntensity = texelFetch(lightData, light + 1);
+		vec4 directionCone = texelFetch(lightData, light + 2);
+
+		vec3 lightVec = positionRadius.xyz - crntPos;
+		float dist = length(lightVec);
+		if (dist >= positionRadius.w) continue;
+		vec3 lightDirection = lightVec / dist;
+
+		// falls off with the square of the distance and reaches zero at the radius
+		float window = clamp(1.0f - pow(dist / positionRadius.w, 4.0f), 0.0f, 1.0f);
+		float inten = window * window / (dist * dist + 1.0f);
+		// spot lights fade out over the outer tenth of their cone
+		if (directionCone.w > -1.0f)
+		{
+			float angle = dot(directionCone.xyz, -lightDirection);
+			inten *= clamp((angle - directionCone.w) / ((1.0f - directionCone.w) * 0.1f), 0.0f, 1.0f);
+		}
+
+		float diffuse = max(dot(normal, lightDirection), 0.0f);
+		vec3 reflectionDirection = reflect(-lightDirection, normal);
+		float specular = pow(max(dot(viewDirection, reflectionDirection), 0.0f), 16) * 0.50f;
+
+		result += (albedo * diffuse + specularAmount * specular) * inten * vec4(colorIntensity.rgb * colorIntensity.a, 1.0f);
+	}
+	return result;
+}
+#endif
+
+void main()
+{
+    FragColor = vec4(0.0f);
+#ifdef FLASHLIGHT
+    FragColor += spotLight();
+#endif
+#ifdef CLUSTERED_LIGHTS
+    FragColor += clusteredLights();
+#endif
+
+#ifdef YELLOW_ROOM
     // Flicker: randomly enable/disable yellow light based on time
     float flickerSeed = floor(time * 5.0); // Flicker speed (increase for faster flicker)
     if (rand(flickerSeed) > 0.3) {
@@ -187,4 +256,5 @@ void main()
             FragColor += yellowSpotLight(0.60);
         }
     }
+#endif
 }
\ No newline at end of file
@@ -20,11 +20,14 @@ out vec3 color;
 out vec2 texCoord;
 
 
+// Matches the depth pre-pass exactly so the GL_EQUAL test passes
+invariant gl_Position;
 
-// Imports the camera matrix from the main function
-uniform mat4 camMatrix;
+#include "frameData.glsl"
 // Imports the model matrix from the main function
 uniform mat4 model;
+// Inverse transpose of the model matrix, computed once per object on the CPU
+uniform mat3 normalMatrix;
 
 
 void main()
@@ -32,7 +35,12 @@ void main()
 	// calculates current position
 	crntPos = vec3(model * vec4(aPos, 1.0f));
 	// Assigns the normal from the Vertex Data to "Normal"
+#ifdef NORMAL_MATRIX_IN_SHADER
+	// Old path, inverts the model matrix for every vertex, kept for the vertex benchmark
 	Normal = mat3(transpose(inverse(model))) * aNormal;
+#else
+	Normal = normalMatrix * aNormal;
+#endif
 	// Assigns the colors from the Vertex Data to "color"
 	color = aColor;
 	// Assigns the texture coordinates from the Vertex Data to "texCoord"
@@ -0,0 +1,6 @@
+#version 330 core
+
+// Color writes are masked during the depth pre-pass, only the depth is kept
+void main()
+{
+}
@@ -0,0 +1,18 @@
+#version 330 core
+
+// Positions only, from each mesh's tightly packed position stream, for the depth pre-pass.
+// gl_Position must come out bit for bit the same as in default.vert for GL_EQUAL to pass.
+layout (location = 0) in vec3 aPos;
+
+invariant gl_Position;
+
+#include "frameData.glsl"
+// Imports the model matrix from the main function
+uniform mat4 model;
+
+
+void main()
+{
+	vec3 crntPos = vec3(model * vec4(aPos, 1.0f));
+	gl_Position = camMatrix * vec4(crntPos, 1.0);
+}
\ No newline at end of file
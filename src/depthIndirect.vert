@@ -0,0 +1,30 @@
+#version 430 core
+
+// Same as depth.vert for meshes drawn from the shared geometry buffer, the model matrix comes
+// from the per-draw data like in indirect.vert
+layout (location = 0) in vec3 aPos;
+// Index of the draw in DrawBuffer, set through each command's base instance
+layout (location = 4) in uint aDrawID;
+
+invariant gl_Position;
+
+#include "frameData.glsl"
+// Per-draw data, mirrors GeometryBuffer::DrawData
+struct DrawData
+{
+	mat4 model;
+	// Inverse transpose of the model matrix in the upper 3x3
+	mat4 normalMatrix;
+};
+layout (std430, binding = 1) readonly buffer DrawBuffer
+{
+	DrawData draws[];
+};
+
+
+void main()
+{
+	mat4 model = draws[aDrawID].model;
+	vec3 crntPos = vec3(model * vec4(aPos, 1.0f));
+	gl_Position = camMatrix * vec4(crntPos, 1.0);
+}
@@ -0,0 +1,19 @@
+// Camera and lighting state shared by every draw of the frame, mirrors FrameUniforms.h.
+// Pulled into the shaders by #include "frameData.glsl", which the shader loader expands.
+layout (std140) uniform FrameData
+{
+	mat4 camMatrix;
+	vec3 camPos;
+	float time;
+	vec4 lightColor;
+	vec4 lightColor2;
+	vec3 lightPos;
+	int isOn; // 0 = off, 1 = on
+	vec3 spotDirection;
+	vec3 lightPos2;
+	vec3 spotDirection2;
+	vec3 lampPos;
+	vec3 camForward;
+	vec4 clusterParams;
+	uvec4 clusterGrid;
+};
@@ -0,0 +1,60 @@
+#version 430 core
+
+// Same inputs and outputs as default.vert, for meshes drawn from the shared geometry buffer
+// with glMultiDrawElementsIndirect, so the model matrix comes from the per-draw data
+
+// Positions/Coordinates
+layout (location = 0) in vec3 aPos;
+// Normals (not necessarily normalized)
+layout (location = 1) in vec3 aNormal;
+// Colors
+layout (location = 2) in vec3 aColor;
+// Texture Coordinates
+layout (location = 3) in vec2 aTex;
+// Index of the draw in DrawBuffer, set through each command's base instance
+layout (location = 4) in uint aDrawID;
+
+
+// Outputs the current position for the Fragment Shader
+out vec3 crntPos;
+// Outputs the normal for the Fragment Shader
+out vec3 Normal;
+// Outputs the color for the Fragment Shader
+out vec3 color;
+// Outputs the texture coordinates to the Fragment Shader
+out vec2 texCoord;
+
+
+// Matches the depth pre-pass exactly so the GL_EQUAL test passes
+invariant gl_Position;
+
+#include "frameData.glsl"
+// Per-draw data, mirrors GeometryBuffer::DrawData
+struct DrawData
+{
+	mat4 model;
+	// Inverse transpose of the model matrix in the upper 3x3
+	mat4 normalMatrix;
+};
+layout (std430, binding = 1) readonly buffer DrawBuffer
+{
+	DrawData draws[];
+};
+
+
+void main()
+{
+	mat4 model = draws[aDrawID].model;
+	mat3 normalMatrix = mat3(draws[aDrawID].normalMatrix);
+	// calculates current position
+	crntPos = vec3(model * vec4(aPos, 1.0f));
+	// Assigns the normal from the Vertex Data to "Normal"
+	Normal = normalMatrix * aNormal;
+	// Assigns the colors from the Vertex Data to "color"
+	color = aColor;
+	// Assigns the texture coordinates from the Vertex Data to "texCoord"
+	texCoord = aTex;
+	
+	// Outputs the positions/coordinates of all vertices
+	gl_Position = camMatrix * vec4(crntPos, 1.0);
+}
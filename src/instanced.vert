@@ -0,0 +1,47 @@
+#version 330 core
+
+// Same as default.vert, for crowds drawn with one instanced draw per mesh
+
+// Positions/Coordinates
+layout (location = 0) in vec3 aPos;
+// Normals (not necessarily normalized)
+layout (location = 1) in vec3 aNormal;
+// Colors
+layout (location = 2) in vec3 aColor;
+// Texture Coordinates
+layout (location = 3) in vec2 aTex;
+// Model matrix of the instance, takes locations 5 to 8
+layout (location = 5) in mat4 aInstanceModel;
+// Inverse transpose of the model matrix of the instance, takes locations 9 to 11
+layout (location = 9) in mat3 aInstanceNormal;
+
+
+// Outputs the current position for the Fragment Shader
+out vec3 crntPos;
+// Outputs the normal for the Fragment Shader
+out vec3 Normal;
+// Outputs the color for the Fragment Shader
+out vec3 color;
+// Outputs the texture coordinates to the Fragment Shader
+out vec2 texCoord;
+
+
+
+#include "frameData.glsl"
+
+
+void main()
+{
+	mat4 model = aInstanceModel;
+	// calculates current position
+	crntPos = vec3(model * vec4(aPos, 1.0f));
+	// Assigns the normal from the Vertex Data to "Normal"
+	Normal = aInstanceNormal * aNormal;
+	// Assigns the colors from the Vertex Data to "color"
+	color = aColor;
+	// Assigns the texture coordinates from the Vertex Data to "texCoord"
+	texCoord = aTex;
+	
+	// Outputs the positions/coordinates of all vertices
+	gl_Position = camMatrix * vec4(crntPos, 1.0);
+}
\ No newline at end of file
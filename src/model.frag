@@ -6,9 +6,7 @@ in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoord;
 
-uniform vec4 lightColor;
-uniform vec3 lightPos;
-uniform vec3 camPos;
+#include "frameData.glsl"
 
 void main()
 {
@@ -9,12 +9,14 @@ out vec3 Normal;
 out vec2 TexCoord;
 
 uniform mat4 model;
-uniform mat4 camMatrix;
+// Inverse transpose of the model matrix, computed once per object on the CPU
+uniform mat3 normalMatrix;
+#include "frameData.glsl"
 
 void main()
 {
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    Normal = normalMatrix * aNormal;
     TexCoord = aTexCoord;
     
     gl_Position = camMatrix * vec4(FragPos, 1.0);
@@ -1,4 +1,19 @@
 #include"shaderClass.h"
+#include"FrameUniforms.h"
+#include"GLExtensions.h"
+#include"Logger.h"
+#include<algorithm>
+#include<cassert>
+#include<cstdint>
+#include<cstdio>
+#include<cstring>
+#include<filesystem>
+#include<glm/gtc/type_ptr.hpp>
+
+unsigned int Shader::uploads = 0;
+std::string Shader::binaryCache = "shadercache";
+unsigned int Shader::cachedPrograms = 0;
+unsigned int Shader::compiledPrograms = 0;
 
 // Reads a text file and outputs a string with everything in the text file
 std::string get_file_contents(const char* filename)
@@ -17,54 +32,235 @@ std::string get_file_contents(const char* filename)
 	throw(errno);
 }
 
-// Constructor that build the Shader Program from 2 different shaders
-Shader::Shader(const char* vertexFile, const char* fragmentFile)
+// Replaces every #include "file" line with the contents of that file, found next to the shader
+// including it, so declarations shared by several shaders like the FrameData block live in one place
+static std::string expandIncludes(const std::string& code, const std::filesystem::path& directory, int depth = 0)
+{
+	std::string expanded;
+	size_t start = 0;
+	while (start < code.size())
+	{
+		size_t end = code.find('\n', start);
+		if (end == std::string::npos) end = code.size();
+		std::string line = code.substr(start, end - start);
+		size_t first = line.find_first_not_of(" \t");
+		size_t open = line.find('"');
+		size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+		if (first != std::string::npos && line.compare(first, 8, "#include") == 0 && close != std::string::npos && depth < 8)
+		{
+			std::filesystem::path included = directory / line.substr(open + 1, close - open - 1);
+			expanded += expandIncludes(get_file_contents(included.string().c_str()), included.parent_path(), depth + 1);
+			if (!expanded.empty() && expanded.back() != '\n') expanded += '\n';
+		}
+		else
+		{
+			expanded += line;
+			if (end < code.size()) expanded += '\n';
+		}
+		start = end + 1;
+	}
+	return expanded;
+}
+
+// Inserts defines after the #version line, which must stay first
+static std::string insertDefines(const std::string& code, const std::string& defines)
+{
+	if (defines.empty()) return code;
+	size_t version = code.find("#version");
+	size_t line = version == std::string::npos ? 0 : code.find('\n', version);
+	if (line == std::string::npos) return code + "\n" + defines;
+	if (version != std::string::npos) line++;
+	return code.substr(0, line) + defines + (defines.back() == '\n' ? "" : "\n") + code.substr(line);
+}
+
+// 64 bit FNV-1a hash of a string
+static uint64_t hashString(const std::string& text)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (unsigned char c : text)
+	{
+		hash ^= c;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// Vendor, renderer and version of the driver, a binary is only valid for the one that saved it
+static const std::string& driverName()
+{
+	static const std::string name = std::string((const char*)glGetString(GL_VENDOR)) + "|"
+		+ (const char*)glGetString(GL_RENDERER) + "|" + (const char*)glGetString(GL_VERSION);
+	return name;
+}
+
+// Constructor that build the Shader Program from 2 different shaders, with defines
+Shader::Shader(const char* vertexFile, const char* fragmentFile, const std::string& defines, bool wait)
 {
 	// Read vertexFile and fragmentFile and store the strings
-	std::string vertexCode = get_file_contents(vertexFile);
-	std::string fragmentCode = get_file_contents(fragmentFile);
+	std::string vertexCode = insertDefines(expandIncludes(get_file_contents(vertexFile), std::filesystem::path(vertexFile).parent_path()), defines);
+	std::string fragmentCode = insertDefines(expandIncludes(get_file_contents(fragmentFile), std::filesystem::path(fragmentFile).parent_path()), defines);
+
+	if (!binaryCache.empty() && glExt.ProgramBinary != nullptr)
+	{
+		binaryKey = vertexCode + '\0' + fragmentCode + '\0' + driverName();
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hashString(binaryKey));
+		binaryFile = binaryCache + "/" + name;
+		if (loadBinary())
+		{
+			cachedPrograms++;
+			Finish();
+			return;
+		}
+	}
 
 	// Convert the shader source strings into character arrays
 	const char* vertexSource = vertexCode.c_str();
 	const char* fragmentSource = fragmentCode.c_str();
 
 	// Create Vertex Shader Object and get its reference
-	GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+	vertexShader = glCreateShader(GL_VERTEX_SHADER);
 	// Attach Vertex Shader source to the Vertex Shader Object
 	glShaderSource(vertexShader, 1, &vertexSource, NULL);
 	// Compile the Vertex Shader into machine code
 	glCompileShader(vertexShader);
-	// Checks if Shader compiled succesfully
-	compileErrors(vertexShader, "VERTEX");
 
 	// Create Fragment Shader Object and get its reference
-	GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+	fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
 	// Attach Fragment Shader source to the Fragment Shader Object
 	glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
 	// Compile the Vertex Shader into machine code
 	glCompileShader(fragmentShader);
-	// Checks if Shader compiled succesfully
-	compileErrors(fragmentShader, "FRAGMENT");
 
 	// Create Shader Program Object and get its reference
 	ID = glCreateProgram();
 	// Attach the Vertex and Fragment Shaders to the Shader Program
 	glAttachShader(ID, vertexShader);
 	glAttachShader(ID, fragmentShader);
+	// Asks the driver to keep the binary around for the cache
+	if (!binaryFile.empty() && glExt.ProgramParameteri != nullptr) glExt.ProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	// Wrap-up/Link all the shaders together into the Shader Program
 	glLinkProgram(ID);
-	// Checks if Shaders linked succesfully
-	compileErrors(ID, "PROGRAM");
+	compiledPrograms++;
+
+	// Querying the status waits for the driver, so that is left to Finish
+	if (wait) Finish();
+}
+
+// Whether Finish would return without waiting for the driver
+bool Shader::Ready() const
+{
+	if (finished || glExt.MaxShaderCompilerThreadsKHR == nullptr) return true;
+	GLint done = GL_TRUE;
+	glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+	return done == GL_TRUE;
+}
+
+// Waits for the compilation, reports errors, saves the binary and reads the uniforms
+void Shader::Finish()
+{
+	if (finished) return;
+	finished = true;
 
-	// Delete the now useless Vertex and Fragment Shader objects
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+	if (vertexShader != 0)
+	{
+		// Checks if Shaders compiled and linked succesfully
+		compileErrors(vertexShader, "VERTEX");
+		compileErrors(fragmentShader, "FRAGMENT");
+		compileErrors(ID, "PROGRAM");
+		GLint linked = GL_FALSE;
+		glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+		if (linked == GL_TRUE && !binaryFile.empty()) saveBinary();
+
+		// Delete the now useless Vertex and Fragment Shader objects
+		glDetachShader(ID, vertexShader);
+		glDetachShader(ID, fragmentShader);
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+		vertexShader = 0;
+		fragmentShader = 0;
+	}
 
+	// Looks up every uniform once so drawing never asks the driver by name
+	reflectUniforms();
+	// Connects the per-frame camera and lighting block to its uniform buffer
+	GLuint frameBlock = glGetUniformBlockIndex(ID, "FrameData");
+	if (frameBlock != GL_INVALID_INDEX) glUniformBlockBinding(ID, frameBlock, FRAME_UNIFORMS_BINDING);
+}
+
+// Whether the program linked, waits for the compilation
+bool Shader::Linked()
+{
+	Finish();
+	GLint linked = GL_FALSE;
+	glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+	return linked == GL_TRUE;
+}
+
+// Links the program from the binary saved for these sources, false if there is none or the driver rejects it
+bool Shader::loadBinary()
+{
+	// The key, its length first, then the binary format and the binary
+	std::ifstream in(binaryFile, std::ios::binary | std::ios::ate);
+	if (!in) return false;
+	std::streamoff size = in.tellg();
+	uint64_t keyLength = 0;
+	in.seekg(0, std::ios::beg);
+	in.read((char*)&keyLength, sizeof(keyLength));
+	std::streamoff header = (std::streamoff)(sizeof(keyLength) + sizeof(GLenum));
+	if (!in || keyLength != binaryKey.size() || size <= header + (std::streamoff)keyLength) return false;
+	// Two sources with the same hash must not share a program
+	std::string key(keyLength, '\0');
+	in.read(&key[0], key.size());
+	if (!in || key != binaryKey) return false;
+	std::vector<char> data((size_t)(size - header - (std::streamoff)keyLength));
+	GLenum format = 0;
+	in.read((char*)&format, sizeof(format));
+	in.read(data.data(), data.size());
+	if (!in) return false;
+
+	// A driver update can invalidate the binary even when the strings match
+	ID = glCreateProgram();
+	glExt.ProgramBinary(ID, format, data.data(), (GLsizei)data.size());
+	GLint linked = GL_FALSE;
+	glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+	if (linked == GL_TRUE) return true;
+	glDeleteProgram(ID);
+	ID = 0;
+	return false;
+}
+
+// Saves the linked program to the binary cache
+void Shader::saveBinary()
+{
+	GLint length = 0;
+	glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+	std::vector<char> data(length);
+	GLenum format = 0;
+	glExt.GetProgramBinary(ID, length, &length, &format, data.data());
+
+	std::error_code error;
+	std::filesystem::create_directories(binaryCache, error);
+	uint64_t keyLength = binaryKey.size();
+	std::ofstream out(binaryFile, std::ios::binary);
+	out.write((const char*)&keyLength, sizeof(keyLength));
+	out.write(binaryKey.data(), binaryKey.size());
+	out.write((const char*)&format, sizeof(format));
+	out.write(data.data(), length);
+	out.close();
+	// A full disk leaves a truncated file that would be read back next run
+	if (!out)
+	{
+		LOG_WARNING("Failed to save shader binary: %s", binaryFile.c_str());
+		std::filesystem::remove(binaryFile, error);
+	}
 }
 
 // Activates the Shader Program
 void Shader::Activate()
 {
+	Finish();
 	glUseProgram(ID);
 }
 
@@ -74,6 +270,18 @@ void Shader::Delete()
 	glDeleteProgram(ID);
 }
 
+// Logs a driver's info log one line per message, so long logs aren't cut at the message size
+static void logInfoLog(const char* what, const char* type, const char* infoLog)
+{
+	LOG_ERROR("%s for: %s", what, type);
+	std::istringstream lines(infoLog);
+	std::string line;
+	while (std::getline(lines, line))
+	{
+		if (!line.empty()) LOG_ERROR("  %s", line.c_str());
+	}
+}
+
 // Checks if the different Shaders have compiled properly
 void Shader::compileErrors(unsigned int shader, const char* type)
 {
@@ -87,7 +295,7 @@ void Shader::compileErrors(unsigned int shader, const char* type)
 		if (hasCompiled == GL_FALSE)
 		{
 			glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-			std::cout << "SHADER_COMPILATION_ERROR for:" << type << "\n" << infoLog << std::endl;
+			logInfoLog("SHADER_COMPILATION_ERROR", type, infoLog);
 		}
 	}
 	else
@@ -96,7 +304,122 @@ void Shader::compileErrors(unsigned int shader, const char* type)
 		if (hasCompiled == GL_FALSE)
 		{
 			glGetProgramInfoLog(shader, 1024, NULL, infoLog);
-			std::cout << "SHADER_LINKING_ERROR for:" << type << "\n" << infoLog << std::endl;
+			logInfoLog("SHADER_LINKING_ERROR", type, infoLog);
 		}
 	}
+}
+
+// Reads the locations of all active uniforms after linking
+void Shader::reflectUniforms()
+{
+	uniforms.clear();
+	GLint count = 0, maxLength = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	std::vector<char> buffer(maxLength + 1);
+	GLint maxLocation = -1;
+	for (GLint i = 0; i < count; i++)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type;
+		glGetActiveUniform(ID, i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+		std::string name(buffer.data(), length);
+		// Uniforms inside uniform blocks have no location
+		GLint location = glGetUniformLocation(ID, name.c_str());
+		if (location < 0) continue;
+		uniforms[name] = location;
+		maxLocation = std::max(maxLocation, location);
+
+		// Arrays are reported as name[0], makes the bare name and every element available too
+		if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+		{
+			std::string base = name.substr(0, name.size() - 3);
+			uniforms[base] = location;
+			for (GLint j = 1; j < size; j++)
+			{
+				std::string element = base + "[" + std::to_string(j) + "]";
+				GLint elementLocation = glGetUniformLocation(ID, element.c_str());
+				uniforms[element] = elementLocation;
+				maxLocation = std::max(maxLocation, elementLocation);
+			}
+		}
+	}
+	values.assign(maxLocation + 1, UniformValue());
+}
+
+// Gets the location of a uniform from the table built at link time, -1 if the program doesn't use it
+GLint Shader::Uniform(std::string_view name) const
+{
+	auto it = uniforms.find(name);
+	return it != uniforms.end() ? it->second : -1;
+}
+
+// Stores the value for a location, returns false if it was already uploaded
+bool Shader::changed(GLint location, const void* data, size_t size)
+{
+	if (location < 0) return false;
+	// Otherwise the value would land in another program while this cache records it here
+	assert(glExt.ProgramUniform1i != nullptr || bound());
+	if (location >= (GLint)values.size())
+	{
+		uploads++;
+		return true;
+	}
+	UniformValue& value = values[location];
+	if (value.set && memcmp(value.data, data, size) == 0) return false;
+	memcpy(value.data, data, size);
+	value.set = true;
+	uploads++;
+	return true;
+}
+
+// Whether this is the program glUniform currently writes to
+bool Shader::bound() const
+{
+	GLint current = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+	return (GLuint)current == ID;
+}
+
+void Shader::SetInt(GLint location, int value)
+{
+	if (!changed(location, &value, sizeof(value))) return;
+	if (glExt.ProgramUniform1i != nullptr) glExt.ProgramUniform1i(ID, location, value);
+	else glUniform1i(location, value);
+}
+
+void Shader::SetFloat(GLint location, float value)
+{
+	if (!changed(location, &value, sizeof(value))) return;
+	if (glExt.ProgramUniform1i != nullptr) glExt.ProgramUniform1f(ID, location, value);
+	else glUniform1f(location, value);
+}
+
+void Shader::SetVec3(GLint location, const glm::vec3& value)
+{
+	if (!changed(location, glm::value_ptr(value), sizeof(value))) return;
+	if (glExt.ProgramUniform1i != nullptr) glExt.ProgramUniform3fv(ID, location, 1, glm::value_ptr(value));
+	else glUniform3fv(location, 1, glm::value_ptr(value));
+}
+
+void Shader::SetVec4(GLint location, const glm::vec4& value)
+{
+	if (!changed(location, glm::value_ptr(value), sizeof(value))) return;
+	if (glExt.ProgramUniform1i != nullptr) glExt.ProgramUniform4fv(ID, location, 1, glm::value_ptr(value));
+	else glUniform4fv(location, 1, glm::value_ptr(value));
+}
+
+void Shader::SetMat3(GLint location, const glm::mat3& value)
+{
+	if (!changed(location, glm::value_ptr(value), sizeof(value))) return;
+	if (glExt.ProgramUniform1i != nullptr) glExt.ProgramUniformMatrix3fv(ID, location, 1, GL_FALSE, glm::value_ptr(value));
+	else glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader::SetMat4(GLint location, const glm::mat4& value)
+{
+	if (!changed(location, glm::value_ptr(value), sizeof(value))) return;
+	if (glExt.ProgramUniform1i != nullptr) glExt.ProgramUniformMatrix4fv(ID, location, 1, GL_FALSE, glm::value_ptr(value));
+	else glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
 }
\ No newline at end of file
@@ -7,6 +7,10 @@
 #include<sstream>
 #include<iostream>
 #include<cerrno>
+#include<string_view>
+#include<unordered_map>
+#include<vector>
+#include<glm/glm.hpp>
 
 std::string get_file_contents(const char* filename);
 
@@ -15,16 +19,88 @@ class Shader
 public:
 	// Reference ID of the Shader Program
 	GLuint ID;
-	// Constructor that build the Shader Program from 2 different shaders
-	Shader(const char* vertexFile, const char* fragmentFile);
+	// Number of uniform uploads that reached the driver, for the per-frame statistics
+	static unsigned int uploads;
+	// Directory linked programs are saved to and restored from, named by a hash of their sources
+	// and the driver, which are also stored in the file and compared on load; empty to always compile
+	static std::string binaryCache;
+	// Programs restored from the binary cache and compiled from source since startup
+	static unsigned int cachedPrograms;
+	static unsigned int compiledPrograms;
+	// Constructor that build the Shader Program from 2 different shaders, with defines
+	// (e.g. "#define NAME\n") inserted after the #version line of both. Without wait the
+	// compilation is only started, so several programs can build side by side on drivers with
+	// KHR_parallel_shader_compile, and Finish must be called before the program is used
+	Shader(const char* vertexFile, const char* fragmentFile, const std::string& defines = "", bool wait = true);
 
+	// Whether Finish would return without waiting for the driver
+	bool Ready() const;
+	// Waits for the compilation, reports errors, saves the binary and reads the uniforms
+	void Finish();
+	// Whether the program linked, waits for the compilation
+	bool Linked();
 	// Activates the Shader Program
 	void Activate();
 	// Deletes the Shader Program
 	void Delete();
+
+	// Gets the location of a uniform from the table built at link time, -1 if the program doesn't use it
+	GLint Uniform(std::string_view name) const;
+	// Set the value of a uniform of this Shader Program, skipping the upload if it already holds that value.
+	// Written straight to the program with glProgramUniform when available, otherwise the program must be
+	// the active one since glUniform writes to whichever is bound
+	void SetInt(GLint location, int value);
+	void SetFloat(GLint location, float value);
+	void SetVec3(GLint location, const glm::vec3& value);
+	void SetVec4(GLint location, const glm::vec4& value);
+	void SetMat3(GLint location, const glm::mat3& value);
+	void SetMat4(GLint location, const glm::mat4& value);
+	void SetInt(std::string_view name, int value) { SetInt(Uniform(name), value); }
+	void SetFloat(std::string_view name, float value) { SetFloat(Uniform(name), value); }
+	void SetVec3(std::string_view name, const glm::vec3& value) { SetVec3(Uniform(name), value); }
+	void SetVec4(std::string_view name, const glm::vec4& value) { SetVec4(Uniform(name), value); }
+	void SetMat3(std::string_view name, const glm::mat3& value) { SetMat3(Uniform(name), value); }
+	void SetMat4(std::string_view name, const glm::mat4& value) { SetMat4(Uniform(name), value); }
 private:
+	// Hashes names without copying them into a std::string
+	struct NameHash
+	{
+		using is_transparent = void;
+		size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+	};
+	// Last value uploaded to a uniform location
+	struct UniformValue
+	{
+		bool set = false;
+		float data[16];
+	};
+
+	// Locations of the active uniforms by name
+	std::unordered_map<std::string, GLint, NameHash, std::equal_to<>> uniforms;
+	// Last uploaded values, indexed by location
+	std::vector<UniformValue> values;
+
+	// Compiled stages until Finish, 0 once linked or when restored from the cache
+	GLuint vertexShader = 0;
+	GLuint fragmentShader = 0;
+	bool finished = false;
+	// File of the program in the binary cache, empty when not cached
+	std::string binaryFile;
+	// Sources and driver the cached program must have been built from
+	std::string binaryKey;
+
 	// Checks if the different Shaders have compiled properly
 	void compileErrors(unsigned int shader, const char* type);
+	// Links the program from the binary saved for these sources, false if there is none or the driver rejects it
+	bool loadBinary();
+	// Saves the linked program to the binary cache
+	void saveBinary();
+	// Reads the locations of all active uniforms after linking
+	void reflectUniforms();
+	// Stores the value for a location, returns false if it was already uploaded
+	bool changed(GLint location, const void* data, size_t size);
+	// Whether this is the program glUniform currently writes to
+	bool bound() const;
 };
 
 